@@ -17,15 +17,32 @@
  * limitations under the License.
  */
 #include "a2jmidi.h"
+#include "a2jmidi_auto.h"
+#include "a2jmidi_control.h"
+#include "a2jmidi_j2a.h"
+#include "a2jmidi_probe.h"
 #include "alsa_client.h"
+#include "alsa_receiver_queue.h"
 #include "jack_client.h"
+#include "midi_active_notes.h"
+#include "midi_clock_pll.h"
 #include "spdlog/sinks/stdout_color_sinks.h"
 #include "spdlog/spdlog.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
 #include <iostream>
 #include <jack/jack.h>
 #include <jack/midiport.h>
+#include <optional>
+#include <random>
 #include <signal.h>
+#include <sstream>
+#include <stdexcept>
 #include <thread>
+#include <vector>
 
 namespace a2jmidi {
 
@@ -33,108 +50,648 @@ static auto g_logger = spdlog::stdout_color_mt("a2jmidi");
 
 static bool g_continue{true};
 
+/**
+ * After a discontinuity, events older than this (in milliseconds) are discarded in one go.
+ */
+static int g_maxEventAgeMs{DEFAULT_MAX_EVENT_AGE_MS};
+
+/**
+ * The port that sends the probe notes (`NULL_PORT_ID` when not probing).
+ */
+static alsaClient::PortID g_probePort{alsaClient::NULL_PORT_ID};
+/**
+ * True when the probes go through an external loop; they then come back from the input
+ * of the loop, and are recognized by their channel.
+ */
+static bool g_probeThrough{false};
+
+/**
+ * Set to ask the process callback for note-offs for all sounding notes; cleared once
+ * they have been written.
+ */
+static std::atomic<bool> g_releaseRequested{false};
+
+/**
+ * The largest shift (in milliseconds) that the clock smoothing applies to a clock message.
+ */
+constexpr int MAX_CLOCK_CORRECTION_MS{5};
+
+/**
+ * The estimate of the clock smoothing, published by the process callback:
+ * the period in frames per tick (zero when not locked) and the jitter in frames.
+ */
+static std::atomic<double> g_clockPeriod{0};
+static std::atomic<double> g_clockJitter{0};
+
+/**
+ * Holds back the kinds of messages chosen through the control socket.
+ */
+static midi::MessageFilter g_messageFilter;
+
+/**
+ * Taken during static initialisation, as close to the start of the process as we can get.
+ */
+static const auto g_processStart = std::chrono::steady_clock::now();
+
+/**
+ * The time elapsed since the start of the process, in milliseconds.
+ */
+static double millisecondsSinceStart() {
+  std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - g_processStart;
+  return elapsed.count();
+}
+
+/**
+ * The largest number of JACK ports that the ALSA stream can be split into (one per channel).
+ */
+constexpr int MAX_SENDER_PORTS{midi::CHANNEL_COUNT};
+
+/**
+ * For each MIDI channel, the index of the JACK port that receives its messages.
+ */
+using ChannelRouting = std::array<int, midi::CHANNEL_COUNT>;
+
 class ForEachMidiProc {
 private:
-  void *const m_pPortBuffer;
+  void *const *const m_pPortBuffers;
+  const int m_portCount;
+  const ChannelRouting &m_routing;
+  midi::ActiveNotes &m_activeNotes;
+  midi::ClockPll *const m_clockPll; ///< nullptr when clock smoothing is off.
   const a2jmidi::TimePoint m_deadline;
+  const a2jmidi::TimePoint m_periodStart; ///< the frame time of the start of the buffer.
   const int m_nFrames;
+  a2jmidi::TimePoint m_lastPosition{0}; ///< JACK wants the events of a buffer in time order.
 
-public:
-  ForEachMidiProc(void *const pPortBuffer, const a2jmidi::TimePoint deadline, const int nFrames)
-      : m_pPortBuffer{pPortBuffer}, m_deadline{deadline}, m_nFrames{nFrames} {}
-
-  int operator()(const midi::Event &event, const a2jmidi::TimePoint timeStamp) {
-
-    int lead = static_cast<int>(m_deadline - timeStamp); // how many time ahead of deadline
-    int eventPos = m_nFrames - lead;                     // the position in the frame buffer
-    if (eventPos < -m_nFrames) {
-      // such extreme buffer-underrun happen after system hibernation.
-      SPDLOG_LOGGER_ERROR(g_logger, "a2j_midi - buffer underrun by {} frames - event discarded.",
-                          -eventPos);
-      return 0; // ignore problem - just continue
+  /**
+   * With clock smoothing, replace the time stamp of clock, start, continue and stop
+   * messages by the time predicted by the phase-locked loop.
+   */
+  a2jmidi::TimePoint retime(unsigned char status, a2jmidi::TimePoint timeStamp) {
+    if (!m_clockPll) {
+      return timeStamp;
     }
-    if (eventPos < 0) {
-      SPDLOG_LOGGER_ERROR(g_logger, "a2j_midi - buffer underrun by {} frames.", -eventPos);
-      eventPos = 0; // ignore problem - put event at the very start of the buffer
+    if (midi::isClockTick(status)) {
+      return m_clockPll->placeTick(timeStamp);
     }
-    if (eventPos >= m_nFrames) {
-      SPDLOG_LOGGER_ERROR(g_logger, "a2j_midi - buffer overrun by {} frames.",
-                          eventPos - m_nFrames);
-      eventPos = m_nFrames - 1; // ignore problem - put event at the very end of the buffer
+    if (midi::isTransport(status)) {
+      return m_clockPll->placeTransport(timeStamp);
     }
+    return timeStamp;
+  }
 
-    int evLength = event.size();
-    const auto *pMidiData = &event[0];
+  /**
+   * Write one event into the buffer of one JACK port.
+   *
+   * The space in the JACK buffer is reserved with the exact size of the event, and the
+   * MIDI bytes are written straight into it.
+   * @param activeNotes - if given, notes are registered there.
+   * @return zero on success, a non zero value if processing shall stop.
+   */
+  int writeEvent(void *pPortBuffer, jack_nframes_t eventPos, const alsaClient::PendingEvent &event,
+                 midi::ActiveNotes *activeNotes = nullptr) {
+    size_t evLength = event.size();
 
-    int err = jack_midi_event_write(m_pPortBuffer, eventPos, pMidiData, evLength);
-    if (err == -ENOBUFS) {
-      SPDLOG_LOGGER_ERROR(g_logger, "a2j_midi - JACK write error ({} bytes did not fit in buffer).",
-                          evLength);
-      return -1; // stop processing
-    }
-    if (err == -EINVAL) {
+    jack_midi_data_t *pMidiData = jack_midi_event_reserve(pPortBuffer, eventPos, evLength);
+    if (!pMidiData) {
+      if (jack_midi_max_event_size(pPortBuffer) < evLength) {
+        SPDLOG_LOGGER_ERROR(g_logger,
+                            "a2j_midi - JACK write error ({} bytes did not fit in buffer).",
+                            evLength);
+        return -1; // stop processing
+      }
       SPDLOG_LOGGER_ERROR(g_logger,
                           "a2j_midi - JACK write error (invalid argument).\n"
                           "           eventPos:{}, evLength:{}",
                           eventPos, evLength);
       return 0; // ignore problem - whatever it was...
     }
-    if (err != 0) {
-      SPDLOG_LOGGER_ERROR(g_logger, "a2j_midi - JACK write error (undocumented error-code {}).",
-                          err);
-      return 0; // ignore problem - whatever it was...
+    event.writeTo(pMidiData);
+    if (activeNotes) {
+      activeNotes->update(pMidiData, evLength);
     }
     SPDLOG_LOGGER_TRACE(g_logger, "a2j_midi::forEachMidiDo - event[{}] written to buffer.",
                         evLength);
     return 0;
   }
+
+public:
+  ForEachMidiProc(void *const *pPortBuffers, const int portCount, const ChannelRouting &routing,
+                  midi::ActiveNotes &activeNotes, midi::ClockPll *clockPll,
+                  const a2jmidi::TimePoint deadline, const a2jmidi::TimePoint jitterCompensation,
+                  const int nFrames)
+      : m_pPortBuffers{pPortBuffers}, m_portCount{portCount}, m_routing{routing},
+        m_activeNotes{activeNotes}, m_clockPll{clockPll}, m_deadline{deadline},
+        m_periodStart{deadline + jitterCompensation}, m_nFrames{nFrames} {}
+
+  int operator()(const alsaClient::PendingEvent &event, const a2jmidi::TimePoint timeStamp) {
+    unsigned char status = event.status();
+
+    // both time points are on the 64-bit frame timeline, so the difference cannot wrap.
+    a2jmidi::TimePoint lead = m_deadline - retime(status, timeStamp); // ahead of deadline
+    a2jmidi::TimePoint position = m_nFrames - lead;   // the position in the frame buffer
+    if (position < -m_nFrames) {
+      // such extreme buffer-underrun happen after system hibernation.
+      SPDLOG_LOGGER_ERROR(g_logger, "a2j_midi - buffer underrun by {} frames - event discarded.",
+                          -position);
+      return 0; // ignore problem - just continue
+    }
+    if (position < 0) {
+      SPDLOG_LOGGER_ERROR(g_logger, "a2j_midi - buffer underrun by {} frames.", -position);
+      position = 0; // ignore problem - put event at the very start of the buffer
+    }
+    if (position >= m_nFrames) {
+      SPDLOG_LOGGER_ERROR(g_logger, "a2j_midi - buffer overrun by {} frames.",
+                          position - m_nFrames);
+      position = m_nFrames - 1; // ignore problem - put event at the very end of the buffer
+    }
+    // a re-timed clock message may have moved past the events that follow it.
+    position = std::max(position, m_lastPosition);
+    m_lastPosition = position;
+    auto eventPos = static_cast<jack_nframes_t>(position);
+
+    if (g_probePort != alsaClient::NULL_PORT_ID &&
+        (g_probeThrough ? status == (0x90U | probe::PROBE_CHANNEL)
+                        : event.sender() == g_probePort)) {
+      // probe notes are measured, not forwarded.
+      unsigned char bytes[3];
+      if (event.size() == sizeof(bytes)) {
+        event.writeTo(bytes);
+        probe::recordReceived(bytes[1], m_periodStart + eventPos);
+      }
+      return 0;
+    }
+    if (!g_messageFilter.passes(status)) {
+      return 0;
+    }
+    if (midi::isChannelMessage(status)) {
+      return writeEvent(m_pPortBuffers[m_routing[midi::channelOf(status)]], eventPos, event,
+                        &m_activeNotes);
+    }
+    // system messages (clock, start, stop, SysEx...) concern all ports.
+    for (int i = 0; i < m_portCount; i++) {
+      int err = writeEvent(m_pPortBuffers[i], eventPos, event);
+      if (err) {
+        return err;
+      }
+    }
+    return 0;
+  }
 };
 
 class ForEachJackPeriodProc {
 private:
-  const jackClient::JackPort m_jackPort;
+  const std::vector<jackClient::JackPort> m_jackPorts;
+  const ChannelRouting m_routing;
+  midi::ActiveNotes m_activeNotes;
+  std::optional<midi::ClockPll> m_clockPll;
+  long m_disruptionsSeen{disruptionCount()};
+
+  /**
+   * The number of incidents so far that might have cost us a note-off: lost sources,
+   * events dropped by the receiver queue and overflows of the kernel input pool.
+   * Coalesced controller values are not counted, the latest value of each has been kept.
+   */
+  static long disruptionCount() noexcept {
+    auto statistics = alsaClient::receiverQueue::getStatistics();
+    return alsaClient::disconnectCount() + statistics.droppedEventCount +
+           statistics.kernelOverflowCount;
+  }
+
+  /**
+   * Write a note-off for each sounding note, at the start of the period.
+   */
+  void releaseActiveNotes(void *const *pPortBuffers) {
+    int released = m_activeNotes.releaseAll([&](const unsigned char *bytes, size_t size) {
+      void *pPortBuffer = pPortBuffers[m_routing[midi::channelOf(bytes[0])]];
+      jack_midi_event_write(pPortBuffer, 0, bytes, size);
+    });
+    SPDLOG_LOGGER_TRACE(g_logger, "a2j_midi - {} note-offs synthesised.", released);
+  }
 
 public:
-  ForEachJackPeriodProc(jackClient::JackPort jackPort) : m_jackPort{jackPort} {}
+  /**
+   * Constructor.
+   * @param jackPorts - the JACK ports to write to (at most `MAX_SENDER_PORTS`).
+   * @param routing - for each MIDI channel, the index of its port in `jackPorts`.
+   * @param clockPll - the clock smoothing, or none.
+   */
+  ForEachJackPeriodProc(std::vector<jackClient::JackPort> jackPorts, const ChannelRouting &routing,
+                        std::optional<midi::ClockPll> clockPll)
+      : m_jackPorts{std::move(jackPorts)}, m_routing{routing}, m_clockPll{clockPll} {}
+
   int operator()(const int nFrames, const a2jmidi::TimePoint deadline) {
-    void *pPortBuffer = jack_port_get_buffer(m_jackPort, nFrames);
-    jack_midi_clear_buffer(pPortBuffer);
-    ForEachMidiProc forEachMidiProc{pPortBuffer, deadline, nFrames};
-    return alsaClient::retrieve(deadline, forEachMidiProc);
+    // fetch and clear every buffer once per period, then route the events in one pass.
+    std::array<void *, MAX_SENDER_PORTS> portBuffers{};
+    int portCount = static_cast<int>(m_jackPorts.size());
+    for (int i = 0; i < portCount; i++) {
+      portBuffers[i] = jack_port_get_buffer(m_jackPorts[i], nFrames);
+      jack_midi_clear_buffer(portBuffers[i]);
+    }
+    long disruptions = disruptionCount();
+    if (disruptions != m_disruptionsSeen || g_releaseRequested) {
+      m_disruptionsSeen = disruptions;
+      releaseActiveNotes(portBuffers.data());
+      g_releaseRequested = false;
+    }
+    midi::ClockPll *clockPll = m_clockPll ? &*m_clockPll : nullptr;
+    ForEachMidiProc forEachMidiProc{portBuffers.data(),
+                                    portCount,
+                                    m_routing,
+                                    m_activeNotes,
+                                    clockPll,
+                                    deadline,
+                                    jackClient::periodParameters().jitterCompensation,
+                                    nFrames};
+    int err = alsaClient::retrieveDirect(deadline, forEachMidiProc);
+    if (clockPll) {
+      g_clockPeriod.store(clockPll->period(), std::memory_order_relaxed);
+      g_clockJitter.store(clockPll->jitter(), std::memory_order_relaxed);
+    }
+    return err;
   }
 };
 
+/**
+ * Invoked on the JACK process thread before the first cycle that follows a discontinuity.
+ * All events older than `g_maxEventAgeMs` are purged, so that the next cycle starts clean.
+ * @param deadline - the deadline of the cycle that is about to be processed.
+ */
+void onJackResync(const a2jmidi::TimePoint deadline) {
+  // the sample rate is cached by the jackClient, it might have changed since `open`.
+  a2jmidi::TimePoint maxEventAge =
+      static_cast<a2jmidi::TimePoint>(g_maxEventAgeMs) * jackClient::sampleRate() / 1000;
+  int skipped = alsaClient::skip(deadline - maxEventAge);
+  if (skipped > 0) {
+    SPDLOG_LOGGER_ERROR(g_logger, "a2j_midi - resync, {} stale events discarded.", skipped);
+  }
+}
+
 void onJackServerAbend() {
   g_continue = false;
   SPDLOG_LOGGER_INFO(g_logger, "JACK server is down.");
 }
 
-void open(const std::string &clientNameProposal, const std::string &connectTo,
-          bool startJack) noexcept(false) {
+/**
+ * The filter of the automatic mode, as last requested (on the command line or through
+ * the control socket).
+ */
+static alsaClient::AutoFilter g_autoFilter;
+
+static const char *const CONTROL_HELP =
+    "help                      this text\n"
+    "stats                     the counters of the bridge\n"
+    "queue                     the state of the receiver queue\n"
+    "connect [PORT ...]        replace the ALSA ports to connect to\n"
+    "filter messages CLASSES   hold back messages: none, or a comma separated list of\n"
+    "                          note, control, program, pressure, pitchbend, sysex,\n"
+    "                          clock, sensing, system\n"
+    "filter auto KIND          with --auto: hardware, software or all\n"
+    "loglevel LEVEL            trace, debug, info, warn, err, critical or off\n"
+    "quit                      close the connection\n";
+
+/**
+ * The name of an overflow policy, as given with `--overflow`.
+ */
+static const char *policyName(alsaClient::receiverQueue::OverflowPolicy policy) {
+  using alsaClient::receiverQueue::OverflowPolicy;
+  switch (policy) {
+  case OverflowPolicy::dropOldest:
+    return "drop-oldest";
+  case OverflowPolicy::dropNewest:
+    return "drop-newest";
+  case OverflowPolicy::coalesceControllers:
+    return "coalesce";
+  }
+  return "unknown";
+}
+
+/**
+ * Execute a request received on the control socket (see `control::CommandHandler`).
+ *
+ * Runs on the thread of the control socket. The changes reach the process callback through
+ * atomics only (the message filter, the source list of the `alsaClient`, the slots of the
+ * automatic mode), so a request never stalls a period.
+ */
+std::string executeControlCommand(const std::vector<std::string> &words) noexcept(false) {
+  const std::string &command = words[0];
+  auto expectArguments = [&words](size_t count) {
+    if (words.size() != count + 1) {
+      throw std::invalid_argument("\"" + words[0] + "\" expects " + std::to_string(count) +
+                                  " argument(s), try \"help\"");
+    }
+  };
+  std::stringstream out;
+  if (command == "help") {
+    out << CONTROL_HELP;
+  } else if (command == "stats") {
+    expectArguments(0);
+    if (j2a::isOpen()) {
+      out << "sent " << alsaClient::outputCount() << "\n";
+      out << "dropped " << j2a::droppedCount() << "\n";
+      return out.str();
+    }
+    for (const auto &source : alsaClient::sourceStatistics()) {
+      out << "source \"" << source.designation << "\" events " << source.eventCount
+          << " connected " << source.connectCount << "\n";
+    }
+    out << "other-sources " << alsaClient::otherSourcesEventCount() << "\n";
+    out << "disconnects " << alsaClient::disconnectCount() << "\n";
+    out << "recoveries " << alsaClient::recoveryCount() << "\n";
+    out << "filter " << control::messageClassNames(g_messageFilter.dropped()) << "\n";
+    out << "filtered " << g_messageFilter.filteredCount() << "\n";
+    if (autoBridge::isOpen()) {
+      out << "bridged " << autoBridge::bridgedCount() << "\n";
+      out << "dropped " << autoBridge::droppedCount() << "\n";
+    }
+    auto clock = clockEstimate();
+    if (clock.locked) {
+      out << fmt::format("clock {:.1f} BPM jitter {:.2f} ms\n", clock.bpm, clock.jitterMs);
+    }
+  } else if (command == "queue") {
+    expectArguments(0);
+    auto statistics = alsaClient::receiverQueue::getStatistics();
+    auto limits = alsaClient::receiverQueue::getLimits();
+    out << "events " << statistics.eventCount << " bytes " << statistics.byteCount << "\n";
+    out << "high-watermark " << statistics.highWatermarkEvents << " bytes "
+        << statistics.highWatermarkBytes << "\n";
+    out << "limits " << limits.maxEvents << " bytes " << limits.maxBytes << " policy "
+        << policyName(limits.policy) << "\n";
+    out << "dropped " << statistics.droppedEventCount << "\n";
+    out << "coalesced " << statistics.coalescedEventCount << "\n";
+    out << "kernel-overflows " << statistics.kernelOverflowCount << "\n";
+    out << "batches " << alsaClient::receiverQueue::getCurrentEventBatchCount() << "\n";
+    out << "input-pool " << alsaClient::inputPoolSize() << "\n";
+  } else if (command == "connect") {
+    if (j2a::isOpen()) {
+      throw std::invalid_argument("not available with --j2a");
+    }
+    alsaClient::setConnectTargets({words.begin() + 1, words.end()});
+  } else if (command == "filter") {
+    expectArguments(2);
+    if (words[1] == "messages") {
+      unsigned int dropped = control::parseMessageClasses(words[2]);
+      if ((dropped & ~g_messageFilter.dropped()) & midi::messageClass::NOTE) {
+        // the note-offs of the sounding notes will be held back as well.
+        g_releaseRequested = true;
+      }
+      g_messageFilter.set(dropped);
+    } else if (words[1] == "auto") {
+      alsaClient::AutoFilter filter = g_autoFilter;
+      if (words[2] == "hardware") {
+        filter.clientKind = alsaClient::ClientKind::hardware;
+      } else if (words[2] == "software") {
+        filter.clientKind = alsaClient::ClientKind::software;
+      } else if (words[2] == "all") {
+        filter.clientKind = alsaClient::ClientKind::all;
+      } else {
+        throw std::invalid_argument("unknown kind of client \"" + words[2] + "\"");
+      }
+      alsaClient::setAutoFilter(filter);
+      g_autoFilter = filter;
+    } else {
+      throw std::invalid_argument("unknown filter \"" + words[1] + "\"");
+    }
+  } else if (command == "loglevel") {
+    expectArguments(1);
+    auto level = spdlog::level::from_str(words[1]);
+    if (level == spdlog::level::off && words[1] != "off") {
+      throw std::invalid_argument("unknown log level \"" + words[1] + "\"");
+    }
+    spdlog::set_level(level);
+  } else {
+    throw std::invalid_argument("unknown command \"" + command + "\", try \"help\"");
+  }
+  return out.str();
+}
+
+/**
+ * Start serving the control socket, if one has been requested.
+ */
+void openControl(const CommandLineInterpretation &arguments) noexcept(false) {
+  if (!arguments.controlSocket.empty()) {
+    control::open(arguments.controlSocket, executeControlCommand);
+  }
+}
+
+/**
+ * Set up and start the bridge.
+ * @param arguments - the interpreted command line.
+ * @param internalClient - the session of the internal client; nullptr when running
+ * as a stand-alone application.
+ */
+void open(const CommandLineInterpretation &arguments,
+          jack_client_t *internalClient = nullptr) noexcept(false) {
   SPDLOG_LOGGER_TRACE(g_logger, "a2jmidi::open");
 
-  jackClient::open(clientNameProposal, startJack);
+  if (internalClient) {
+    jackClient::attach(internalClient);
+  } else {
+    jackClient::open(arguments.clientName, arguments.startJack);
+  }
   jackClient::onServerAbend(onJackServerAbend);
   const std::string clientName = jackClient::clientName();
   SPDLOG_LOGGER_INFO(g_logger, "client \"{}\" started.", clientName);
+  SPDLOG_LOGGER_TRACE(g_logger, "a2jmidi::open - JACK client open after {:.1f} ms.",
+                      millisecondsSinceStart());
+
+  if (arguments.j2a) {
+    j2a::open(clientName, arguments.connectTo);
+    openControl(arguments);
+    SPDLOG_LOGGER_INFO(g_logger, "ready (JACK to ALSA) {:.1f} ms after start.",
+                       millisecondsSinceStart());
+    return;
+  }
 
-  jackClient::JackPort jackPort = jackClient::newSenderPort(clientName);
+  std::vector<jackClient::JackPort> jackPorts;
+  ChannelRouting routing{}; // by default, all channels go to the first port.
+  if (arguments.autoConnect) {
+    // the ports are created as the ALSA ports are discovered.
+  } else if (arguments.splitChannels) {
+    for (int channel = 0; channel < midi::CHANNEL_COUNT; channel++) {
+      std::string number = std::to_string(channel + 1);
+      std::string portName = clientName + "_ch" + (channel < 9 ? "0" : "") + number;
+      jackPorts.push_back(jackClient::newSenderPort(portName));
+      routing[channel] = channel;
+    }
+  } else {
+    jackPorts.push_back(jackClient::newSenderPort(clientName));
+  }
 
   alsaClient::open(clientName);
-  alsaClient::newReceiverPort(clientName, connectTo);
+  alsaClient::setInputPool(arguments.inputPool);
+  if (arguments.rawMidiDevice.empty()) {
+    if (arguments.ump) {
+      alsaClient::enableUmp();
+    }
+    alsaClient::newReceiverPort(clientName, arguments.connectTo);
+  } else {
+    if (!arguments.connectTo.empty()) {
+      SPDLOG_LOGGER_WARN(g_logger, "reading rawmidi device \"{}\", connections are ignored.",
+                         arguments.rawMidiDevice);
+    }
+    if (arguments.ump) {
+      SPDLOG_LOGGER_WARN(g_logger, "reading rawmidi device \"{}\", --ump is ignored.",
+                         arguments.rawMidiDevice);
+    }
+    alsaClient::newRawMidiInput(arguments.rawMidiDevice);
+  }
+  if (!arguments.latencyProfiles.empty()) {
+    if (arguments.rawMidiDevice.empty()) {
+      std::vector<alsaClient::LatencyOffset> offsets;
+      for (const auto &profile : arguments.latencyProfiles) {
+        auto frames = std::llround(profile.milliseconds * jackClient::sampleRate() / 1000);
+        offsets.push_back({profile.designation, static_cast<a2jmidi::TimePoint>(frames)});
+      }
+      alsaClient::setLatencyOffsets(offsets);
+    } else {
+      SPDLOG_LOGGER_WARN(g_logger, "reading rawmidi device \"{}\", latency profiles are ignored.",
+                         arguments.rawMidiDevice);
+    }
+  }
+  if (arguments.probeCount > 0) {
+    probe::prepare(arguments.probeCount);
+    g_probeThrough = !arguments.probeThrough.empty();
+    g_probePort = alsaClient::newProbePort(arguments.probeThrough);
+  }
+
+  g_clockPeriod = 0;
+  g_clockJitter = 0;
+  if (arguments.autoConnect) {
+    g_autoFilter = arguments.autoFilter;
+    autoBridge::open(arguments.autoFilter, g_messageFilter);
+  } else {
+    std::optional<midi::ClockPll> clockPll;
+    if (arguments.smoothClock) {
+      clockPll.emplace(static_cast<a2jmidi::TimePoint>(MAX_CLOCK_CORRECTION_MS) *
+                       jackClient::sampleRate() / 1000);
+    }
+    ForEachJackPeriodProc forEachJackPeriodProc{std::move(jackPorts), routing, clockPll};
+    jackClient::registerProcessCallback(forEachJackPeriodProc);
+  }
 
-  ForEachJackPeriodProc forEachJackPeriodProc{jackPort};
-  jackClient::registerProcessCallback(forEachJackPeriodProc);
+  g_maxEventAgeMs = arguments.maxEventAgeMs;
+  jackClient::registerResyncCallback(onJackResync);
 
+  alsaClient::receiverQueue::setLimits(arguments.queueLimits);
+  alsaClient::receiverQueue::setIngestionMode(arguments.ingestionMode);
   alsaClient::activate(jackClient::clock());
   jackClient::activate();
+  openControl(arguments);
+  SPDLOG_LOGGER_INFO(g_logger, "ready {:.1f} ms after start.", millisecondsSinceStart());
+}
+
+/**
+ * Let the process callback send note-offs for all sounding notes, so that no note
+ * hangs downstream when the bridge goes away.
+ */
+void releaseSoundingNotes() {
+  using namespace std::chrono_literals;
+  if (jackClient::state() != jackClient::State::running) {
+    return;
+  }
+  g_releaseRequested = true;
+  auto giveUp = std::chrono::steady_clock::now() + 200ms;
+  while (g_releaseRequested && std::chrono::steady_clock::now() < giveUp) {
+    std::this_thread::sleep_for(1ms);
+  }
 }
 
 void close() {
   SPDLOG_LOGGER_TRACE(g_logger, "a2jmidi::close");
+  control::close(); // no more requests while the clients go away.
+  auto clock = clockEstimate(); // before the JACK client goes away.
+  if (j2a::isOpen()) {
+    j2a::close();
+  } else if (autoBridge::isOpen()) {
+    autoBridge::close();
+  } else {
+    releaseSoundingNotes();
+  }
   jackClient::close();
   alsaClient::close();
+
+  for (const auto &source : alsaClient::sourceStatistics()) {
+    SPDLOG_LOGGER_INFO(g_logger, "source \"{}\": {} events, connected {} times.",
+                       source.designation, source.eventCount, source.connectCount);
+  }
+
+  auto statistics = alsaClient::receiverQueue::getStatistics();
+  SPDLOG_LOGGER_INFO(g_logger,
+                     "receiver queue high-watermark {} events ({} bytes), {} dropped, "
+                     "{} coalesced.",
+                     statistics.highWatermarkEvents, statistics.highWatermarkBytes,
+                     statistics.droppedEventCount, statistics.coalescedEventCount);
+  if (statistics.kernelOverflowCount > 0) {
+    SPDLOG_LOGGER_WARN(g_logger, "ALSA input pool has overflowed {} times.",
+                       statistics.kernelOverflowCount);
+  }
+  if (alsaClient::recoveryCount() > 0) {
+    SPDLOG_LOGGER_WARN(g_logger, "receiver has been restarted {} times after a failure.",
+                       alsaClient::recoveryCount());
+  }
+  if (clock.locked) {
+    SPDLOG_LOGGER_INFO(g_logger, "MIDI clock at {:.1f} BPM, jitter {:.2f} ms.", clock.bpm,
+                       clock.jitterMs);
+  }
+}
+/**
+ * Send the probe notes one at a time and report the latency statistics.
+ *
+ * The pause between two probes varies, so that the probes arrive at all phases of
+ * the JACK period.
+ * @param probeCount - the number of probes to send.
+ */
+void runProbe(int probeCount, const std::vector<std::string> &loopInputs) {
+  using namespace std::chrono_literals;
+  constexpr auto timeout = 500ms; // a probe not received by then is counted as lost.
+  std::minstd_rand random{};
+  std::uniform_int_distribution<int> pauseMs{5, 25};
+  auto clock = jackClient::clock();
+
+  int sentCount = 0;
+  for (int i = 0; i < probeCount && g_continue; i++) {
+    int receivedBefore = probe::receivedCount();
+    unsigned char key = probe::recordSent(i, clock->now());
+    alsaClient::sendProbe(probe::PROBE_CHANNEL, key);
+    sentCount++;
+    auto giveUp = std::chrono::steady_clock::now() + timeout;
+    while (probe::receivedCount() == receivedBefore && std::chrono::steady_clock::now() < giveUp) {
+      std::this_thread::sleep_for(1ms);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(pauseMs(random)));
+  }
+
+  auto result = probe::statistics(sentCount);
+  auto parameters = jackClient::periodParameters();
+  double msPerFrame = 1000.0 / parameters.sampleRate;
+  // what the bridge itself adds to every source: one period and the jitter compensation.
+  auto bridgeFrames = static_cast<double>(parameters.bufferSize + parameters.jitterCompensation);
+  SPDLOG_LOGGER_INFO(g_logger, "probe: {} received, {} lost.", result.count, result.lost);
+  SPDLOG_LOGGER_INFO(g_logger,
+                     "latency (frames): min {:.0f}, mean {:.1f}, p99 {:.0f}, max {:.0f}, "
+                     "jitter {:.1f}",
+                     result.min, result.mean, result.p99, result.max, result.jitter);
+  SPDLOG_LOGGER_INFO(g_logger,
+                     "latency (ms): min {:.2f}, mean {:.2f}, p99 {:.2f}, max {:.2f}, "
+                     "jitter {:.2f}",
+                     result.min * msPerFrame, result.mean * msPerFrame, result.p99 * msPerFrame,
+                     result.max * msPerFrame, result.jitter * msPerFrame);
+  SPDLOG_LOGGER_INFO(g_logger, "of which the bridge adds {:.0f} frames (one period and the "
+                     "jitter compensation).", bridgeFrames);
+  SPDLOG_LOGGER_INFO(g_logger, "time stamp error (p99 - min): {:.0f} frames.",
+                     result.p99 - result.min);
+  if (g_probeThrough && result.count > 0) {
+    // the loop includes the output path; a source that is late gets a negative offset.
+    // The bridge delays all sources alike, so its own part does not belong to the profile.
+    std::string input = loopInputs.size() == 1 ? loopInputs.front() : "<input port>";
+    SPDLOG_LOGGER_INFO(g_logger,
+                       "latency profile for the whole loop (output and input):\n\"{}\" = {:.2f}",
+                       input, -(result.mean - bridgeFrames) * msPerFrame);
+  }
 }
+
 void configureLogging() {
   // set log pattern
   spdlog::set_pattern("%T.%e PID%P [%s:%#] %l: %v");
@@ -159,19 +716,34 @@ void sigintHandler(int sig) {
   }
   signal(SIGINT, sigintHandler); // reinstall handler
 }
-int run(const std::string &clientNameProposal, const std::string &connectTo,
-        bool startJack) noexcept {
+int runBridge(const CommandLineInterpretation &arguments) noexcept {
   using namespace std::chrono_literals;
   try {
-    SPDLOG_LOGGER_TRACE(g_logger, "a2jmidi::run");
-    open(clientNameProposal, connectTo, startJack);
+    SPDLOG_LOGGER_TRACE(g_logger, "a2jmidi::runBridge");
+    open(arguments);
+
+    if (arguments.probeCount > 0) {
+      runProbe(arguments.probeCount, arguments.connectTo);
+      close();
+      return 0;
+    }
 
     // install signal handlers for shutdown.
     signal(SIGINT, sigintHandler); // Ctrl-C interrupt the application. Usually causing it to abort.
     signal(SIGTERM, sigtermHandler); // cleanup and terminate the process
     // suspend this thread until the `g_continue` becomes false
+    bool clockLocked = false;
     while (g_continue) {
       std::this_thread::sleep_for(100ms);
+      auto clock = clockEstimate();
+      if (clock.locked != clockLocked) {
+        clockLocked = clock.locked;
+        if (clockLocked) {
+          SPDLOG_LOGGER_INFO(g_logger, "MIDI clock locked at {:.1f} BPM.", clock.bpm);
+        } else {
+          SPDLOG_LOGGER_INFO(g_logger, "MIDI clock lost.");
+        }
+      }
     }
 
     close();
@@ -187,6 +759,46 @@ int run(const std::string &clientNameProposal, const std::string &connectTo,
   return 1;
 }
 
+int startInternalClient(jack_client_t *client, const CommandLineInterpretation &arguments) noexcept {
+  configureLogging();
+  if (arguments.action != CommandLineAction::run) {
+    SPDLOG_LOGGER_ERROR(g_logger, "internal client not started:\n{}", arguments.message.str());
+    return 1;
+  }
+  if (arguments.probeCount > 0) {
+    SPDLOG_LOGGER_ERROR(g_logger, "--probe is not available in the internal client.");
+    return 1;
+  }
+  try {
+    open(arguments, client);
+    return 0;
+  } catch (const std::exception &ex) {
+    SPDLOG_LOGGER_ERROR(g_logger, "internal client not started: {}", ex.what());
+  } catch (...) {
+    SPDLOG_LOGGER_ERROR(g_logger, "internal client not started: unknown failure.");
+  }
+  close();
+  return 1;
+}
+
+void stopInternalClient() noexcept { close(); }
+
+ClockEstimate clockEstimate() noexcept {
+  ClockEstimate result;
+  double period = g_clockPeriod.load(std::memory_order_relaxed);
+  if (period <= 0) {
+    return result;
+  }
+  double framesPerMs = jackClient::sampleRate() / 1000.0;
+  if (framesPerMs <= 0) {
+    return result;
+  }
+  result.locked = true;
+  result.bpm = 60000.0 * framesPerMs / (midi::TICKS_PER_QUARTER * period);
+  result.jitterMs = g_clockJitter.load(std::memory_order_relaxed) / framesPerMs;
+  return result;
+}
+
 int run(const CommandLineInterpretation &arguments) noexcept {
 
   configureLogging();
@@ -199,7 +811,7 @@ int run(const CommandLineInterpretation &arguments) noexcept {
     std::cout << arguments.message.str();
     return 0;
   case CommandLineAction::run:
-    return run(arguments.clientName, arguments.connectTo, arguments.startJack);
+    return runBridge(arguments);
   }
 }
 
@@ -19,8 +19,13 @@
 #ifndef A_J_MIDI_SRC_A2JMIDI_H
 #define A_J_MIDI_SRC_A2JMIDI_H
 
+#include "alsa_client.h"
+#include "alsa_receiver_queue.h"
+#include <jack/jack.h>
+#include <istream>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #define APPLICATION "a2jmidi"
 
@@ -30,6 +35,30 @@ std::string open(const std::string &name) noexcept;
 void shutdown() noexcept;
 } // namespace impl
 
+/**
+ * After a discontinuity (xrun, freewheel, hibernation), events older than this
+ * (in milliseconds) are discarded in one go.
+ */
+constexpr int DEFAULT_MAX_EVENT_AGE_MS{50};
+
+/**
+ * A latency offset for the events of one source (see `--latency-profiles`).
+ */
+struct LatencyProfile {
+  std::string designation; ///< the sender-port, designated as in `--connect`.
+  double milliseconds{0};  ///< positive values delay the events of this source.
+};
+
+/**
+ * Read latency profiles, one per line, in the form `designation = milliseconds`.
+ *
+ * Text following a `#` is a comment. The designation may be enclosed in double quotes.
+ * @param input - the text to read.
+ * @return the profiles, in the order of the input.
+ * @throws std::invalid_argument - if a line cannot be interpreted, or there are too many lines.
+ */
+std::vector<LatencyProfile> parseLatencyProfiles(std::istream &input) noexcept(false);
+
 /**
  * The command line action indicates what the program should do after having interpreted the command
  * line.
@@ -51,8 +80,24 @@ public:
   std::stringstream message;                                         ///< a message to display
   CommandLineAction action{CommandLineAction::run};                  ///< what shall the app do
   std::string clientName{APPLICATION}; ///< a proposed default device name
-  std::string connectTo;               ///< name of a port to connect to
+  std::vector<std::string> connectTo;  ///< names of the ports to connect to
+  std::string rawMidiDevice;           ///< if not empty, read this rawmidi device directly
+  int probeCount{0};                   ///< if not zero, measure the latency with this many probes
+  std::string probeThrough;            ///< if not empty, send the probes through this port
+  std::vector<LatencyProfile> latencyProfiles; ///< per-source latency offsets
+  bool splitChannels{false};           ///< one JACK port per MIDI channel
+  bool ump{false};                     ///< open the ALSA client in UMP (MIDI 2.0) mode
+  bool smoothClock{false};             ///< re-time MIDI clock messages with a PLL
+  bool j2a{false};                     ///< reverse direction, from JACK to ALSA
+  bool autoConnect{false};             ///< one JACK port for each matching ALSA port
+  alsaClient::AutoFilter autoFilter;   ///< which ALSA ports are bridged automatically
+  std::string controlSocket;           ///< if not empty, serve requests on this socket
   bool startJack{false};               ///< should the JACK server be started
+  alsaClient::receiverQueue::Limits queueLimits; ///< the ceiling for the receiver queue
+  int maxEventAgeMs{DEFAULT_MAX_EVENT_AGE_MS}; ///< the age of events discarded on resync
+  alsaClient::InputPool inputPool;             ///< the sizes of the ALSA input buffers
+  alsaClient::receiverQueue::IngestionMode ingestionMode{
+      alsaClient::receiverQueue::IngestionMode::library}; ///< how events are read from ALSA
 };
 
 /**
@@ -63,7 +108,45 @@ public:
  */
 CommandLineInterpretation parseCommandLine(int ac, const char *av[]) noexcept;
 
+/**
+ * Interpret options given as one string, such as the load-init string of the internal
+ * client. The string is split like a shell would do (quotes and backslashes are honoured).
+ * @param arguments - the options, without the program name.
+ * @return whatever follows from interpreting the options.
+ */
+CommandLineInterpretation parseArguments(const std::string &arguments) noexcept;
+
 int run(const CommandLineInterpretation &arguments) noexcept;
 
+/**
+ * Start the bridge inside the JACK server process, on a session opened by the server.
+ *
+ * Nothing blocks: the bridge runs until `stopInternalClient` is called.
+ * @param client - the session handed over by `jack_initialize`.
+ * @param arguments - the interpreted load-init string.
+ * @return zero on success, non zero if the bridge could not be started.
+ */
+int startInternalClient(jack_client_t *client, const CommandLineInterpretation &arguments) noexcept;
+
+/**
+ * Stop a bridge started by `startInternalClient`.
+ */
+void stopInternalClient() noexcept;
+
+/**
+ * The incoming MIDI clock, as followed by the clock smoothing (`--smooth-clock`).
+ */
+struct ClockEstimate {
+  bool locked{false}; ///< true if a steady clock is followed.
+  double bpm{0};      ///< the tempo, in quarter notes per minute.
+  double jitterMs{0}; ///< the jitter of the arrival times (root mean square), in milliseconds.
+};
+
+/**
+ * The current estimate of the clock smoothing.
+ * @return the estimate; not locked if clock smoothing is off or no clock is received.
+ */
+ClockEstimate clockEstimate() noexcept;
+
 } // namespace a2jmidi
 #endif // A_J_MIDI_SRC_A2JMIDI_H
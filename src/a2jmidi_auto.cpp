@@ -0,0 +1,290 @@
+/*
+ * File: a2jmidi_auto.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "a2jmidi_auto.h"
+#include "jack_client.h"
+#include "spdlog/sinks/stdout_color_sinks.h"
+#include "spdlog/spdlog.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <jack/midiport.h>
+#include <mutex>
+#include <thread>
+
+namespace a2jmidi::autoBridge {
+
+static auto g_logger = spdlog::stdout_color_mt("a2jmidi_auto");
+
+/**
+ * One entry of the pool: a JACK port and the ALSA sender-port that it bridges.
+ *
+ * The process callback only reads `port` and `sender` (and counts the events); the other
+ * members are only used by the connection monitor, under `g_slotsMutex`.
+ */
+struct Slot {
+  std::atomic<jackClient::JackPort> port{nullptr}; ///< set while the slot is in use.
+  std::atomic<int> sender{alsaClient::NULL_ID};    ///< the bridged port (see `packedAddress`).
+  std::atomic<long> eventCount{0};                 ///< the events forwarded through the slot.
+  alsaClient::PortID source{alsaClient::NULL_PORT_ID}; ///< the bridged port, or NULL_PORT_ID.
+  std::string name;                                ///< the name of the JACK port.
+};
+
+static std::array<Slot, POOL_SIZE> g_slots;
+/**
+ * Serializes the changes of the pool (the process callback never takes this mutex).
+ */
+static std::mutex g_slotsMutex;
+static bool g_open{false};                  ///< guarded by `g_slotsMutex`.
+static bool g_poolExhaustedReported{false}; ///< guarded by `g_slotsMutex`.
+static std::atomic<long> g_cycleCount{0};   ///< the cycles completed by the process callback.
+static std::atomic<long> g_droppedCount{0}; ///< see `droppedCount()`.
+static midi::MessageFilter *g_messageFilter{nullptr}; ///< see `open`.
+
+inline namespace impl {
+
+std::string jackPortName(const std::string &clientName, const std::string &portName) {
+  std::string result = (portName.compare(0, clientName.size(), clientName) == 0)
+                           ? portName
+                           : clientName + " " + portName;
+  std::replace(result.begin(), result.end(), ':', '-');
+  return result;
+}
+
+/**
+ * Pack a sender address into one integer, so that it can be stored atomically.
+ */
+inline int packedAddress(const alsaClient::PortID &port) { return (port.client << 16) | port.port; }
+
+/**
+ * The events of one period, on their way to the JACK ports of their senders.
+ */
+struct Routing {
+  int count{0};                                     ///< the slots in use during this period.
+  std::array<void *, POOL_SIZE> buffers{};          ///< the JACK buffers of these slots.
+  std::array<int, POOL_SIZE> senders{};             ///< their senders (see `packedAddress`).
+  std::array<Slot *, POOL_SIZE> slots{};            ///< the slots themselves.
+  std::array<a2jmidi::TimePoint, POOL_SIZE> last{}; ///< JACK wants events in time order.
+  a2jmidi::TimePoint deadline{0};
+  int nFrames{0};
+
+  int operator()(const alsaClient::PendingEvent &event, a2jmidi::TimePoint timeStamp) {
+    if (!g_messageFilter->passes(event.status())) {
+      return 0;
+    }
+    int sender = packedAddress(event.sender());
+    int i = 0;
+    while (i < count && senders[i] != sender) {
+      i++;
+    }
+    if (i == count) {
+      g_droppedCount.fetch_add(1, std::memory_order_relaxed);
+      return 0;
+    }
+    a2jmidi::TimePoint position = nFrames - (deadline - timeStamp);
+    position = std::clamp(position, last[i], static_cast<a2jmidi::TimePoint>(nFrames - 1));
+    last[i] = position;
+    jack_midi_data_t *data = jack_midi_event_reserve(
+        buffers[i], static_cast<jack_nframes_t>(position), event.size());
+    if (!data) {
+      g_droppedCount.fetch_add(1, std::memory_order_relaxed);
+      return 0;
+    }
+    event.writeTo(data);
+    slots[i]->eventCount.fetch_add(1, std::memory_order_relaxed);
+    return 0;
+  }
+};
+
+/**
+ * The process callback: route the events of the period to the ports of the pool.
+ *
+ * Real-time safe: the routing table lives on the stack, the callback given to
+ * `retrieveDirect` only captures its address.
+ * @param nFrames - the number of frames in this period.
+ * @param deadline - the start of this period minus the jitter compensation; the events
+ * received before it are written into this period.
+ * @return zero on success, a non zero value if an error occurred.
+ */
+int process(int nFrames, a2jmidi::TimePoint deadline) {
+  Routing routing;
+  routing.deadline = deadline;
+  routing.nFrames = nFrames;
+  for (auto &slot : g_slots) {
+    jackClient::JackPort port = slot.port.load(std::memory_order_acquire);
+    if (!port) {
+      continue;
+    }
+    void *buffer = jack_port_get_buffer(port, static_cast<jack_nframes_t>(nFrames));
+    jack_midi_clear_buffer(buffer);
+    routing.buffers[routing.count] = buffer;
+    routing.senders[routing.count] = slot.sender.load(std::memory_order_relaxed);
+    routing.slots[routing.count] = &slot;
+    routing.count++;
+  }
+  int err = alsaClient::retrieveDirect(
+      deadline, [&routing](const alsaClient::PendingEvent &event, a2jmidi::TimePoint timeStamp) {
+        return routing(event, timeStamp);
+      });
+  g_cycleCount.fetch_add(1, std::memory_order_release);
+  return err;
+}
+
+/**
+ * Wait until the process callback has started a cycle after the caller has changed the pool
+ * (a cycle in progress may still use the previous state). Returns at once when JACK does
+ * not run the callback.
+ */
+void waitForNextCycle() {
+  using namespace std::chrono_literals;
+  if (jackClient::state() != jackClient::State::running) {
+    return;
+  }
+  long start = g_cycleCount.load(std::memory_order_acquire);
+  auto giveUp = std::chrono::steady_clock::now() + 500ms;
+  while (g_cycleCount.load(std::memory_order_acquire) < start + 2 &&
+         std::chrono::steady_clock::now() < giveUp) {
+    std::this_thread::sleep_for(1ms);
+  }
+}
+
+/**
+ * Put a newly discovered ALSA port into a free slot, with a new JACK port.
+ * @return false if the pool is exhausted.
+ */
+bool attach(const alsaClient::PortID &source, const std::string &clientName,
+            const std::string &portName) {
+  auto freeSlot = std::find_if(g_slots.begin(), g_slots.end(), [](const Slot &slot) {
+    return slot.source == alsaClient::NULL_PORT_ID;
+  });
+  if (freeSlot == g_slots.end()) {
+    if (!g_poolExhaustedReported) {
+      SPDLOG_LOGGER_WARN(g_logger, "all {} ports in use, \"{}:{}\" is not bridged.", POOL_SIZE,
+                         clientName, portName);
+      g_poolExhaustedReported = true;
+    }
+    return false;
+  }
+  std::string name = jackPortName(clientName, portName);
+  if (std::any_of(g_slots.begin(), g_slots.end(),
+                  [&name](const Slot &slot) { return slot.name == name; })) {
+    // two devices of the same model.
+    name += " [" + std::to_string(source.client) + "-" + std::to_string(source.port) + "]";
+  }
+  jackClient::JackPort port = jackClient::addSenderPort(name);
+  freeSlot->source = source;
+  freeSlot->name = name;
+  freeSlot->eventCount = 0;
+  freeSlot->sender.store(packedAddress(source), std::memory_order_relaxed);
+  freeSlot->port.store(port, std::memory_order_release);
+  SPDLOG_LOGGER_INFO(g_logger, "JACK port \"{}\" created for ALSA port {}:{}.", name,
+                     source.client, source.port);
+  return true;
+}
+
+/**
+ * Empty the slot of an ALSA port that has gone, and remove its JACK port.
+ */
+void detach(const alsaClient::PortID &source) {
+  auto slot = std::find_if(g_slots.begin(), g_slots.end(),
+                           [&source](const Slot &candidate) { return candidate.source == source; });
+  if (slot == g_slots.end()) {
+    return;
+  }
+  jackClient::JackPort port = slot->port.exchange(nullptr);
+  waitForNextCycle();
+  jackClient::removeSenderPort(port);
+  SPDLOG_LOGGER_INFO(g_logger, "JACK port \"{}\" removed ({} events forwarded).", slot->name,
+                     slot->eventCount.load());
+  slot->sender = alsaClient::NULL_ID;
+  slot->source = alsaClient::NULL_PORT_ID;
+  slot->name.clear();
+  g_poolExhaustedReported = false;
+}
+
+/**
+ * The `OnAutoSourceHandler`, called by the connection monitor of the `alsaClient`.
+ */
+bool onSource(alsaClient::PortID source, const std::string &clientName,
+              const std::string &portName, bool added) {
+  std::unique_lock<std::mutex> lock{g_slotsMutex};
+  if (!g_open) {
+    return false;
+  }
+  try {
+    if (added) {
+      return attach(source, clientName, portName);
+    }
+    detach(source);
+  } catch (const std::exception &error) {
+    SPDLOG_LOGGER_ERROR(g_logger, "cannot bridge \"{}:{}\" ({}).", clientName, portName,
+                        error.what());
+  }
+  return false;
+}
+} // namespace impl
+
+void open(const alsaClient::AutoFilter &filter,
+          midi::MessageFilter &messageFilter) noexcept(false) {
+  {
+    std::unique_lock<std::mutex> lock{g_slotsMutex};
+    for (auto &slot : g_slots) {
+      slot.port = nullptr;
+      slot.sender = alsaClient::NULL_ID;
+      slot.eventCount = 0;
+      slot.source = alsaClient::NULL_PORT_ID;
+      slot.name.clear();
+    }
+    g_droppedCount = 0;
+    g_messageFilter = &messageFilter;
+    g_poolExhaustedReported = false;
+    g_open = true;
+  }
+  alsaClient::setAutoConnect(filter, onSource);
+  jackClient::registerProcessCallback(process);
+}
+
+void close() noexcept {
+  std::unique_lock<std::mutex> lock{g_slotsMutex};
+  if (!g_open) {
+    return;
+  }
+  g_open = false;
+  for (const auto &slot : g_slots) {
+    if (slot.source != alsaClient::NULL_PORT_ID) {
+      SPDLOG_LOGGER_INFO(g_logger, "port \"{}\": {} events.", slot.name, slot.eventCount.load());
+    }
+  }
+  SPDLOG_LOGGER_INFO(g_logger, "{} events dropped.", g_droppedCount.load());
+}
+
+bool isOpen() noexcept {
+  std::unique_lock<std::mutex> lock{g_slotsMutex};
+  return g_open;
+}
+
+int bridgedCount() noexcept {
+  return static_cast<int>(std::count_if(g_slots.begin(), g_slots.end(), [](const Slot &slot) {
+    return slot.port.load(std::memory_order_relaxed) != nullptr;
+  }));
+}
+
+long droppedCount() noexcept { return g_droppedCount; }
+
+} // namespace a2jmidi::autoBridge
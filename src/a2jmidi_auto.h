@@ -0,0 +1,96 @@
+/*
+ * File: a2jmidi_auto.h
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef A_J_MIDI_SRC_A2JMIDI_AUTO_H
+#define A_J_MIDI_SRC_A2JMIDI_AUTO_H
+
+#include "alsa_client.h"
+#include <string>
+
+/**
+ * The automatic mode (`--auto`): one JACK port for each ALSA sender-port that passes a filter,
+ * created when the port appears and removed when it goes.
+ *
+ * All sender-ports are connected to the one receiver port of the `alsaClient`, so they share
+ * its listener; the process callback routes each event to the JACK port of its sender.
+ * The JACK ports are kept in a pool of preallocated slots: the connection monitor fills and
+ * empties the slots, the process callback only reads them, so hot-plugging never allocates
+ * nor waits on the real-time side.
+ */
+namespace a2jmidi::autoBridge {
+
+/**
+ * The number of slots in the pool, thus the largest number of ports bridged at the same time.
+ */
+constexpr int POOL_SIZE{alsaClient::MAX_AUTO_SOURCES};
+
+/**
+ * Implementation specific stuff.
+ */
+inline namespace impl {
+/**
+ * The name of the JACK port that bridges an ALSA sender-port.
+ *
+ * The client name is left out when the port name already starts with it (as for most
+ * USB devices); colons, which JACK uses to separate the client name, are replaced.
+ * @param clientName - the name of the ALSA client.
+ * @param portName - the name of the ALSA port.
+ * @return the short name of the JACK port.
+ */
+std::string jackPortName(const std::string &clientName, const std::string &portName);
+} // namespace impl
+
+/**
+ * Let the `alsaClient` discover the ports that pass the filter, and register the process
+ * callback that routes their events.
+ *
+ * The JACK client must be open and the ALSA client must have its receiver port, both in
+ * `idle` state. The first ports are bridged when the `alsaClient` is activated.
+ * @param filter - which sender-ports to bridge.
+ * @param messageFilter - the kinds of messages to hold back (must outlive the bridge).
+ * @throws std::runtime_error - (or one of its subclasses) if a client is in the wrong state.
+ */
+void open(const alsaClient::AutoFilter &filter,
+          midi::MessageFilter &messageFilter) noexcept(false);
+
+/**
+ * Stop bridging new ports and report the counters.
+ *
+ * Shall be called before the JACK and ALSA clients are closed (which remove the ports).
+ * Does nothing when the automatic mode has not been opened.
+ */
+void close() noexcept;
+
+/**
+ * Indicates whether the automatic mode is in use.
+ */
+bool isOpen() noexcept;
+
+/**
+ * The number of ports currently bridged.
+ */
+int bridgedCount() noexcept;
+
+/**
+ * The number of events that could not be forwarded (sender not bridged, or JACK buffer full).
+ */
+long droppedCount() noexcept;
+
+} // namespace a2jmidi::autoBridge
+
+#endif // A_J_MIDI_SRC_A2JMIDI_AUTO_H
@@ -18,8 +18,16 @@
  */
 #ifndef A_J_MIDI_SRC_A2JMIDI_CLOCK_H
 #define A_J_MIDI_SRC_A2JMIDI_CLOCK_H
+#include <cstdint>
 #include <memory>
 namespace a2jmidi {
+/**
+ * A point in time, measured in frames (or some replacing concept for tests).
+ *
+ * We use 64 bits, so that a time point never wraps during the lifetime of a process.
+ */
+using TimePoint = std::int64_t;
+
 /**
  * An abstract class representing a clock.
  * This class permits to define an application specific clock.
@@ -34,7 +42,7 @@ public:
    * The estimated current time in frames (or some replacing concept for tests).
    * @return the estimated current time in in frames.
    */
-  virtual long now() = 0;
+  virtual TimePoint now() = 0;
 };
 /**
  * A smart pointer that owns and manages an Clock-object through a pointer and
@@ -42,8 +50,5 @@ public:
  */
 using ClockPtr = std::unique_ptr<Clock>;
 
-using TimePoint = long;
-
-
 } // namespace a2jmidi
 #endif // A_J_MIDI_SRC_A2JMIDI_CLOCK_H
@@ -19,6 +19,7 @@
 #include "a2jmidi.h"
 #include "version.h"
 #include <boost/program_options.hpp>
+#include <fstream>
 
 using namespace std;
 namespace boostPO = boost::program_options;
@@ -35,6 +36,127 @@ namespace a2jmidi {
 #define CLIENT_NAME_OPT "name"
 #define START_SERVER_OPT "startjack"
 #define CONNECT_TO "connect"
+#define QUEUE_MAX_EVENTS_OPT "queue-max-events"
+#define QUEUE_MAX_BYTES_OPT "queue-max-bytes"
+#define OVERFLOW_OPT "overflow"
+#define MAX_EVENT_AGE_OPT "max-event-age"
+#define INPUT_POOL_OPT "input-pool"
+#define INPUT_BUFFER_OPT "input-buffer"
+#define ADAPTIVE_POOL_OPT "adaptive-pool"
+#define RAW_INPUT_OPT "raw-input"
+#define SPLIT_CHANNELS_OPT "split-channels"
+#define RAWMIDI_OPT "rawmidi"
+#define PROBE_OPT "probe"
+#define UMP_OPT "ump"
+#define SMOOTH_CLOCK_OPT "smooth-clock"
+#define LATENCY_PROFILES_OPT "latency-profiles"
+#define PROBE_THROUGH_OPT "probe-through"
+#define J2A_OPT "j2a"
+#define AUTO_OPT "auto"
+#define AUTO_FILTER_OPT "auto-filter"
+#define CONTROL_OPT "control"
+
+/**
+ * Translate the value given with the `--overflow` option into an `OverflowPolicy`.
+ * @param value - one of "drop-oldest", "drop-newest" or "coalesce".
+ * @return the corresponding policy.
+ * @throws boost::program_options::invalid_option_value - if the value is not recognized.
+ */
+alsaClient::receiverQueue::OverflowPolicy toOverflowPolicy(const string &value) {
+  using alsaClient::receiverQueue::OverflowPolicy;
+  if (value == "drop-oldest") {
+    return OverflowPolicy::dropOldest;
+  }
+  if (value == "drop-newest") {
+    return OverflowPolicy::dropNewest;
+  }
+  if (value == "coalesce") {
+    return OverflowPolicy::coalesceControllers;
+  }
+  throw boostPO::invalid_option_value(value);
+}
+
+/**
+ * Translate the value given with the `--auto-filter` option into a `ClientKind`.
+ * @param value - one of "hardware", "software" or "all".
+ * @return the corresponding kind of client.
+ * @throws boost::program_options::invalid_option_value - if the value is not recognized.
+ */
+alsaClient::ClientKind toClientKind(const string &value) {
+  using alsaClient::ClientKind;
+  if (value == "hardware") {
+    return ClientKind::hardware;
+  }
+  if (value == "software") {
+    return ClientKind::software;
+  }
+  if (value == "all") {
+    return ClientKind::all;
+  }
+  throw boostPO::invalid_option_value(value);
+}
+
+/**
+ * Remove leading and trailing white space.
+ */
+static string trimmed(const string &text) {
+  const char *space = " \t\r";
+  auto first = text.find_first_not_of(space);
+  if (first == string::npos) {
+    return {};
+  }
+  return text.substr(first, text.find_last_not_of(space) - first + 1);
+}
+
+std::vector<LatencyProfile> parseLatencyProfiles(std::istream &input) noexcept(false) {
+  std::vector<LatencyProfile> result;
+  string line;
+  for (int lineNumber = 1; std::getline(input, line); lineNumber++) {
+    auto error = [lineNumber](const string &what) {
+      return std::invalid_argument("latency profiles, line " + std::to_string(lineNumber) +
+                                   ": " + what);
+    };
+    auto comment = line.find('#');
+    if (comment != string::npos) {
+      line.erase(comment);
+    }
+    line = trimmed(line);
+    if (line.empty()) {
+      continue;
+    }
+    // the designation may itself contain '=', the value never does.
+    auto separator = line.rfind('=');
+    if (separator == string::npos) {
+      throw error("expected \"designation = milliseconds\".");
+    }
+    LatencyProfile profile;
+    profile.designation = trimmed(line.substr(0, separator));
+    if (profile.designation.size() >= 2 && profile.designation.front() == '"' &&
+        profile.designation.back() == '"') {
+      profile.designation = profile.designation.substr(1, profile.designation.size() - 2);
+    }
+    if (profile.designation.empty()) {
+      throw error("the designation is missing.");
+    }
+    string value = trimmed(line.substr(separator + 1));
+    size_t parsed = 0;
+    try {
+      profile.milliseconds = std::stod(value, &parsed);
+    } catch (const std::logic_error &) {
+      parsed = 0;
+    }
+    if (parsed == 0 || parsed != value.size()) {
+      throw error("\"" + value + "\" is not a number of milliseconds.");
+    }
+    result.push_back(profile);
+  }
+  if (result.size() > static_cast<size_t>(alsaClient::MAX_LATENCY_OFFSETS)) {
+    throw std::invalid_argument("latency profiles: at most " +
+                                std::to_string(alsaClient::MAX_LATENCY_OFFSETS) +
+                                " entries are supported.");
+  }
+  return result;
+}
 
 /**
  * This function provides the Command-Line-Interface (CLI)
@@ -57,8 +179,40 @@ CommandLineInterpretation parseCommandLine(int ac, const char *av[]) noexcept {
         (HELP_OPT ",h", "display this help and exit")                                  //
         (VERSION_OPT ",v", "display version information and exit")                     //
         (START_SERVER_OPT ",s", "Try to start the JACK server if not already running") //
-        (CONNECT_TO ",c", boostPO::value<string>(), "connect to an ALSA port")            //
-        (CLIENT_NAME_OPT ",n", boostPO::value<string>(), "(optional) client name");
+        (CONNECT_TO ",c", boostPO::value<vector<string>>(),
+         "connect to an ALSA port (can be repeated)")                                 //
+        (CLIENT_NAME_OPT ",n", boostPO::value<string>(), "(optional) client name")     //
+        (QUEUE_MAX_EVENTS_OPT, boostPO::value<int>(),
+         "maximum number of events held while JACK is not processing")                  //
+        (QUEUE_MAX_BYTES_OPT, boostPO::value<long>(),
+         "maximum memory (in bytes) used by events held while JACK is not processing") //
+        (OVERFLOW_OPT, boostPO::value<string>(),
+         "what to do when the queue is full: drop-oldest (default), drop-newest or coalesce") //
+        (MAX_EVENT_AGE_OPT, boostPO::value<int>(),
+         "after an xrun or freewheeling, discard events older than this (in ms)") //
+        (INPUT_POOL_OPT, boostPO::value<int>(),
+         "number of events in the ALSA kernel input pool (at most 2000)") //
+        (INPUT_BUFFER_OPT, boostPO::value<size_t>(),
+         "size (in bytes) of the ALSA library input buffer")             //
+        (ADAPTIVE_POOL_OPT, "grow the ALSA kernel input pool each time it overflows") //
+        (RAW_INPUT_OPT, "read incoming ALSA events in bulk, bypassing alsa-lib") //
+        (RAWMIDI_OPT, boostPO::value<string>(),
+         "read a hardware port directly (for example hw:1,0,0), bypassing the sequencer") //
+        (PROBE_OPT, boostPO::value<int>(),
+         "send this many probe notes through the bridge, report the latency and exit") //
+        (SPLIT_CHANNELS_OPT, "create one JACK port per MIDI channel")                 //
+        (UMP_OPT, "receive MIDI 2.0 packets (UMP), translate them to MIDI 1.0 for JACK") //
+        (SMOOTH_CLOCK_OPT, "remove the arrival jitter of MIDI clock messages") //
+        (LATENCY_PROFILES_OPT, boostPO::value<string>(),
+         "read per-source latency offsets (lines of \"port = ms\") from this file") //
+        (PROBE_THROUGH_OPT, boostPO::value<string>(),
+         "send the probe notes to this ALSA port, to measure an external loop") //
+        (J2A_OPT, "reverse direction: forward a JACK input port to an ALSA output port") //
+        (AUTO_OPT, "create a JACK port for each ALSA input as it comes and goes")         //
+        (AUTO_FILTER_OPT, boostPO::value<string>(),
+         "which ALSA inputs --auto bridges: hardware (default), software or all") //
+        (CONTROL_OPT, boostPO::value<string>(),
+         "accept requests on this Unix-domain socket to reconfigure the running bridge");
 
     try {
       // client name as a positional argument
@@ -98,10 +252,127 @@ CommandLineInterpretation parseCommandLine(int ac, const char *av[]) noexcept {
       }
 
       if (varMap.count(CONNECT_TO)) {
-        // set the client name as named variable
-        result.connectTo = varMap[CONNECT_TO].as<string>();
+        // set the ports to connect to
+        result.connectTo = varMap[CONNECT_TO].as<vector<string>>();
       } else {
-        result.connectTo = "";
+        result.connectTo.clear();
+      }
+
+      if (varMap.count(QUEUE_MAX_EVENTS_OPT)) {
+        result.queueLimits.maxEvents = varMap[QUEUE_MAX_EVENTS_OPT].as<int>();
+        if (result.queueLimits.maxEvents <= 0) {
+          throw boostPO::invalid_option_value(std::to_string(result.queueLimits.maxEvents));
+        }
+      }
+
+      if (varMap.count(QUEUE_MAX_BYTES_OPT)) {
+        result.queueLimits.maxBytes = varMap[QUEUE_MAX_BYTES_OPT].as<long>();
+        if (result.queueLimits.maxBytes <= 0) {
+          throw boostPO::invalid_option_value(std::to_string(result.queueLimits.maxBytes));
+        }
+      }
+
+      if (varMap.count(OVERFLOW_OPT)) {
+        result.queueLimits.policy = toOverflowPolicy(varMap[OVERFLOW_OPT].as<string>());
+      }
+
+      if (varMap.count(MAX_EVENT_AGE_OPT)) {
+        result.maxEventAgeMs = varMap[MAX_EVENT_AGE_OPT].as<int>();
+        if (result.maxEventAgeMs <= 0) {
+          throw boostPO::invalid_option_value(std::to_string(result.maxEventAgeMs));
+        }
+      }
+
+      if (varMap.count(INPUT_POOL_OPT)) {
+        result.inputPool.poolSize = varMap[INPUT_POOL_OPT].as<int>();
+      }
+
+      if (varMap.count(INPUT_BUFFER_OPT)) {
+        result.inputPool.bufferSize = varMap[INPUT_BUFFER_OPT].as<size_t>();
+      }
+
+      if (varMap.count(ADAPTIVE_POOL_OPT)) {
+        result.inputPool.adaptive = true;
+      }
+
+      if (varMap.count(SPLIT_CHANNELS_OPT)) {
+        result.splitChannels = true;
+      }
+
+      if (varMap.count(UMP_OPT)) {
+        result.ump = true;
+      }
+
+      if (varMap.count(SMOOTH_CLOCK_OPT)) {
+        result.smoothClock = true;
+      }
+
+      if (varMap.count(RAWMIDI_OPT)) {
+        result.rawMidiDevice = varMap[RAWMIDI_OPT].as<string>();
+      }
+
+      if (varMap.count(PROBE_OPT)) {
+        result.probeCount = varMap[PROBE_OPT].as<int>();
+        if (result.probeCount <= 0) {
+          throw boostPO::invalid_option_value(std::to_string(result.probeCount));
+        }
+        if (!result.rawMidiDevice.empty()) {
+          throw boostPO::error("--" PROBE_OPT " cannot be combined with --" RAWMIDI_OPT);
+        }
+      }
+
+      if (varMap.count(PROBE_THROUGH_OPT)) {
+        if (!varMap.count(PROBE_OPT)) {
+          throw boostPO::error("--" PROBE_THROUGH_OPT " requires --" PROBE_OPT);
+        }
+        result.probeThrough = varMap[PROBE_THROUGH_OPT].as<string>();
+      }
+
+      if (varMap.count(LATENCY_PROFILES_OPT)) {
+        const auto &fileName = varMap[LATENCY_PROFILES_OPT].as<string>();
+        std::ifstream file{fileName};
+        if (!file) {
+          throw boostPO::error("cannot read the latency profiles \"" + fileName + "\"");
+        }
+        result.latencyProfiles = parseLatencyProfiles(file);
+      }
+
+      if (varMap.count(J2A_OPT)) {
+        result.j2a = true;
+        if (!result.rawMidiDevice.empty() || result.probeCount > 0) {
+          throw boostPO::error("--" J2A_OPT " cannot be combined with --" RAWMIDI_OPT
+                               " or --" PROBE_OPT);
+        }
+      }
+
+      if (varMap.count(AUTO_OPT)) {
+        result.autoConnect = true;
+        if (!result.rawMidiDevice.empty() || result.probeCount > 0 || result.j2a) {
+          throw boostPO::error("--" AUTO_OPT " cannot be combined with --" RAWMIDI_OPT
+                               ", --" PROBE_OPT " or --" J2A_OPT);
+        }
+        if (!result.connectTo.empty() || result.splitChannels || result.smoothClock) {
+          throw boostPO::error("--" AUTO_OPT " cannot be combined with --" CONNECT_TO
+                               ", --" SPLIT_CHANNELS_OPT " or --" SMOOTH_CLOCK_OPT);
+        }
+      }
+
+      if (varMap.count(AUTO_FILTER_OPT)) {
+        if (!result.autoConnect) {
+          throw boostPO::error("--" AUTO_FILTER_OPT " requires --" AUTO_OPT);
+        }
+        result.autoFilter.clientKind = toClientKind(varMap[AUTO_FILTER_OPT].as<string>());
+      }
+
+      if (varMap.count(CONTROL_OPT)) {
+        if (result.probeCount > 0) {
+          throw boostPO::error("--" CONTROL_OPT " cannot be combined with --" PROBE_OPT);
+        }
+        result.controlSocket = varMap[CONTROL_OPT].as<string>();
+      }
+
+      if (varMap.count(RAW_INPUT_OPT)) {
+        result.ingestionMode = alsaClient::receiverQueue::IngestionMode::rawRead;
       }
 
       result.action = CommandLineAction::run;
@@ -122,4 +393,21 @@ CommandLineInterpretation parseCommandLine(int ac, const char *av[]) noexcept {
     return result;
   }
 }
+
+CommandLineInterpretation parseArguments(const std::string &arguments) noexcept {
+  vector<string> tokens;
+  try {
+    tokens = boostPO::split_unix(arguments);
+  } catch (const std::exception &error) {
+    CommandLineInterpretation result;
+    result.message << error.what() << "\n";
+    result.action = CommandLineAction::messageError;
+    return result;
+  }
+  vector<const char *> av{APPLICATION};
+  for (const auto &token : tokens) {
+    av.push_back(token.c_str());
+  }
+  return parseCommandLine(static_cast<int>(av.size()), av.data());
+}
 } // namespace a2jmidi
\ No newline at end of file
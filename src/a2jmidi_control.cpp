@@ -0,0 +1,261 @@
+/*
+ * File: a2jmidi_control.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "a2jmidi_control.h"
+#include "midi.h"
+#include "spdlog/sinks/stdout_color_sinks.h"
+#include "spdlog/spdlog.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <boost/program_options/parsers.hpp>
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+
+namespace a2jmidi::control {
+
+static auto g_logger = spdlog::stdout_color_mt("a2jmidi_control");
+
+/**
+ * How often (in milliseconds) the server thread looks whether it shall end.
+ */
+constexpr int POLL_INTERVAL_MS{200};
+
+static int g_listeningSocket{-1};
+static std::string g_path;
+static CommandHandler g_handler;
+static std::thread g_serverThread;
+static std::atomic<bool> g_serverActive{false};
+
+/**
+ * The names of the message classes, as used in requests.
+ */
+static const std::array<std::pair<const char *, unsigned int>, 9> g_messageClasses{{
+    {"note", midi::messageClass::NOTE},
+    {"control", midi::messageClass::CONTROL},
+    {"program", midi::messageClass::PROGRAM},
+    {"pressure", midi::messageClass::PRESSURE},
+    {"pitchbend", midi::messageClass::PITCH_BEND},
+    {"sysex", midi::messageClass::SYSEX},
+    {"clock", midi::messageClass::CLOCK},
+    {"sensing", midi::messageClass::ACTIVE_SENSING},
+    {"system", midi::messageClass::SYSTEM},
+}};
+
+inline namespace impl {
+
+std::vector<std::string> tokenize(const std::string &line) noexcept(false) {
+  try {
+    return boost::program_options::split_unix(line);
+  } catch (const std::exception &error) {
+    throw std::invalid_argument(error.what());
+  }
+}
+
+std::string respond(const std::string &line, const CommandHandler &handler) {
+  try {
+    std::vector<std::string> words = tokenize(line);
+    if (words.empty()) {
+      return {};
+    }
+    return handler(words) + "OK\n";
+  } catch (const std::exception &error) {
+    std::string reason{error.what()};
+    // the reason must stay on one line.
+    for (char &c : reason) {
+      if (c == '\n' || c == '\r') {
+        c = ' ';
+      }
+    }
+    return "ERR " + reason + "\n";
+  }
+}
+
+unsigned int parseMessageClasses(const std::string &list) noexcept(false) {
+  if (list == "none") {
+    return 0;
+  }
+  unsigned int mask{0};
+  size_t start = 0;
+  while (start <= list.size()) {
+    size_t end = list.find(',', start);
+    if (end == std::string::npos) {
+      end = list.size();
+    }
+    std::string name = list.substr(start, end - start);
+    auto found = std::find_if(g_messageClasses.begin(), g_messageClasses.end(),
+                              [&name](const auto &entry) { return name == entry.first; });
+    if (found == g_messageClasses.end()) {
+      throw std::invalid_argument("unknown message class \"" + name + "\"");
+    }
+    mask |= found->second;
+    start = end + 1;
+  }
+  return mask;
+}
+
+std::string messageClassNames(unsigned int mask) {
+  std::string result;
+  for (const auto &entry : g_messageClasses) {
+    if (mask & entry.second) {
+      result += (result.empty() ? "" : ",") + std::string{entry.first};
+    }
+  }
+  return result.empty() ? "none" : result;
+}
+
+/**
+ * Write the whole text into the connection.
+ * @return false if the peer has gone.
+ */
+bool writeAll(int connection, const std::string &text) {
+  size_t written = 0;
+  while (written < text.size()) {
+    ssize_t n = send(connection, text.data() + written, text.size() - written, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    written += static_cast<size_t>(n);
+  }
+  return true;
+}
+
+/**
+ * Serve one connection until the peer quits or hangs up, or the server is closed.
+ */
+void serve(int connection) {
+  std::string pending;
+  std::array<char, 256> buffer{};
+  while (g_serverActive) {
+    pollfd request{connection, POLLIN, 0};
+    int ready = poll(&request, 1, POLL_INTERVAL_MS);
+    if (ready < 0 && errno != EINTR) {
+      return;
+    }
+    if (ready <= 0) {
+      continue;
+    }
+    ssize_t n = read(connection, buffer.data(), buffer.size());
+    if (n <= 0) {
+      return;
+    }
+    pending.append(buffer.data(), static_cast<size_t>(n));
+    size_t end;
+    while ((end = pending.find('\n')) != std::string::npos) {
+      std::string line = pending.substr(0, end);
+      pending.erase(0, end + 1);
+      if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+      }
+      if (line == "quit") {
+        writeAll(connection, "OK\n");
+        return;
+      }
+      SPDLOG_LOGGER_DEBUG(g_logger, "request \"{}\".", line);
+      if (!writeAll(connection, respond(line, g_handler))) {
+        return;
+      }
+    }
+    if (pending.size() > MAX_LINE_LENGTH) {
+      writeAll(connection, "ERR request too long\n");
+      return;
+    }
+  }
+}
+
+/**
+ * The body of the server thread: accept one connection after the other.
+ */
+void serverLoop() {
+  while (g_serverActive) {
+    pollfd listening{g_listeningSocket, POLLIN, 0};
+    if (poll(&listening, 1, POLL_INTERVAL_MS) <= 0) {
+      continue;
+    }
+    int connection = accept4(g_listeningSocket, nullptr, nullptr, SOCK_CLOEXEC);
+    if (connection < 0) {
+      continue;
+    }
+    serve(connection);
+    ::close(connection);
+  }
+}
+} // namespace impl
+
+void open(const std::string &path, const CommandHandler &handler) noexcept(false) {
+  if (isOpen()) {
+    throw std::runtime_error("The control socket is already open.");
+  }
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+    throw std::runtime_error("Invalid control socket path \"" + path + "\".");
+  }
+  std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+  // a socket left behind by a bridge that has crashed.
+  struct stat existing {};
+  if (stat(path.c_str(), &existing) == 0 && S_ISSOCK(existing.st_mode)) {
+    unlink(path.c_str());
+  }
+  int listeningSocket = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listeningSocket < 0) {
+    throw std::runtime_error(std::string{"Cannot create control socket: "} +
+                             std::strerror(errno));
+  }
+  if (bind(listeningSocket, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) < 0 ||
+      chmod(path.c_str(), S_IRUSR | S_IWUSR) < 0 || listen(listeningSocket, 4) < 0) {
+    std::string reason{std::strerror(errno)};
+    ::close(listeningSocket);
+    throw std::runtime_error("Cannot open control socket \"" + path + "\": " + reason);
+  }
+  g_listeningSocket = listeningSocket;
+  g_path = path;
+  g_handler = handler;
+  g_serverActive = true;
+  g_serverThread = std::thread(serverLoop);
+  SPDLOG_LOGGER_INFO(g_logger, "control socket \"{}\" open.", path);
+}
+
+void close() noexcept {
+  if (!g_serverThread.joinable()) {
+    return;
+  }
+  g_serverActive = false;
+  g_serverThread.join();
+  ::close(g_listeningSocket);
+  unlink(g_path.c_str());
+  g_listeningSocket = -1;
+  g_path.clear();
+  g_handler = nullptr;
+}
+
+bool isOpen() noexcept { return g_serverThread.joinable(); }
+
+} // namespace a2jmidi::control
@@ -0,0 +1,112 @@
+/*
+ * File: a2jmidi_control.h
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef A_J_MIDI_SRC_A2JMIDI_CONTROL_H
+#define A_J_MIDI_SRC_A2JMIDI_CONTROL_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * The control socket (`--control`): a Unix-domain socket on which a running bridge
+ * accepts requests, one per line.
+ *
+ * A request is a command followed by its arguments, separated by blanks (arguments can be
+ * quoted as in a shell). The response consists of zero or more lines of data, followed by a
+ * line that reads either `OK` or `ERR` and a reason. The request `quit` closes the
+ * connection. One connection is served at a time, on a thread of its own; the requests are
+ * executed there, never on the real-time thread.
+ */
+namespace a2jmidi::control {
+
+/**
+ * The longest request that is accepted.
+ */
+constexpr size_t MAX_LINE_LENGTH{1024};
+
+/**
+ * Prototype for the function that executes a request.
+ * @param words - the command and its arguments (at least one word).
+ * @return the lines of data of the response, each one terminated by a newline.
+ * @throws std::exception - if the request cannot be executed; its `what()` is the reason.
+ */
+using CommandHandler = std::function<std::string(const std::vector<std::string> &words)>;
+
+/**
+ * Implementation specific stuff.
+ */
+inline namespace impl {
+/**
+ * Split a request into words, like a shell would do (quotes and backslashes are honoured).
+ * @param line - the request.
+ * @return the words; empty for a blank line.
+ * @throws std::invalid_argument - if the quotes are not balanced.
+ */
+std::vector<std::string> tokenize(const std::string &line) noexcept(false);
+
+/**
+ * Execute one request and produce the complete response.
+ * @param line - the request, without the newline.
+ * @param handler - the function that executes the request.
+ * @return the lines of data, followed by `OK` or `ERR reason`; empty for a blank line.
+ */
+std::string respond(const std::string &line, const CommandHandler &handler);
+
+/**
+ * Interpret a list of message classes, such as `clock,sensing`.
+ * @param list - `none`, or comma separated names: note, control, program, pressure,
+ * pitchbend, sysex, clock, sensing, system.
+ * @return a mask of `midi::messageClass` bits.
+ * @throws std::invalid_argument - if a name is not recognized.
+ */
+unsigned int parseMessageClasses(const std::string &list) noexcept(false);
+
+/**
+ * The names of the message classes in a mask, in the form accepted by `parseMessageClasses`.
+ * @param mask - a mask of `midi::messageClass` bits.
+ * @return the comma separated names, or `none`.
+ */
+std::string messageClassNames(unsigned int mask);
+} // namespace impl
+
+/**
+ * Create the socket and start serving requests.
+ *
+ * A stale socket left at `path` by an earlier run is replaced. The socket can only be used
+ * by the owner of the process.
+ * @param path - the file name of the socket.
+ * @param handler - executes the requests (on the thread of the control socket).
+ * @throws std::runtime_error - if the socket cannot be created.
+ */
+void open(const std::string &path, const CommandHandler &handler) noexcept(false);
+
+/**
+ * Stop serving requests and remove the socket. Does nothing if the socket is not open.
+ */
+void close() noexcept;
+
+/**
+ * Indicates whether the control socket is open.
+ */
+bool isOpen() noexcept;
+
+} // namespace a2jmidi::control
+
+#endif // A_J_MIDI_SRC_A2JMIDI_CONTROL_H
@@ -0,0 +1,54 @@
+/*
+ * File: a2jmidi_internal.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * The entry points of the JACK internal client.
+ *
+ * The bridge is loaded into the JACK server process, so that the process callback runs
+ * on the server's own thread instead of waking up a separate process on every period:
+ *
+ *   jack_load a2jmidi a2jmidi -i "--connect 'USB-MIDI MIDI 1' --split-channels"
+ *
+ * The load-init string takes the same options as the stand-alone application.
+ */
+#include "a2jmidi.h"
+#include <jack/jack.h>
+
+extern "C" {
+
+/**
+ * Called by the JACK server after loading the module.
+ * @param client - the session opened by the server for this internal client.
+ * @param loadInit - the options given with `jack_load -i`.
+ * @return zero on success, non zero to make the server unload the module.
+ */
+__attribute__((visibility("default"))) int jack_initialize(jack_client_t *client,
+                                                           const char *loadInit) {
+  auto arguments = a2jmidi::parseArguments(loadInit ? loadInit : "");
+  return a2jmidi::startInternalClient(client, arguments);
+}
+
+/**
+ * Called by the JACK server before unloading the module.
+ * @param arg - (unused) a pointer to an arbitrary, user supplied, data.
+ */
+__attribute__((visibility("default"))) void jack_finish([[maybe_unused]] void *arg) {
+  a2jmidi::stopInternalClient();
+}
+}
@@ -0,0 +1,171 @@
+/*
+ * File: a2jmidi_j2a.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "a2jmidi_j2a.h"
+#include "alsa_client.h"
+#include "jack_client.h"
+#include "message_ring.h"
+#include "spdlog/sinks/stdout_color_sinks.h"
+#include "spdlog/spdlog.h"
+#include <atomic>
+#include <ctime>
+#include <jack/midiport.h>
+#include <memory>
+#include <semaphore.h>
+#include <thread>
+
+namespace a2jmidi::j2a {
+
+static auto g_logger = spdlog::stdout_color_mt("a2jmidi_j2a");
+
+static jackClient::JackPort g_jackPort{nullptr}; ///< the JACK input port.
+/**
+ * Carries the events from the process callback to the sender thread.
+ */
+static std::unique_ptr<a2jmidi::MessageRing> g_ring;
+/**
+ * Posted by the process callback when there are events to send (`sem_post` never blocks).
+ */
+static sem_t g_periodSemaphore;
+static std::thread g_senderThread;
+static std::atomic<bool> g_senderActive{false};
+static std::atomic<long> g_droppedCount{0}; ///< see `droppedCount()`.
+
+inline namespace impl {
+
+std::chrono::nanoseconds sendDelay(a2jmidi::TimePoint eventTime, a2jmidi::TimePoint now,
+                                   a2jmidi::TimePoint latency, int sampleRate) {
+  a2jmidi::TimePoint frames = eventTime + latency - now;
+  if (frames <= 0 || sampleRate <= 0) {
+    return std::chrono::nanoseconds{0};
+  }
+  return std::chrono::nanoseconds{frames * 1000000000LL / sampleRate};
+}
+
+a2jmidi::TimePoint eventTime(a2jmidi::TimePoint deadline, a2jmidi::TimePoint jitterCompensation,
+                             uint32_t offset) {
+  return deadline + jitterCompensation + offset;
+}
+
+/**
+ * The process callback: copy the events of the input port into the ring.
+ *
+ * Real-time safe: the ring is preallocated and never waits.
+ * @param nFrames - the number of frames in this period.
+ * @param deadline - the start of this period minus the jitter compensation.
+ * @return always zero.
+ */
+int process(int nFrames, a2jmidi::TimePoint deadline) {
+  void *buffer = jack_port_get_buffer(g_jackPort, static_cast<jack_nframes_t>(nFrames));
+  uint32_t count = jack_midi_get_event_count(buffer);
+  const a2jmidi::TimePoint jitterCompensation = jackClient::periodParameters().jitterCompensation;
+  for (uint32_t i = 0; i < count; i++) {
+    jack_midi_event_t event;
+    if (jack_midi_event_get(&event, buffer, i) != 0) {
+      continue;
+    }
+    if (!g_ring->write(eventTime(deadline, jitterCompensation, event.time), event.buffer,
+                       event.size)) {
+      g_droppedCount++;
+    }
+  }
+  if (count > 0) {
+    sem_post(&g_periodSemaphore);
+  }
+  return 0;
+}
+
+/**
+ * Send all events from the ring, then drain the ALSA output buffer once.
+ * @param clock - the JACK frame time.
+ */
+void forward(a2jmidi::Clock &clock) {
+  const auto parameters = jackClient::periodParameters();
+  const a2jmidi::TimePoint now = clock.now();
+  const auto sampleRate = static_cast<int>(parameters.sampleRate);
+  const auto latency = static_cast<a2jmidi::TimePoint>(parameters.bufferSize);
+  int count = g_ring->read([&](a2jmidi::TimePoint time, const unsigned char *bytes, size_t size) {
+    if (alsaClient::output(bytes, size, sendDelay(time, now, latency, sampleRate)) < 0) {
+      g_droppedCount++;
+    }
+  });
+  if (count > 0 && alsaClient::flushOutput() < 0) {
+    SPDLOG_LOGGER_WARN(g_logger, "ALSA did not accept all events of the period.");
+  }
+}
+
+/**
+ * The body of the sender thread: forward the events each time the process callback
+ * has posted some.
+ */
+void senderLoop(a2jmidi::ClockPtr clock) {
+  while (g_senderActive) {
+    // wake up now and then, to notice the end.
+    timespec giveUp{};
+    clock_gettime(CLOCK_REALTIME, &giveUp);
+    giveUp.tv_nsec += 100000000;
+    if (giveUp.tv_nsec >= 1000000000) {
+      giveUp.tv_sec++;
+      giveUp.tv_nsec -= 1000000000;
+    }
+    sem_timedwait(&g_periodSemaphore, &giveUp);
+    forward(*clock);
+  }
+  forward(*clock);
+}
+} // namespace impl
+
+void open(const std::string &clientName, const std::vector<std::string> &connectTo) noexcept(false) {
+  g_ring = std::make_unique<a2jmidi::MessageRing>(RING_CAPACITY);
+  g_droppedCount = 0;
+  sem_init(&g_periodSemaphore, 0, 0);
+
+  g_jackPort = jackClient::newReceiverPort(clientName);
+  jackClient::registerProcessCallback(process);
+
+  alsaClient::open(clientName);
+  alsaClient::newSenderPort(clientName, connectTo);
+  alsaClient::activate(jackClient::clock());
+
+  g_senderActive = true;
+  g_senderThread = std::thread(senderLoop, jackClient::clock());
+  jackClient::activate();
+}
+
+void close() noexcept {
+  if (!g_senderThread.joinable()) {
+    return;
+  }
+  g_senderActive = false;
+  sem_post(&g_periodSemaphore);
+  g_senderThread.join();
+  // let the scheduled events leave the queue before the client goes away.
+  auto parameters = jackClient::periodParameters();
+  if (parameters.sampleRate > 0) {
+    std::this_thread::sleep_for(std::chrono::microseconds{
+        2 * 1000000LL * parameters.bufferSize / parameters.sampleRate});
+  }
+  SPDLOG_LOGGER_INFO(g_logger, "{} events sent to ALSA, {} dropped.", alsaClient::outputCount(),
+                     g_droppedCount.load());
+}
+
+bool isOpen() noexcept { return g_senderThread.joinable(); }
+
+long droppedCount() noexcept { return g_droppedCount; }
+
+} // namespace a2jmidi::j2a
@@ -0,0 +1,104 @@
+/*
+ * File: a2jmidi_j2a.h
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef A_J_MIDI_SRC_A2JMIDI_J2A_H
+#define A_J_MIDI_SRC_A2JMIDI_J2A_H
+
+#include "a2jmidi_clock.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * The reverse direction of the bridge (`--j2a`): from a JACK input port to an ALSA
+ * sender port.
+ *
+ * The process callback copies the events of each period into a preallocated lock-free ring
+ * and wakes the sender thread. The sender thread (not real-time) encodes the events into
+ * sequencer events, buffers them and drains the buffer once per period. The events are
+ * scheduled on an ALSA queue one period after their JACK frame time, so they keep their
+ * spacing within the period.
+ */
+namespace a2jmidi::j2a {
+
+/**
+ * The size (in bytes) of the ring between the process callback and the sender thread.
+ */
+constexpr size_t RING_CAPACITY{256 * 1024};
+
+/**
+ * Implementation specific stuff.
+ */
+inline namespace impl {
+/**
+ * When an event shall leave the ALSA queue, relative to the moment it is sent.
+ * @param eventTime - the frame time of the event (on the JACK frame timeline).
+ * @param now - the current frame time.
+ * @param latency - the constant delay added to all events, in frames.
+ * @param sampleRate - frames per second.
+ * @return the delay; zero for events that are already late.
+ */
+std::chrono::nanoseconds sendDelay(a2jmidi::TimePoint eventTime, a2jmidi::TimePoint now,
+                                   a2jmidi::TimePoint latency, int sampleRate);
+
+/**
+ * The frame time of an event found in the input port by the process callback.
+ * @param deadline - the deadline given to the process callback (the start of the period
+ * minus the jitter compensation).
+ * @param jitterCompensation - the jitter compensation, in frames.
+ * @param offset - the position of the event within the period.
+ * @return the frame time of the event.
+ */
+a2jmidi::TimePoint eventTime(a2jmidi::TimePoint deadline, a2jmidi::TimePoint jitterCompensation,
+                             uint32_t offset);
+} // namespace impl
+
+/**
+ * Create the JACK input port and the ALSA sender port, then start both clients and the
+ * sender thread.
+ *
+ * The JACK client must be open (in `idle` state), the ALSA client closed.
+ * @param clientName - the name of the JACK client, used for the ALSA client and both ports.
+ * @param connectTo - the designations of the ALSA receiver-ports to send to.
+ * @throws std::runtime_error - (or one of its subclasses) if a client cannot be set up.
+ */
+void open(const std::string &clientName, const std::vector<std::string> &connectTo) noexcept(false);
+
+/**
+ * Stop the sender thread, after it has forwarded the pending events.
+ *
+ * Shall be called before the JACK and ALSA clients are closed. Does nothing when the
+ * reverse direction has not been opened.
+ */
+void close() noexcept;
+
+/**
+ * Indicates whether the reverse direction is in use.
+ */
+bool isOpen() noexcept;
+
+/**
+ * The number of events that could not be forwarded (ring full or ALSA errors).
+ */
+long droppedCount() noexcept;
+
+} // namespace a2jmidi::j2a
+
+#endif // A_J_MIDI_SRC_A2JMIDI_J2A_H
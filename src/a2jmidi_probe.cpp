@@ -0,0 +1,97 @@
+/*
+ * File: a2jmidi_probe.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "a2jmidi_probe.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <numeric>
+
+namespace a2jmidi::probe {
+
+/**
+ * The number of distinct note numbers, used to tell a probe from its predecessor.
+ */
+constexpr int KEY_COUNT{128};
+
+/**
+ * The latency of each received probe. The capacity is reserved in `prepare`.
+ */
+static std::vector<a2jmidi::TimePoint> g_latencies;
+static std::atomic<int> g_receivedCount{0};              ///< valid entries in `g_latencies`.
+static std::atomic<int> g_outstandingIndex{-1};          ///< the probe we are waiting for.
+static std::atomic<a2jmidi::TimePoint> g_sendTime{0};    ///< when the outstanding probe was sent.
+
+LatencyStatistics computeStatistics(std::vector<a2jmidi::TimePoint> latencies, int lost) {
+  LatencyStatistics result;
+  result.lost = lost;
+  result.count = static_cast<int>(latencies.size());
+  if (latencies.empty()) {
+    return result;
+  }
+  std::sort(latencies.begin(), latencies.end());
+  double sum = std::accumulate(latencies.begin(), latencies.end(), 0.0);
+  result.mean = sum / result.count;
+  result.min = static_cast<double>(latencies.front());
+  result.max = static_cast<double>(latencies.back());
+  // nearest-rank percentile.
+  auto rank = static_cast<size_t>(std::ceil(0.99 * result.count));
+  result.p99 = static_cast<double>(latencies[std::max<size_t>(rank, 1) - 1]);
+  double squares = 0;
+  for (auto latency : latencies) {
+    squares += (latency - result.mean) * (latency - result.mean);
+  }
+  result.jitter = std::sqrt(squares / result.count);
+  return result;
+}
+
+void prepare(int probeCount) {
+  g_outstandingIndex = -1;
+  g_receivedCount = 0;
+  g_latencies.assign(std::max(probeCount, 0), 0);
+}
+
+unsigned char recordSent(int index, a2jmidi::TimePoint sendTime) noexcept {
+  g_sendTime = sendTime;
+  g_outstandingIndex = index;
+  return static_cast<unsigned char>(index % KEY_COUNT);
+}
+
+void recordReceived(unsigned char key, a2jmidi::TimePoint writtenFrame) noexcept {
+  int index = g_outstandingIndex;
+  if (index < 0 || key != index % KEY_COUNT) {
+    return; // not the probe we are waiting for.
+  }
+  int slot = g_receivedCount;
+  if (slot >= static_cast<int>(g_latencies.size())) {
+    return;
+  }
+  g_latencies[slot] = writtenFrame - g_sendTime;
+  g_outstandingIndex = -1;
+  g_receivedCount = slot + 1;
+}
+
+int receivedCount() noexcept { return g_receivedCount; }
+
+LatencyStatistics statistics(int sentCount) {
+  int received = g_receivedCount;
+  std::vector<a2jmidi::TimePoint> latencies{g_latencies.begin(), g_latencies.begin() + received};
+  return computeStatistics(std::move(latencies), sentCount - received);
+}
+
+} // namespace a2jmidi::probe
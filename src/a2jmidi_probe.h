@@ -0,0 +1,101 @@
+/*
+ * File: a2jmidi_probe.h
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef A_J_MIDI_SRC_A2JMIDI_PROBE_H
+#define A_J_MIDI_SRC_A2JMIDI_PROBE_H
+
+#include "a2jmidi_clock.h"
+#include <vector>
+
+/**
+ * Book-keeping for the round-trip latency probe (`--probe`).
+ *
+ * Probe notes are sent through a dedicated ALSA port into our own receiver port. For each
+ * probe, the send time (on the JACK frame timeline) is compared with the frame at which
+ * the note is written into the JACK buffer.
+ *
+ * Probes are sent one at a time; `recordReceived` is real-time safe.
+ */
+namespace a2jmidi::probe {
+
+/**
+ * The MIDI channel (zero based) used for probe notes.
+ */
+constexpr int PROBE_CHANNEL{15};
+
+/**
+ * Latency figures over a series of probes, in frames.
+ */
+struct LatencyStatistics {
+  int count{0};      ///< the number of probes that have been received.
+  int lost{0};       ///< the number of probes that have not been received.
+  double min{0};     ///< the smallest latency.
+  double mean{0};    ///< the average latency.
+  double p99{0};     ///< 99 percent of the probes had this latency or less.
+  double max{0};     ///< the largest latency.
+  double jitter{0};  ///< the standard deviation of the latency.
+};
+
+/**
+ * Compute the statistics for the given latencies.
+ * @param latencies - the latency of each received probe, in frames.
+ * @param lost - the number of probes that have not been received.
+ * @return the statistics (all figures zero if `latencies` is empty).
+ */
+LatencyStatistics computeStatistics(std::vector<a2jmidi::TimePoint> latencies, int lost);
+
+/**
+ * Prepare the book-keeping for a series of probes.
+ *
+ * Allocates all memory needed, so that `recordReceived` does not allocate.
+ * @param probeCount - the number of probes that will be sent.
+ */
+void prepare(int probeCount);
+
+/**
+ * Register that a probe is about to be sent.
+ * @param index - the sequence number of the probe (zero based).
+ * @param sendTime - the current time on the JACK frame timeline.
+ * @return the key (note number) to be used for the probe note.
+ */
+unsigned char recordSent(int index, a2jmidi::TimePoint sendTime) noexcept;
+
+/**
+ * Register that a probe note has been written into the JACK buffer.
+ *
+ * Notes that do not belong to the outstanding probe (for example a late answer
+ * to a probe that has been given up) are ignored.
+ * @param key - the note number of the probe note.
+ * @param writtenFrame - the frame, on the JACK frame timeline, at which the note was written.
+ */
+void recordReceived(unsigned char key, a2jmidi::TimePoint writtenFrame) noexcept;
+
+/**
+ * The number of probes received so far.
+ */
+int receivedCount() noexcept;
+
+/**
+ * The statistics of the current series of probes.
+ * @param sentCount - the number of probes that have been sent.
+ */
+LatencyStatistics statistics(int sentCount);
+
+} // namespace a2jmidi::probe
+
+#endif // A_J_MIDI_SRC_A2JMIDI_PROBE_H
@@ -0,0 +1,57 @@
+/*
+ * File: a2jmidi_pull.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "a2jmidi_pull.h"
+#include <memory>
+
+namespace a2jmidi::pull {
+
+/**
+ * Extends the host's 32-bit frame counter, shared by the clock of the receiver and `pull`.
+ */
+static jackClient::FrameTimeline g_frameTimeline;
+
+void open(const std::string &clientName, const std::vector<std::string> &connectTo,
+          jackClient::FrameCounter frameCounter) noexcept(false) {
+  g_frameTimeline.reset(frameCounter());
+  alsaClient::open(clientName);
+  try {
+    alsaClient::newReceiverPort(clientName, connectTo);
+    alsaClient::activate(
+        std::make_unique<jackClient::FrameTimelineClock>(g_frameTimeline, std::move(frameCounter)));
+  } catch (...) {
+    alsaClient::close();
+    throw;
+  }
+}
+
+int pull(uint32_t periodStart, int nFrames, const PullCallback &onEvent) noexcept {
+  a2jmidi::TimePoint deadline = g_frameTimeline.extend(periodStart);
+  return alsaClient::retrieveDirect(
+      deadline, [&](const alsaClient::PendingEvent &event, const a2jmidi::TimePoint timeStamp) {
+        int offset = positionInPeriod(deadline, timeStamp, nFrames);
+        if (offset < 0) {
+          return 0; // far too old (after hibernation for example), discard.
+        }
+        return onEvent(offset, event);
+      });
+}
+
+void close() noexcept { alsaClient::close(); }
+
+} // namespace a2jmidi::pull
@@ -0,0 +1,131 @@
+/*
+ * File: a2jmidi_pull.h
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef A_J_MIDI_SRC_A2JMIDI_PULL_H
+#define A_J_MIDI_SRC_A2JMIDI_PULL_H
+
+#include "a2jmidi_clock.h"
+#include "alsa_client.h"
+#include "frame_timeline.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * The embeddable interface of `liba2jmidi`.
+ *
+ * An application that already is a JACK client can receive ALSA MIDI without a second
+ * JACK client (and without the extra period of latency of a connection in the JACK graph):
+ * it opens an ALSA receiver port with `open` and, in its own process callback, pulls the
+ * events of the previous period with `pull`.
+ *
+ *     a2jmidi::pull::open("myApp", {"USB-MIDI MIDI 1"},
+ *                         [host]() { return jack_frame_time(host); });
+ *     ...
+ *     int process(jack_nframes_t nFrames, void *arg) {
+ *       void *buffer = jack_port_get_buffer(port, nFrames);
+ *       jack_midi_clear_buffer(buffer);
+ *       a2jmidi::pull::pull(jack_last_frame_time(host), nFrames,
+ *                           [buffer](int offset, const alsaClient::PendingEvent &event) {
+ *         auto *data = jack_midi_event_reserve(buffer, offset, event.size());
+ *         if (data) {
+ *           event.writeTo(data);
+ *         }
+ *         return 0;
+ *       });
+ *       ...
+ *
+ * Like the `alsaClient` it is built on, there can be only one instance per process.
+ */
+namespace a2jmidi::pull {
+
+/**
+ * Implementation specific stuff.
+ */
+inline namespace impl {
+
+/**
+ * The position, within a period, of an event.
+ *
+ * The period of `nFrames` frames that ends at `deadline` is mapped onto the buffer of the
+ * current period, so that all events arrive exactly one period late.
+ * @param deadline - the start of the current period.
+ * @param timeStamp - when the event was recorded.
+ * @param nFrames - the length of the period.
+ * @return the offset of the event in the buffer (clamped to the buffer), or -1 if the
+ * event is more than a period too old and shall be discarded.
+ */
+inline int positionInPeriod(a2jmidi::TimePoint deadline, a2jmidi::TimePoint timeStamp,
+                            int nFrames) noexcept {
+  a2jmidi::TimePoint position = nFrames - (deadline - timeStamp);
+  if (position < -nFrames) {
+    return -1;
+  }
+  if (position < 0) {
+    return 0;
+  }
+  if (position >= nFrames) {
+    return nFrames - 1;
+  }
+  return static_cast<int>(position);
+}
+
+} // namespace impl
+
+/**
+ * The function type to be used in the `pull` call.
+ * @param offset - the position of the event in the buffer of the current period.
+ * @param event - the current MIDI event, not yet written.
+ * @return a non zero value to stop processing.
+ */
+using PullCallback = std::function<int(int offset, const alsaClient::PendingEvent &event)>;
+
+/**
+ * Open an ALSA receiver port and start listening.
+ * @param clientName - the desired name of the ALSA client and its port.
+ * @param connectTo - the designations of the sender-ports to connect (and to monitor).
+ * @param frameCounter - reads the frame counter of the host (for example `jack_frame_time`).
+ * It is used to timestamp the incoming events.
+ * @throws alsaClient::BadStateException - if already open.
+ * @throws alsaClient::ServerException - if the ALSA server has encountered a problem.
+ */
+void open(const std::string &clientName, const std::vector<std::string> &connectTo,
+          jackClient::FrameCounter frameCounter) noexcept(false);
+
+/**
+ * Retrieve all events received before the start of the current period, positioned for
+ * a buffer of `nFrames` frames.
+ *
+ * Shall be called once per period from the host's process callback; it is real-time safe.
+ * @param periodStart - the frame counter at the start of the current period (for example
+ * `jack_last_frame_time`).
+ * @param nFrames - the length of the current period.
+ * @param onEvent - invoked for each event, in the order of arrival.
+ * @return zero on success, a non zero value if an error occurred.
+ */
+int pull(uint32_t periodStart, int nFrames, const PullCallback &onEvent) noexcept;
+
+/**
+ * Stop listening and close the ALSA receiver port.
+ */
+void close() noexcept;
+
+} // namespace a2jmidi::pull
+
+#endif // A_J_MIDI_SRC_A2JMIDI_PULL_H
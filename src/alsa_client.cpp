@@ -17,12 +17,19 @@
  * limitations under the License.
  */
 #include "alsa_client.h"
+#include "alsa_encoder.h"
 #include "alsa_receiver_queue.h"
 
 #include "alsa_util.h"
+#include "delay_line.h"
+#include "midi_ump.h"
 #include "spdlog/sinks/stdout_color_sinks.h"
 #include "spdlog/spdlog.h"
 #include <alsa/asoundlib.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <memory>
 #include <regex>
 #include <stdexcept>
 #include <string>
@@ -38,23 +45,200 @@ static auto g_logger = spdlog::stdout_color_mt("alsa_client");
 static auto g_connectionsLogger = spdlog::stdout_color_mt("alsa_client-connections");
 
 static int g_portId{NULL_ID};                 ///< the ID-number of our ALSA input port
+static int g_probePortId{NULL_ID};            ///< the ID-number of the probe port (if any)
+static int g_senderPortId{NULL_ID};           ///< the ID-number of our ALSA output port (if any)
+static int g_outputQueue{NULL_ID};            ///< the queue that schedules the output events
+static snd_midi_event_t *g_midiEventEncoderHandle{
+    nullptr};                                 ///< handle to the ALSA MIDI encoder (output)
+static std::atomic<long> g_outputCount{0};    ///< see `outputCount()`.
 static snd_seq_t *g_sequencerHandle{nullptr}; ///< handle to access the ALSA sequencer
 static snd_midi_event_t *g_midiEventParserHandle{
     nullptr};                            ///< handle to access the ALSA MIDI parser
+static snd_rawmidi_t *g_rawMidiHandle{nullptr}; ///< the rawmidi input (if any)
+static std::string g_rawMidiDevice;             ///< the name of the rawmidi input (if any)
+static std::atomic<long> g_recoveryCount{0};    ///< see `recoveryCount()`.
 static int g_clientId{NULL_ID};          ///< the client-number of this client
-static State g_stateFlag{State::closed}; ///< the current state of the alsaClient
-static std::mutex g_stateAccessMutex;    ///< protects g_stateFlag against race conditions.
-static std::string g_connectTo;          ///< the name of a port we shall try to connect to
+/**
+ * The current state of the alsaClient. Changed under `g_stateAccessMutex`, but read
+ * without lock by the real-time functions `retrieveDirect` and `skip`.
+ */
+static std::atomic<State> g_stateFlag{State::closed};
+/**
+ * Serializes the state transitions (the real-time thread never takes this mutex).
+ */
+static std::mutex g_stateAccessMutex;
+/**
+ * The number of real-time threads currently inside `retrieveDirect` or `skip`.
+ */
+static std::atomic<int> g_realTimeReaders{0};
+
+/**
+ * Registers the real-time thread in `g_realTimeReaders` for the duration of a call.
+ *
+ * The reader first announces itself and then checks the state; `stop` first leaves the
+ * `running` state and then waits for the announced readers. Both sides use sequentially
+ * consistent operations, so either the reader sees that the client is no longer running,
+ * or `stop` sees the reader and waits for it. The reader never waits.
+ */
+class RealTimeSection {
+public:
+  RealTimeSection() noexcept { g_realTimeReaders.fetch_add(1); }
+  ~RealTimeSection() noexcept { g_realTimeReaders.fetch_sub(1); }
+  RealTimeSection(const RealTimeSection &) = delete;
+  RealTimeSection &operator=(const RealTimeSection &) = delete;
+
+  /**
+   * Indicates whether the receiver queue may be used.
+   */
+  static bool isRunning() noexcept { return g_stateFlag == State::running; }
+};
+
+/**
+ * A sender-port that the receiver port shall be connected to.
+ */
+struct Source {
+  explicit Source(std::string designation) : designation{std::move(designation)} {}
+  const std::string designation;       ///< the designation of the port, as given by the user.
+  std::atomic<int> client{NULL_ID};    ///< the client-number of the currently connected port.
+  std::atomic<int> port{NULL_ID};      ///< the port-number of the currently connected port.
+  std::atomic<long> eventCount{0};     ///< the number of MIDI events received from this source.
+  std::atomic<long> connectCount{0};   ///< how often this source has been (re-)connected.
+  std::atomic<a2jmidi::TimePoint> lastArrival{0}; ///< when the latest event has been received.
 
-// this should be large enough to hold the largest MIDI message to be encoded by the
-// AlsaMidiEventParser
+  /**
+   * Indicates whether the given address belongs to the currently connected port.
+   */
+  bool isSender(const snd_seq_addr_t &address) const {
+    return (address.client == client) && (address.port == port);
+  }
+};
+/**
+ * A list of sources, as published to the real-time thread.
+ */
+using SourceList = std::vector<Source *>;
+/**
+ * The sources that we shall try to connect to.
+ *
+ * The list is never modified once published; `setConnectTargets` publishes a new list
+ * instead (an atomic pointer swap). Replaced lists and sources are kept (in
+ * `g_sourceStore`) until `reclaimRetiredSources` has seen the real-time thread outside
+ * `retrieveDirect` and `skip`.
+ */
+static std::atomic<const SourceList *> g_sources{nullptr};
+/**
+ * Owns the current list of sources and the lists replaced since, with their sources.
+ */
+struct SourceStore {
+  std::vector<std::unique_ptr<Source>> sources;
+  std::vector<std::unique_ptr<SourceList>> lists;
+};
+static SourceStore g_sourceStore;
+/**
+ * Serializes the connection monitor and the changes of its targets (`setConnectTargets`,
+ * `setAutoFilter`).
+ */
+static std::mutex g_monitorMutex;
+/**
+ * A receiver-port that the sender port shall be connected to.
+ * Only used in `idle` state and by the monitoring thread.
+ */
+struct Destination {
+  explicit Destination(std::string designation) : designation{std::move(designation)} {}
+  const std::string designation; ///< the designation of the port, as given by the user.
+  PortID port{NULL_PORT_ID};     ///< the currently connected port.
+};
+/**
+ * The destinations that the sender port shall try to connect to.
+ */
+static std::vector<std::unique_ptr<Destination>> g_destinations;
+/**
+ * The number of MIDI events received from ports that were not requested (connected by others).
+ */
+static std::atomic<long> g_otherEventCount{0};
+/**
+ * How often a connected source has been lost (or replaced by another port).
+ */
+static std::atomic<long> g_disconnectCount{0};
+static std::atomic<bool> g_adaptiveInputPool{false}; ///< grow the input pool on overflow?
+
+/**
+ * A sender-port bridged in automatic mode (see `setAutoConnect`).
+ */
+struct AutoSource {
+  PortID port{NULL_PORT_ID}; ///< the formal identity of the port.
+  std::string clientName;    ///< the name of the client that owns the port.
+  std::string portName;      ///< the name of the port.
+};
+static AutoFilter g_autoFilter;                             ///< which ports are bridged.
+static OnAutoSourceHandler g_onAutoSourceHandler{nullptr};  ///< nullptr unless automatic.
+/**
+ * The ports currently bridged in automatic mode. Only used in `idle` state and by the
+ * monitoring thread.
+ */
+static std::vector<AutoSource> g_autoSources;
+/**
+ * Set by the real-time thread when the sequencer has announced a change of its ports,
+ * cleared by the monitoring thread when it checks the connections.
+ */
+static std::atomic<bool> g_portsAnnounced{false};
+
+// this should be large enough to hold the largest MIDI message (other than SysEx) to be
+// decoded by the AlsaMidiEventParser
 constexpr int MAX_MIDI_EVENT_SIZE{16};
 
+/**
+ * An entry of the latency offset table (see `setLatencyOffsets`).
+ */
+struct ResolvedOffset {
+  std::string designation;           ///< the sender-port, as given by the user.
+  a2jmidi::TimePoint delay{0};       ///< how long the events of this source are held back.
+  std::atomic<int> address{NULL_ID}; ///< the resolved sender (`packedAddress`), or NULL_ID.
+};
+/**
+ * The latency offset table. Designations and delays are only modified in `idle` state,
+ * the addresses are kept up to date by the connection monitor.
+ */
+static std::array<ResolvedOffset, MAX_LATENCY_OFFSETS> g_latencyOffsets;
+static std::atomic<int> g_latencyOffsetCount{0}; ///< the valid entries in `g_latencyOffsets`.
+static a2jmidi::TimePoint g_defaultDelay{0};     ///< the delay of sources without an entry.
+
+/**
+ * The number of events that can be held back by the latency offsets.
+ */
+constexpr size_t HOLD_CAPACITY{1024};
+/**
+ * The events held back by the latency offsets, together with their sequencer event.
+ * Only used by the real-time thread (and reset in `idle` state).
+ */
+using HoldBuffer = a2jmidi::DelayLine<snd_seq_event_t, HOLD_CAPACITY, MAX_MIDI_EVENT_SIZE>;
+static HoldBuffer g_holdBuffer;
+
+/**
+ * Pack a sender address into one integer, so that it can be stored atomically.
+ */
+inline int packedAddress(int client, int port) { return (client << 16) | port; }
+
+/**
+ * How long the events from the given sender shall be held back.
+ */
+inline a2jmidi::TimePoint delayOf(const snd_seq_addr_t &sender) {
+  int address = packedAddress(sender.client, sender.port);
+  int count = g_latencyOffsetCount;
+  for (int i = 0; i < count; i++) {
+    if (g_latencyOffsets[i].address == address) {
+      return g_latencyOffsets[i].delay;
+    }
+  }
+  return g_defaultDelay;
+}
+
 /**
  * The `g_onMonitorConnectionsHandler` is invoked on regular time intervals.
  */
 OnMonitorConnectionsHandler g_onMonitorConnectionsHandler{nullptr};
 PortID defaultConnectionsHandler(const std::string &connectTo, const PortID &connectedTillNow);
+std::vector<PortID> portConnectionsInternal(int port, snd_seq_query_subs_type_t type);
+std::vector<PortID> receiverPortGetConnectionsInternal();
 
 /**
  * Returns a string representation of the given state.
@@ -73,6 +257,91 @@ std::string stateAsString(State state) {
   return "unknown";
 }
 
+/**
+ * The sources currently requested.
+ */
+inline const SourceList &currentSources() {
+  static const SourceList noSources;
+  // sequentially consistent, see `reclaimRetiredSources`.
+  const SourceList *sources = g_sources.load();
+  return sources ? *sources : noSources;
+}
+
+/**
+ * Publish a new list of sources. The sources that are requested again keep their
+ * connection and their counters.
+ * @param designations - the sender-ports to connect to.
+ * @return the sources that are no longer requested.
+ */
+std::vector<Source *> publishSources(const std::vector<std::string> &designations) {
+  const SourceList &previous = currentSources();
+  auto next = std::make_unique<SourceList>();
+  for (const auto &designation : designations) {
+    if (designation.empty()) {
+      continue;
+    }
+    auto kept = std::find_if(previous.begin(), previous.end(), [&designation](Source *source) {
+      return source->designation == designation;
+    });
+    if (kept != previous.end()) {
+      next->push_back(*kept);
+      continue;
+    }
+    g_sourceStore.sources.push_back(std::make_unique<Source>(designation));
+    next->push_back(g_sourceStore.sources.back().get());
+  }
+  std::vector<Source *> dropped;
+  for (Source *source : previous) {
+    if (std::find(next->begin(), next->end(), source) == next->end()) {
+      dropped.push_back(source);
+    }
+  }
+  g_sources.store(next.get());
+  g_sourceStore.lists.push_back(std::move(next));
+  return dropped;
+}
+
+/**
+ * Free the lists and sources that have been replaced, provided that no real-time thread is
+ * inside `retrieveDirect` or `skip`.
+ *
+ * A reader announces itself in `g_realTimeReaders` before it loads `g_sources`; the list
+ * is swapped before the readers are counted (all sequentially consistent). So when no
+ * reader is seen, a reader that comes later can only find the current list. Otherwise,
+ * the next call tries again. Shall be called under `g_monitorMutex`.
+ */
+void reclaimRetiredSources() {
+  const SourceList *current = g_sources.load();
+  if (!current || g_sourceStore.lists.size() <= 1 || g_realTimeReaders.load() > 0) {
+    return;
+  }
+  auto &lists = g_sourceStore.lists;
+  lists.erase(std::remove_if(lists.begin(), lists.end(),
+                             [current](const auto &list) { return list.get() != current; }),
+              lists.end());
+  auto &sources = g_sourceStore.sources;
+  sources.erase(std::remove_if(sources.begin(), sources.end(),
+                               [current](const auto &source) {
+                                 return std::find(current->begin(), current->end(),
+                                                  source.get()) == current->end();
+                               }),
+                sources.end());
+}
+
+size_t sourceListCount() {
+  std::unique_lock<std::mutex> lock{g_monitorMutex};
+  return g_sourceStore.lists.size();
+}
+
+/**
+ * Forget all sources. Shall only be called in `idle` or `closed` state.
+ */
+void clearSources() {
+  g_sources = nullptr;
+  g_sourceStore.lists.clear();
+  g_sourceStore.sources.clear();
+}
+
 PortID tryToConnect(const std::string &designation) {
   if (designation.empty()) {
     SPDLOG_LOGGER_TRACE(g_connectionsLogger, "no connection requested");
@@ -98,51 +367,398 @@ PortID tryToConnect(const std::string &designation) {
 }
 
 static std::atomic<bool> g_monitoringActive{false}; ///< when false, ConnectionMonitoring will end.
+/**
+ * The monitoring thread. It is joined when the monitoring stops, so it never outlives the
+ * handles that it uses (and a recovery never runs after `stop` or `close`).
+ */
+static std::thread g_monitorThread;
 
+/**
+ * Let the monitoring thread end and wait for it. Shall not be called from the monitoring
+ * thread itself.
+ */
 void stopConnectionMonitoring() {
   SPDLOG_LOGGER_TRACE(g_connectionsLogger, "stopConnectionMonitoring");
   g_monitoringActive = false;
+  if (g_monitorThread.joinable()) {
+    g_monitorThread.join();
+  }
 }
+/**
+ * Leave the `running` state and wait until the real-time thread is out of
+ * `retrieveDirect` and `skip`. Afterwards, the receiver queue can be stopped without
+ * the real-time thread ever contending with the shutdown.
+ */
+void leaveRunningState() noexcept {
+  g_stateFlag = State::idle;
+  while (g_realTimeReaders > 0) {
+    std::this_thread::yield();
+  }
+}
+
 void stopInternal() noexcept {
   stopConnectionMonitoring();
   alsaClient::receiverQueue::stop();
+  if (g_outputQueue != NULL_ID) {
+    snd_seq_stop_queue(g_sequencerHandle, g_outputQueue, nullptr);
+    snd_seq_drain_output(g_sequencerHandle);
+  }
+}
+/**
+ * The not-synchronized version of `inputPoolSize()`.
+ * @return the number of events the kernel input pool can hold.
+ */
+int inputPoolSizeInternal() {
+  snd_seq_client_pool_t *poolInfo;
+  snd_seq_client_pool_alloca(&poolInfo);
+  int err = snd_seq_get_client_pool(g_sequencerHandle, poolInfo);
+  if (ALSA_ERROR(err, "snd_seq_get_client_pool")) {
+    return 0;
+  }
+  return static_cast<int>(snd_seq_client_pool_get_input_pool(poolInfo));
+}
+
+/**
+ * Double the kernel input pool (up to `MAX_INPUT_POOL`) after it has overflowed.
+ */
+void growInputPool() {
+  int currentSize = inputPoolSizeInternal();
+  if (currentSize <= 0 || currentSize >= MAX_INPUT_POOL) {
+    return;
+  }
+  int newSize = std::min(2 * currentSize, MAX_INPUT_POOL);
+  int err = snd_seq_set_client_pool_input(g_sequencerHandle, newSize);
+  if (ALSA_ERROR(err, "snd_seq_set_client_pool_input")) {
+    return;
+  }
+  SPDLOG_LOGGER_INFO(g_logger, "input pool overflowed - grown from {} to {} events.", currentSize,
+                     newSize);
+}
+
+/**
+ * Let the `g_onMonitorConnectionsHandler` check the connection to one source.
+ * @param source - the source to check.
+ */
+void monitorSource(Source &source) {
+  SPDLOG_LOGGER_TRACE(g_connectionsLogger, "monitorLoop - calling handler for \"{}\"",
+                      source.designation);
+  PortID currentlyConnected{source.client, source.port};
+  PortID nowConnected = g_onMonitorConnectionsHandler(source.designation, currentlyConnected);
+  if (nowConnected != currentlyConnected) {
+    if (currentlyConnected != NULL_PORT_ID) {
+      g_disconnectCount++;
+    }
+    source.client = nowConnected.client;
+    source.port = nowConnected.port;
+    if (nowConnected != NULL_PORT_ID) {
+      source.connectCount++;
+    }
+  }
+}
+
+/**
+ * Look up the sender-ports of the latency offset table (ports may come and go).
+ */
+void resolveLatencyOffsets() {
+  int count = g_latencyOffsetCount;
+  for (int i = 0; i < count; i++) {
+    auto &entry = g_latencyOffsets[i];
+    PortID port = findPort(toProfile(SENDER_PORT, entry.designation), matcher);
+    int address = (port == NULL_PORT_ID) ? NULL_ID : packedAddress(port.client, port.port);
+    if (address == entry.address) {
+      continue;
+    }
+    if (address == NULL_ID) {
+      SPDLOG_LOGGER_DEBUG(g_connectionsLogger, "latency offset for \"{}\" - port not found.",
+                          entry.designation);
+    } else {
+      SPDLOG_LOGGER_DEBUG(g_connectionsLogger, "latency offset for \"{}\" applies to {}:{}.",
+                          entry.designation, port.client, port.port);
+    }
+    entry.address = address;
+  }
+}
+
+/**
+ * (Re-)connect the sender port to the destinations that are not connected.
+ */
+void monitorDestinations() {
+  if (g_destinations.empty()) {
+    return;
+  }
+  std::vector<PortID> connectedPorts = portConnectionsInternal(g_senderPortId,
+                                                               SND_SEQ_QUERY_SUBS_READ);
+  for (auto &destination : g_destinations) {
+    if (destination->port != NULL_PORT_ID &&
+        std::find(connectedPorts.begin(), connectedPorts.end(), destination->port) !=
+            connectedPorts.end()) {
+      continue;
+    }
+    PortID target = findPort(toProfile(RECEIVER_PORT, destination->designation), matcher);
+    if (target != NULL_PORT_ID &&
+        snd_seq_connect_to(g_sequencerHandle, g_senderPortId, target.client, target.port) < 0) {
+      target = NULL_PORT_ID;
+    }
+    if (target != destination->port && target != NULL_PORT_ID) {
+      SPDLOG_LOGGER_INFO(g_connectionsLogger, "sending to \"{}\" ({}:{}).",
+                         destination->designation, target.client, target.port);
+    }
+    destination->port = target;
+  }
+}
+
+/**
+ * In automatic mode, bring the bridged ports in line with the ports that pass the filter:
+ * tell the handler about the ports that have gone, offer it the new ones, and re-connect
+ * the ports whose connection has been removed.
+ */
+void monitorAutoSources() {
+  if (!g_onAutoSourceHandler) {
+    return;
+  }
+  std::vector<AutoSource> present;
+  snd_seq_client_info_t *clientInfo;
+  snd_seq_port_info_t *portInfo;
+  snd_seq_client_info_alloca(&clientInfo);
+  snd_seq_port_info_alloca(&portInfo);
+  snd_seq_client_info_set_client(clientInfo, NULL_ID);
+  while (snd_seq_query_next_client(g_sequencerHandle, clientInfo) >= 0) {
+    int clientNr = snd_seq_client_info_get_client(clientInfo);
+    snd_seq_client_type_t clientType = snd_seq_client_info_get_type(clientInfo);
+    snd_seq_port_info_set_client(portInfo, clientNr);
+    snd_seq_port_info_set_port(portInfo, NULL_ID);
+    while (snd_seq_query_next_port(g_sequencerHandle, portInfo) >= 0) {
+      PortID portId{clientNr, snd_seq_port_info_get_port(portInfo)};
+      if (autoMatches(g_autoFilter, snd_seq_port_info_get_capability(portInfo),
+                      snd_seq_port_info_get_type(portInfo), clientType, portId, g_clientId)) {
+        present.push_back({portId, snd_seq_client_info_get_name(clientInfo),
+                           snd_seq_port_info_get_name(portInfo)});
+      }
+    }
+  }
+  auto sameSource = [](const AutoSource &a, const AutoSource &b) {
+    return a.port == b.port && a.clientName == b.clientName && a.portName == b.portName;
+  };
+
+  for (auto source = g_autoSources.begin(); source != g_autoSources.end();) {
+    if (std::any_of(present.begin(), present.end(),
+                    [&](const AutoSource &other) { return sameSource(*source, other); })) {
+      source++;
+      continue;
+    }
+    SPDLOG_LOGGER_INFO(g_connectionsLogger, "port \"{}:{}\" ({}:{}) is no longer bridged.",
+                       source->clientName, source->portName, source->port.client,
+                       source->port.port);
+    // the port may still exist, but no longer pass the filter.
+    snd_seq_disconnect_from(g_sequencerHandle, g_portId, source->port.client, source->port.port);
+    g_onAutoSourceHandler(source->port, source->clientName, source->portName, false);
+    g_disconnectCount++;
+    source = g_autoSources.erase(source);
+  }
+
+  std::vector<PortID> connectedPorts = receiverPortGetConnectionsInternal();
+  for (const auto &candidate : present) {
+    bool known = std::any_of(g_autoSources.begin(), g_autoSources.end(),
+                             [&](const AutoSource &other) { return sameSource(candidate, other); });
+    bool connected = std::find(connectedPorts.begin(), connectedPorts.end(), candidate.port) !=
+                     connectedPorts.end();
+    if (known && connected) {
+      continue;
+    }
+    if (!known &&
+        !g_onAutoSourceHandler(candidate.port, candidate.clientName, candidate.portName, true)) {
+      continue;
+    }
+    int err = snd_seq_connect_from(g_sequencerHandle, g_portId, candidate.port.client,
+                                   candidate.port.port);
+    if (err < 0) {
+      ALSA_INFO_ERROR(err, "monitorAutoSources::snd_seq_connect_from");
+      if (!known) {
+        g_onAutoSourceHandler(candidate.port, candidate.clientName, candidate.portName, false);
+      }
+      continue;
+    }
+    if (known) {
+      g_disconnectCount++;
+      continue;
+    }
+    SPDLOG_LOGGER_INFO(g_connectionsLogger, "bridging port \"{}:{}\" ({}:{}).",
+                       candidate.clientName, candidate.portName, candidate.port.client,
+                       candidate.port.port);
+    g_autoSources.push_back(candidate);
+  }
+}
+
+/**
+ * Let the `g_onMonitorConnectionsHandler` check the connections to all sources.
+ */
+void monitorConnections() {
+  std::unique_lock<std::mutex> lock{g_monitorMutex};
+  reclaimRetiredSources();
+  resolveLatencyOffsets();
+  monitorDestinations();
+  monitorAutoSources();
+  if (!g_onMonitorConnectionsHandler) {
+    return;
+  }
+  const SourceList &sources = currentSources();
+  if (sources.empty()) {
+    // no connection requested, the handler is nevertheless consulted.
+    g_onMonitorConnectionsHandler("", NULL_PORT_ID);
+  }
+  for (Source *source : sources) {
+    monitorSource(*source);
+  }
 }
+
+/**
+ * (Re-)open the rawmidi device named in `g_rawMidiDevice`.
+ * @return zero on success, a negative ALSA error code otherwise.
+ */
+int openRawMidiInternal() {
+  int err =
+      snd_rawmidi_open(&g_rawMidiHandle, nullptr, g_rawMidiDevice.c_str(), SND_RAWMIDI_NONBLOCK);
+  if (err < 0) {
+    g_rawMidiHandle = nullptr;
+  }
+  return err;
+}
+
+/**
+ * Bring a failed receiver back to work.
+ *
+ * A rawmidi input is closed and re-opened (this fails as long as the device is
+ * unplugged; the next attempt follows after `RECOVERY_INTERVAL`). For a sequencer
+ * input, the input buffer is dropped and a new listener is started on the same
+ * handle; lost connections are re-established by the connection monitor.
+ *
+ * Does nothing if a state change (`stop`, `close`) is in progress. The `running` state is
+ * only restored if the monitoring has not been stopped in the meantime.
+ */
+void recoverReceiver() {
+  std::unique_lock<std::mutex> lock{g_stateAccessMutex, std::try_to_lock};
+  if (!lock.owns_lock() || g_stateFlag != State::running) {
+    return;
+  }
+  leaveRunningState();
+  try {
+    if (!g_rawMidiDevice.empty()) {
+      if (g_rawMidiHandle) {
+        snd_rawmidi_close(g_rawMidiHandle);
+        g_rawMidiHandle = nullptr;
+      }
+      int err = openRawMidiInternal();
+      if (err < 0) {
+        // most likely the device is still unplugged, we'll try again (without spamming the log).
+        SPDLOG_LOGGER_TRACE(g_logger, "cannot re-open \"{}\" - {}.", g_rawMidiDevice,
+                            snd_strerror(err));
+      } else {
+        alsaClient::receiverQueue::restart(g_rawMidiHandle);
+      }
+    } else {
+      snd_seq_drop_input(g_sequencerHandle);
+      alsaClient::receiverQueue::restart(g_sequencerHandle);
+    }
+  } catch (const std::exception &error) {
+    SPDLOG_LOGGER_ERROR(g_logger, "cannot restart the receiver ({}).", error.what());
+  }
+  if (!alsaClient::receiverQueue::hasFailed()) {
+    g_recoveryCount++;
+    SPDLOG_LOGGER_WARN(g_logger, "receiver restarted after a failure ({} times so far).",
+                       g_recoveryCount.load());
+  }
+  if (g_monitoringActive) {
+    g_stateFlag = State::running;
+  }
+}
+
+/**
+ * The body of the monitoring thread. The first check of the connections has already
+ * been done by `activateConnectionMonitoring`, so the loop starts with a pause.
+ *
+ * A failed receiver is recovered within `RECOVERY_INTERVAL`, the connections are checked
+ * every `MONITOR_INTERVAL`.
+ */
 void monitorLoop() {
-  PortID currentlyConnected{NULL_PORT_ID};
+  long overflowsSeen = alsaClient::receiverQueue::getStatistics().kernelOverflowCount;
+  auto nextCheck = std::chrono::steady_clock::now() + MONITOR_INTERVAL;
   while (g_monitoringActive) {
-    if (g_onMonitorConnectionsHandler) {
-      SPDLOG_LOGGER_TRACE(g_connectionsLogger,
-                          "monitorLoop - calling handler "
-                          "g_connectTo = \"{}\"",
-                          g_connectTo);
-      currentlyConnected = g_onMonitorConnectionsHandler(g_connectTo, currentlyConnected);
+    std::this_thread::sleep_for(RECOVERY_INTERVAL);
+    if (!g_monitoringActive) {
+      break;
+    }
+    if (alsaClient::receiverQueue::hasFailed()) {
+      recoverReceiver();
+    }
+    // an announcement of the sequencer is followed up at once, without waiting for the check.
+    bool announced = g_portsAnnounced.exchange(false);
+    bool due = std::chrono::steady_clock::now() >= nextCheck;
+    if (!announced && !due) {
+      continue;
     }
-    std::this_thread::sleep_for(MONITOR_INTERVAL);
+    if (due) {
+      nextCheck += MONITOR_INTERVAL;
+    }
+    long overflows = alsaClient::receiverQueue::getStatistics().kernelOverflowCount;
+    if (overflows > overflowsSeen) {
+      overflowsSeen = overflows;
+      if (g_adaptiveInputPool) {
+        growInputPool();
+      }
+    }
+    monitorConnections();
   }
 }
 
+/**
+ * Check the connections once and start the monitoring thread.
+ *
+ * No pause is needed before the listener starts: `stop` joins the thread, so a quick
+ * sequence of `activate` and `stop` never leaves an old thread running.
+ */
 void activateConnectionMonitoring() {
   SPDLOG_LOGGER_TRACE(g_connectionsLogger, "activateConnectionMonitoring");
+  // the requested connections are established before `activate` returns,
+  // without waiting for the monitoring thread.
+  monitorConnections();
   g_monitoringActive = true;
-  // create and start the monitoring thread.
-  std::thread monitorThread(monitorLoop);
+  // create and start the monitoring thread (joined by `stopConnectionMonitoring`).
+  g_monitorThread = std::thread(monitorLoop);
 
   // set the priority to the lowest possible level
   sched_param schParams;
   schParams.sched_priority = 1; // = lowest
-  if (pthread_setschedparam(monitorThread.native_handle(), SCHED_RR, &schParams)) {
+  if (pthread_setschedparam(g_monitorThread.native_handle(), SCHED_RR, &schParams)) {
     SPDLOG_LOGGER_ERROR(g_connectionsLogger, "Failed to set Thread scheduling : {}",
                         std::strerror(errno));
   }
-
-  // Separate the thread of execution from the `monitorThread` object,
-  // allowing execution to continue once this function is excited.
-  monitorThread.detach();
 }
 
 void activateInternal(a2jmidi::ClockPtr clock) {
+  if (!g_rawMidiDevice.empty() && !g_rawMidiHandle &&
+      ALSA_ERROR(openRawMidiInternal(), "snd_rawmidi_open")) {
+    throw ServerException("ALSA cannot open rawmidi device.");
+  }
+  g_holdBuffer.clear();
+  if (g_outputQueue != NULL_ID) {
+    int err = snd_seq_start_queue(g_sequencerHandle, g_outputQueue, nullptr);
+    if (ALSA_ERROR(err, "snd_seq_start_queue") ||
+        ALSA_ERROR(snd_seq_drain_output(g_sequencerHandle), "snd_seq_drain_output")) {
+      throw ServerException("ALSA cannot start the output queue.");
+    }
+  }
   activateConnectionMonitoring();
-  alsaClient::receiverQueue::start(g_sequencerHandle, std::move(clock));
+  try {
+    if (g_rawMidiHandle) {
+      alsaClient::receiverQueue::start(g_rawMidiHandle, std::move(clock));
+    } else {
+      alsaClient::receiverQueue::start(g_sequencerHandle, std::move(clock));
+    }
+  } catch (...) {
+    // the client stays idle, the monitoring thread must not survive it.
+    stopConnectionMonitoring();
+    throw;
+  }
 }
 int identifierStrToInt(const std::string &identifier) noexcept {
   try {
@@ -244,6 +860,25 @@ bool matcher(PortCaps caps, PortID port, const std::string &clientName, const st
   return false;
 }
 
+bool autoMatches(const AutoFilter &filter, PortCaps caps, unsigned int portType,
+                 snd_seq_client_type_t clientType, PortID port, int ownClient) {
+  if (port.client == SND_SEQ_CLIENT_SYSTEM || port.client == ownClient) {
+    return false;
+  }
+  if (!fulfills(caps, filter.caps) || (caps & SND_SEQ_PORT_CAP_NO_EXPORT)) {
+    return false;
+  }
+  switch (filter.clientKind) {
+  case ClientKind::hardware:
+    return clientType == SND_SEQ_KERNEL_CLIENT && (portType & SND_SEQ_PORT_TYPE_HARDWARE);
+  case ClientKind::software:
+    return clientType == SND_SEQ_USER_CLIENT;
+  case ClientKind::all:
+    return true;
+  }
+  return false;
+}
+
 /**
  * Search through all MIDI ports known to the ALSA sequencer.
  * @param requested - the profile describing the kind of searched port.
@@ -280,22 +915,23 @@ PortID findPort(const PortProfile &requested, const MatchCallback &match) {
   return NULL_PORT_ID;
 }
 /**
- * The not-synchronized version of `receiverPortGetConnections()`.
- * @return a list of the ports to which the ReceiverPort is connected. If no
- * port is currently connected or the ReceiverPort has not been created yet,
- * an empty list is returned.
+ * List the ports connected to one of our ports.
+ * @param port - the port-number of our port.
+ * @param type - `SND_SEQ_QUERY_SUBS_WRITE` for the senders to a receiver port,
+ * `SND_SEQ_QUERY_SUBS_READ` for the receivers of a sender port.
+ * @return the connected ports.
  */
-std::vector<PortID> receiverPortGetConnectionsInternal() {
+std::vector<PortID> portConnectionsInternal(int port, snd_seq_query_subs_type_t type) {
   std::vector<PortID> result;
 
   snd_seq_addr_t thisAddr;
   thisAddr.client = g_clientId;
-  thisAddr.port = g_portId;
+  thisAddr.port = port;
 
   snd_seq_query_subscribe_t *subscriptionData;
   snd_seq_query_subscribe_alloca(&subscriptionData);
   snd_seq_query_subscribe_set_root(subscriptionData, &thisAddr);
-  snd_seq_query_subscribe_set_type(subscriptionData, SND_SEQ_QUERY_SUBS_WRITE);
+  snd_seq_query_subscribe_set_type(subscriptionData, type);
   snd_seq_query_subscribe_set_index(subscriptionData, 0);
 
   while (snd_seq_query_port_subscribers(g_sequencerHandle, subscriptionData) >= 0) {
@@ -307,22 +943,73 @@ std::vector<PortID> receiverPortGetConnectionsInternal() {
   return result;
 }
 
-midi::Event parseAlsaEvent(const snd_seq_event_t &alsaEvent) {
-  static const midi::Event emptyEvent{};
-  unsigned char pMidiData[MAX_MIDI_EVENT_SIZE];
+/**
+ * The not-synchronized version of `receiverPortGetConnections()`.
+ * @return a list of the ports to which the ReceiverPort is connected. If no
+ * port is currently connected or the ReceiverPort has not been created yet,
+ * an empty list is returned.
+ */
+std::vector<PortID> receiverPortGetConnectionsInternal() {
+  return portConnectionsInternal(g_portId, SND_SEQ_QUERY_SUBS_WRITE);
+}
+
+/**
+ * Attribute a received event to its source.
+ * @param event - the received event.
+ * @param timeStamp - the point in time when the event was received.
+ */
+inline void countEvent(const snd_seq_event_t &event, a2jmidi::TimePoint timeStamp) {
+  for (Source *source : currentSources()) {
+    if (source->isSender(event.source)) {
+      source->eventCount++;
+      source->lastArrival = timeStamp;
+      return;
+    }
+  }
+  g_otherEventCount++;
+}
+
+/**
+ * Prepare a received event for writing.
+ *
+ * Channel-voice events are left to the fast path, the data of SysEx events and of rawmidi
+ * messages is used as is, Universal MIDI Packets are translated into the given scratch buffer,
+ * all other events are decoded by alsa-lib into the scratch buffer.
+ * @param alsaEvent - the received event.
+ * @param scratch - a buffer of `MAX_MIDI_EVENT_SIZE` bytes, used for decoded events.
+ * @param bytes - receives the location of the MIDI bytes, or nullptr for the fast path.
+ * @return the number of MIDI bytes of the event (zero if the event has no MIDI representation).
+ */
+size_t midiSize(const snd_seq_event_t &alsaEvent, unsigned char *scratch,
+                const unsigned char **bytes) {
+  *bytes = nullptr;
+  if (receiverQueue::isRawMidi(alsaEvent)) {
+    *bytes = receiverQueue::rawMidiBytes(alsaEvent);
+    return receiverQueue::rawMidiSize(alsaEvent);
+  }
+  if (receiverQueue::isUmp(alsaEvent)) {
+    *bytes = scratch;
+    return midi::ump::toMidi1(receiverQueue::umpWords(alsaEvent), scratch);
+  }
+  if (encoder::hasFastPath(alsaEvent)) {
+    return encoder::sizeOf(alsaEvent);
+  }
+  if (alsaEvent.type == SND_SEQ_EVENT_SYSEX && snd_seq_ev_is_variable(&alsaEvent)) {
+    *bytes = static_cast<const unsigned char *>(alsaEvent.data.ext.ptr);
+    return alsaEvent.data.ext.len;
+  }
+  *bytes = scratch;
   long evLength =
-      snd_midi_event_decode(g_midiEventParserHandle, pMidiData, MAX_MIDI_EVENT_SIZE, &alsaEvent);
+      snd_midi_event_decode(g_midiEventParserHandle, scratch, MAX_MIDI_EVENT_SIZE, &alsaEvent);
   if (evLength <= 0) {
     if (evLength == -ENOENT) {
       // The sequencer event does not correspond to one or more MIDI messages.
-      return emptyEvent; // that's OK ... just ignore
+      return 0; // that's OK ... just ignore
     }
     ALSA_ERROR(evLength, "snd_midi_event_decode");
-    return emptyEvent;
+    return 0;
   }
-
-  midi::Event result(pMidiData, pMidiData + evLength);
-  return result;
+  return static_cast<size_t>(evLength);
 }
 
 /**
@@ -403,6 +1090,7 @@ void open(const std::string &clientName) noexcept(false) {
 
   // set common variables.
   g_portId = NULL_ID;
+  clearSources();
   g_sequencerHandle = newSequencerHandle;
   g_midiEventParserHandle = newParserHandle;
   g_clientId = snd_seq_client_id(g_sequencerHandle);
@@ -413,6 +1101,141 @@ void open(const std::string &clientName) noexcept(false) {
   SPDLOG_LOGGER_TRACE(g_logger, "alsaClient::open - client {} created.", g_clientId);
 }
 
+/**
+ * Set the sizes of the kernel input pool and of the library input buffer.
+ */
+void setInputPool(const InputPool &inputPool) noexcept(false) {
+  std::unique_lock<std::mutex> lock{g_stateAccessMutex};
+  if (g_stateFlag != State::idle) {
+    throw BadStateException("Cannot set input pool. Wrong state " + stateAsString(g_stateFlag));
+  }
+  if (inputPool.poolSize > 0) {
+    int err = snd_seq_set_client_pool_input(g_sequencerHandle,
+                                            std::min(inputPool.poolSize, MAX_INPUT_POOL));
+    if (ALSA_ERROR(err, "snd_seq_set_client_pool_input")) {
+      throw ServerException("ALSA cannot set the input pool size.");
+    }
+  }
+  if (inputPool.bufferSize > 0) {
+    int err = snd_seq_set_input_buffer_size(g_sequencerHandle, inputPool.bufferSize);
+    if (ALSA_ERROR(err, "snd_seq_set_input_buffer_size")) {
+      throw ServerException("ALSA cannot set the input buffer size.");
+    }
+  }
+  g_adaptiveInputPool = inputPool.adaptive;
+  SPDLOG_LOGGER_TRACE(g_logger, "alsaClient::setInputPool - pool size {}.",
+                      inputPoolSizeInternal());
+}
+
+void enableUmp() noexcept(false) {
+  std::unique_lock<std::mutex> lock{g_stateAccessMutex};
+  if (g_stateFlag != State::idle) {
+    throw BadStateException("Cannot enable UMP. Wrong state " + stateAsString(g_stateFlag));
+  }
+#if A2JMIDI_HAS_UMP
+  int err = snd_seq_set_client_midi_version(g_sequencerHandle, SND_SEQ_CLIENT_UMP_MIDI_2_0);
+  if (ALSA_ERROR(err, "snd_seq_set_client_midi_version")) {
+    throw ServerException("ALSA cannot switch the client to UMP (MIDI 2.0).");
+  }
+  receiverQueue::setUmpInput(true);
+  SPDLOG_LOGGER_TRACE(g_logger, "alsaClient::enableUmp - client {} in UMP mode.", g_clientId);
+#else
+  throw ServerException("UMP (MIDI 2.0) requires alsa-lib 1.2.10 or later.");
+#endif
+}
+
+void setLatencyOffsets(const std::vector<LatencyOffset> &offsets) noexcept(false) {
+  std::unique_lock<std::mutex> lock{g_stateAccessMutex};
+  if (g_stateFlag != State::idle) {
+    throw BadStateException("Cannot set latency offsets. Wrong state " +
+                            stateAsString(g_stateFlag));
+  }
+  if (offsets.size() > g_latencyOffsets.size()) {
+    throw std::invalid_argument("Too many latency offsets (at most " +
+                                std::to_string(MAX_LATENCY_OFFSETS) + ").");
+  }
+  // a negative offset is realised by holding back all other sources.
+  a2jmidi::TimePoint base{0};
+  for (const auto &entry : offsets) {
+    base = std::min(base, entry.offset);
+  }
+  g_latencyOffsetCount = 0;
+  for (size_t i = 0; i < offsets.size(); i++) {
+    g_latencyOffsets[i].designation = offsets[i].designation;
+    g_latencyOffsets[i].delay = offsets[i].offset - base;
+    g_latencyOffsets[i].address = NULL_ID;
+  }
+  g_defaultDelay = -base;
+  g_latencyOffsetCount = static_cast<int>(offsets.size());
+  SPDLOG_LOGGER_TRACE(g_logger, "alsaClient::setLatencyOffsets - {} entries, base delay {}.",
+                      offsets.size(), g_defaultDelay);
+}
+
+void setAutoConnect(const AutoFilter &filter, const OnAutoSourceHandler &handler) noexcept(false) {
+  std::unique_lock<std::mutex> lock{g_stateAccessMutex};
+  if (g_stateFlag != State::idle) {
+    throw BadStateException("Cannot set automatic connections. Wrong state " +
+                            stateAsString(g_stateFlag));
+  }
+  if (g_portId == NULL_ID) {
+    throw ServerException("Automatic connections need a receiver port.");
+  }
+  int err = snd_seq_connect_from(g_sequencerHandle, g_portId, SND_SEQ_CLIENT_SYSTEM,
+                                 SND_SEQ_PORT_SYSTEM_ANNOUNCE);
+  if (ALSA_ERROR(err, "snd_seq_connect_from (announce)")) {
+    throw ServerException("ALSA cannot subscribe to the announcements.");
+  }
+  g_autoFilter = filter;
+  g_onAutoSourceHandler = handler;
+  g_autoSources.clear();
+  g_portsAnnounced = false;
+  SPDLOG_LOGGER_TRACE(g_logger, "alsaClient::setAutoConnect - client kind {}.",
+                      static_cast<int>(filter.clientKind));
+}
+
+void setAutoFilter(const AutoFilter &filter) noexcept(false) {
+  std::unique_lock<std::mutex> lock{g_stateAccessMutex};
+  if (g_stateFlag == State::closed) {
+    throw BadStateException("Cannot set the automatic filter. Wrong state " +
+                            stateAsString(g_stateFlag));
+  }
+  if (!g_onAutoSourceHandler) {
+    throw BadStateException("Automatic connections are not in use.");
+  }
+  std::unique_lock<std::mutex> monitorLock{g_monitorMutex};
+  g_autoFilter = filter;
+  g_portsAnnounced = true; // let the monitor apply the filter at once.
+}
+
+void setConnectTargets(const std::vector<std::string> &connectTo) noexcept(false) {
+  std::unique_lock<std::mutex> lock{g_stateAccessMutex};
+  if (g_stateFlag == State::closed) {
+    throw BadStateException("Cannot set connect targets. Wrong state " +
+                            stateAsString(g_stateFlag));
+  }
+  if (g_portId == NULL_ID || g_onAutoSourceHandler) {
+    throw BadStateException("Connect targets need a receiver port without automatic "
+                            "connections.");
+  }
+  std::unique_lock<std::mutex> monitorLock{g_monitorMutex};
+  for (Source *source : publishSources(connectTo)) {
+    if (source->client != NULL_ID) {
+      snd_seq_disconnect_from(g_sequencerHandle, g_portId, source->client, source->port);
+      SPDLOG_LOGGER_INFO(g_connectionsLogger, "Disconnected from port {}", source->designation);
+    }
+  }
+  reclaimRetiredSources(); // if it cannot be done now, the monitor will do it.
+  g_portsAnnounced = true; // let the monitor connect the new targets at once.
+}
+
+int inputPoolSize() {
+  std::unique_lock<std::mutex> lock{g_stateAccessMutex};
+  if (g_stateFlag == State::closed) {
+    return 0;
+  }
+  return inputPoolSizeInternal();
+}
+
 /**
  * Create a new ALSA MIDI input port. External applications can write to this port.
  *
@@ -423,20 +1246,20 @@ void open(const std::string &clientName) noexcept(false) {
  *
  * @param portName  - a desired name for the new port.
  * The server may modify this name to create a unique variant, if needed.
- * @param connectTo - the designation of a sender-port that this port shall try to connect.
- * If the connection fails, the port is nevertheless created. An empty string denotes
- * that no connection shall be attempted.
+ * @param connectTo - the designations of the sender-ports that this port shall try to connect.
+ * Each connection is monitored (and re-established) on its own. If a connection fails,
+ * the port is nevertheless created.
  * @return the input port.
  * @throws BadStateException - if port creation is attempted from a state other than `idle`.
  * @throws ServerException - if the ALSA server has encountered a problem.
  */
 ReceiverPort newReceiverPort(const std::string &portName,
-                             const std::string &connectTo) noexcept(false) {
+                             const std::vector<std::string> &connectTo) noexcept(false) {
   std::unique_lock<std::mutex> lock{g_stateAccessMutex};
   if (g_stateFlag != State::idle) {
     throw BadStateException("Cannot create input port. Wrong state " + stateAsString(g_stateFlag));
   }
-  if (g_portId != NULL_ID) {
+  if (g_portId != NULL_ID || !g_rawMidiDevice.empty()) {
     throw ServerException("Cannot create more that one port.");
   }
   g_portId = snd_seq_create_simple_port(g_sequencerHandle, portName.c_str(),
@@ -448,10 +1271,207 @@ ReceiverPort newReceiverPort(const std::string &portName,
   }
   SPDLOG_LOGGER_TRACE(g_logger, "alsaClient::newInputAlsaPort - port \"{}\" created.", portName);
 
-  g_connectTo = connectTo;
+  clearSources();
+  publishSources(connectTo);
+  g_otherEventCount = 0;
   onMonitorConnections(defaultConnectionsHandler);
 }
 
+ReceiverPort newReceiverPort(const std::string &portName,
+                             const std::string &connectTo) noexcept(false) {
+  newReceiverPort(portName, std::vector<std::string>{connectTo});
+}
+
+/**
+ * Open a rawmidi device as input, in place of a receiver port.
+ * @param device - the ALSA name of the rawmidi device.
+ * @throws BadStateException - if called from a state other than `idle`.
+ * @throws ServerException - if the device cannot be opened, or if the client already has
+ * an input.
+ */
+ReceiverPort newRawMidiInput(const std::string &device) noexcept(false) {
+  std::unique_lock<std::mutex> lock{g_stateAccessMutex};
+  if (g_stateFlag != State::idle) {
+    throw BadStateException("Cannot open rawmidi input. Wrong state " +
+                            stateAsString(g_stateFlag));
+  }
+  if (g_portId != NULL_ID || !g_rawMidiDevice.empty()) {
+    throw ServerException("Cannot create more that one input.");
+  }
+  g_rawMidiDevice = device;
+  if (ALSA_ERROR(openRawMidiInternal(), "snd_rawmidi_open")) {
+    g_rawMidiDevice.clear();
+    throw ServerException("ALSA cannot open rawmidi device.");
+  }
+  SPDLOG_LOGGER_TRACE(g_logger, "alsaClient::newRawMidiInput - device \"{}\" opened.", device);
+  clearSources();
+  g_otherEventCount = 0;
+}
+
+/**
+ * Create a port that sends probe notes into the receiver port of this client.
+ */
+PortID newProbePort() noexcept(false) { return newProbePort(std::string{}); }
+
+/**
+ * Create a port that sends probe notes through an external loop.
+ * An empty designation connects the probe port to our own receiver port.
+ */
+PortID newProbePort(const std::string &through) noexcept(false) {
+  std::unique_lock<std::mutex> lock{g_stateAccessMutex};
+  if (g_stateFlag != State::idle) {
+    throw BadStateException("Cannot create probe port. Wrong state " +
+                            stateAsString(g_stateFlag));
+  }
+  if (g_portId == NULL_ID) {
+    throw ServerException("Cannot create a probe port without a receiver port.");
+  }
+  g_probePortId = snd_seq_create_simple_port(g_sequencerHandle, "probe",
+                                             SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ,
+                                             SND_SEQ_PORT_TYPE_APPLICATION);
+  if (ALSA_ERROR(g_probePortId, "create probe port")) {
+    g_probePortId = NULL_ID;
+    throw ServerException("ALSA cannot create probe port");
+  }
+  PortID target{g_clientId, g_portId};
+  if (!through.empty()) {
+    target = findPort(toProfile(RECEIVER_PORT, through), matcher);
+    if (target == NULL_PORT_ID) {
+      throw ServerException("Cannot find the port to send the probes through.");
+    }
+    SPDLOG_LOGGER_DEBUG(g_logger, "probes are sent through {}:{}.", target.client, target.port);
+  }
+  int err = snd_seq_connect_to(g_sequencerHandle, g_probePortId, target.client, target.port);
+  if (ALSA_ERROR(err, "snd_seq_connect_to")) {
+    throw ServerException("ALSA cannot connect probe port");
+  }
+  return PortID{g_clientId, g_probePortId};
+}
+
+void sendProbe(unsigned char channel, unsigned char key) noexcept(false) {
+  snd_seq_event_t event;
+  snd_seq_ev_clear(&event);
+  snd_seq_ev_set_subs(&event);
+  snd_seq_ev_set_direct(&event);
+  snd_seq_ev_set_source(&event, g_probePortId);
+  snd_seq_ev_set_noteon(&event, channel, key, 127);
+  int err = snd_seq_event_output_direct(g_sequencerHandle, &event);
+  if (ALSA_ERROR(err, "snd_seq_event_output_direct")) {
+    throw ServerException("ALSA cannot send probe.");
+  }
+}
+
+SenderPort newSenderPort(const std::string &portName,
+                         const std::vector<std::string> &connectTo) noexcept(false) {
+  std::unique_lock<std::mutex> lock{g_stateAccessMutex};
+  if (g_stateFlag != State::idle) {
+    throw BadStateException("Cannot create output port. Wrong state " +
+                            stateAsString(g_stateFlag));
+  }
+  if (g_senderPortId != NULL_ID) {
+    throw ServerException("Cannot create more that one output port.");
+  }
+  int err = snd_midi_event_new(MAX_MIDI_EVENT_SIZE, &g_midiEventEncoderHandle);
+  if (ALSA_ERROR(err, "snd_midi_event_new")) {
+    g_midiEventEncoderHandle = nullptr;
+    throw ServerException("ALSA cannot create MIDI encoder.");
+  }
+  err = snd_seq_set_output_buffer_size(g_sequencerHandle, OUTPUT_BUFFER_SIZE);
+  ALSA_ERROR(err, "snd_seq_set_output_buffer_size"); // the default size works, only less well.
+  g_outputQueue = snd_seq_alloc_named_queue(g_sequencerHandle, portName.c_str());
+  if (ALSA_ERROR(g_outputQueue, "snd_seq_alloc_named_queue")) {
+    g_outputQueue = NULL_ID;
+    throw ServerException("ALSA cannot allocate the output queue.");
+  }
+  g_senderPortId = snd_seq_create_simple_port(
+      g_sequencerHandle, portName.c_str(), SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ,
+      SND_SEQ_PORT_TYPE_MIDI_GENERIC | SND_SEQ_PORT_TYPE_APPLICATION);
+  if (ALSA_ERROR(g_senderPortId, "create output port")) {
+    g_senderPortId = NULL_ID;
+    throw ServerException("ALSA cannot create output port");
+  }
+  SPDLOG_LOGGER_TRACE(g_logger, "alsaClient::newSenderPort - port \"{}\" created.", portName);
+
+  g_destinations.clear();
+  for (const auto &designation : connectTo) {
+    if (!designation.empty()) {
+      g_destinations.emplace_back(std::make_unique<Destination>(designation));
+    }
+  }
+  g_outputCount = 0;
+}
+
+/**
+ * Put one event into the output buffer; if the buffer is full, it is drained first.
+ */
+int outputEvent(snd_seq_event_t &event) {
+  int err = snd_seq_event_output_buffer(g_sequencerHandle, &event);
+  if (err == -EAGAIN) {
+    snd_seq_drain_output(g_sequencerHandle);
+    err = snd_seq_event_output_buffer(g_sequencerHandle, &event);
+  }
+  if (ALSA_ERROR(err, "snd_seq_event_output_buffer")) {
+    return err;
+  }
+  g_outputCount++;
+  return 0;
+}
+
+int output(const unsigned char *bytes, size_t size, std::chrono::nanoseconds delay) noexcept {
+  if (g_stateFlag != State::running || g_senderPortId == NULL_ID) {
+    return -EBADFD;
+  }
+  auto nanoseconds = std::max<std::chrono::nanoseconds::rep>(delay.count(), 0);
+  snd_seq_real_time_t time;
+  time.tv_sec = static_cast<unsigned int>(nanoseconds / 1000000000);
+  time.tv_nsec = static_cast<unsigned int>(nanoseconds % 1000000000);
+  snd_seq_event_t event;
+  auto schedule = [&event, &time]() {
+    snd_seq_ev_set_source(&event, g_senderPortId);
+    snd_seq_ev_set_subs(&event);
+    snd_seq_ev_schedule_real(&event, g_outputQueue, 1, &time);
+  };
+
+  if (size > 0 && bytes[0] == 0xF0) {
+    // SysEx is passed on as is, whatever its length.
+    snd_seq_ev_clear(&event);
+    snd_seq_ev_set_sysex(&event, size, const_cast<unsigned char *>(bytes));
+    schedule();
+    return outputEvent(event);
+  }
+  snd_midi_event_reset_encode(g_midiEventEncoderHandle);
+  size_t done = 0;
+  while (done < size) {
+    snd_seq_ev_clear(&event);
+    long consumed =
+        snd_midi_event_encode(g_midiEventEncoderHandle, bytes + done, size - done, &event);
+    if (consumed <= 0) {
+      ALSA_ERROR(consumed, "snd_midi_event_encode");
+      return consumed < 0 ? static_cast<int>(consumed) : -EINVAL;
+    }
+    done += consumed;
+    if (event.type == SND_SEQ_EVENT_NONE) {
+      continue; // an incomplete message.
+    }
+    schedule();
+    int err = outputEvent(event);
+    if (err < 0) {
+      return err;
+    }
+  }
+  return 0;
+}
+
+int flushOutput() noexcept {
+  if (g_stateFlag != State::running || g_senderPortId == NULL_ID) {
+    return -EBADFD;
+  }
+  int err = snd_seq_drain_output(g_sequencerHandle);
+  return err < 0 ? err : 0;
+}
+
+long outputCount() noexcept { return g_outputCount; }
+
 /**
  * List all ports that are connected to the ReceiverPort.
  * @return a list of the ports to which the ReceiverPort is connected. If no
@@ -476,21 +1496,69 @@ void close() noexcept {
     return;
   }
   // make sure that the input queue is stopped.
+  if (g_stateFlag == State::running) {
+    leaveRunningState();
+  }
   stopInternal();
 
   SPDLOG_LOGGER_TRACE(g_logger, "alsaClient::closeAlsaSequencer - closing client {}.", g_clientId);
   snd_midi_event_free(g_midiEventParserHandle);
+  if (g_midiEventEncoderHandle) {
+    snd_midi_event_free(g_midiEventEncoderHandle);
+  }
+  if (g_outputQueue != NULL_ID) {
+    ALSA_ERROR(snd_seq_free_queue(g_sequencerHandle, g_outputQueue), "free queue");
+  }
   int err = snd_seq_close(g_sequencerHandle);
   ALSA_ERROR(err, "close sequencer");
+  if (g_rawMidiHandle) {
+    err = snd_rawmidi_close(g_rawMidiHandle);
+    ALSA_ERROR(err, "close rawmidi");
+  }
 
   // reset common variables to their null values.
   g_portId = NULL_ID;
+  g_probePortId = NULL_ID;
+  g_senderPortId = NULL_ID;
+  g_outputQueue = NULL_ID;
+  g_midiEventEncoderHandle = nullptr;
+  g_destinations.clear();
   g_sequencerHandle = nullptr;
   g_midiEventParserHandle = nullptr;
+  g_rawMidiHandle = nullptr;
+  g_rawMidiDevice.clear();
   g_clientId = NULL_ID;
+  g_adaptiveInputPool = false;
+  g_latencyOffsetCount = 0;
+  g_defaultDelay = 0;
+  g_onAutoSourceHandler = nullptr;
+  g_autoSources.clear();
+  g_portsAnnounced = false;
+  receiverQueue::setUmpInput(false);
   g_stateFlag = State::closed;
 }
 
+std::vector<SourceStatistics> sourceStatistics() {
+  std::unique_lock<std::mutex> lock{g_stateAccessMutex};
+  std::vector<SourceStatistics> result;
+  for (const Source *source : currentSources()) {
+    SourceStatistics statistics;
+    statistics.designation = source->designation;
+    statistics.port = PortID{source->client, source->port};
+    statistics.eventCount = source->eventCount;
+    statistics.connectCount = source->connectCount;
+    statistics.lastArrival = source->lastArrival;
+    result.push_back(statistics);
+  }
+  return result;
+}
+
+long otherSourcesEventCount() { return g_otherEventCount; }
+
+long disconnectCount() noexcept { return g_disconnectCount; }
+
+long recoveryCount() noexcept { return g_recoveryCount; }
+
 std::string clientName() {
   std::unique_lock<std::mutex> lock{g_stateAccessMutex};
   if (g_stateFlag == State::closed) {
@@ -511,6 +1579,12 @@ std::string portName() {
   if (g_stateFlag == State::closed) {
     return "";
   }
+  if (g_rawMidiHandle) {
+    return snd_rawmidi_name(g_rawMidiHandle);
+  }
+  if (!g_rawMidiDevice.empty()) {
+    return g_rawMidiDevice; // the device is gone, it is being re-opened.
+  }
   if (g_portId == NULL_ID) {
     return "";
   }
@@ -552,9 +1626,8 @@ void activate(a2jmidi::ClockPtr clock) noexcept(false) {
     throw std::runtime_error("Clock pointer empty.");
   }
   activateInternal(std::move(clock));
+  // the real-time thread may use the queue from now on.
   g_stateFlag = State::running;
-  // make sure that the port monitor runs at least once.
-  std::this_thread::sleep_for(MONITOR_INTERVAL);
 }
 
 void stop() noexcept {
@@ -562,30 +1635,84 @@ void stop() noexcept {
   if (g_stateFlag != State::running) {
     return;
   }
+  leaveRunningState();
   stopInternal();
-  g_stateFlag = State::idle;
 }
 
-int retrieve(const a2jmidi::TimePoint deadline, const RetrieveCallback &forEachClosure) noexcept {
-  std::unique_lock<std::mutex> lock{g_stateAccessMutex};
-  if (g_stateFlag != State::running) {
+int retrieveDirect(const a2jmidi::TimePoint deadline,
+                   const RetrieveDirectCallback &forEachClosure) noexcept {
+  RealTimeSection section;
+  if (!RealTimeSection::isRunning()) {
     return -1;
   }
 
   int err = 0;
+  const bool shifting = g_latencyOffsetCount > 0;
 
+  // the procedure to be executed on each held event that is due.
+  auto releaseClosure = [&forEachClosure, &err](const HoldBuffer::Entry &held) {
+    if (!err) {
+      err = forEachClosure(PendingEvent{held.tag, held.bytes, held.size}, held.due);
+    }
+  };
   // we define the procedure to be executed on each MIDI event in the queue
-  auto processClosure = [&forEachClosure, &err](const snd_seq_event_t &event,
-                                                a2jmidi::TimePoint timeStamp) {
-    const midi::Event midiEvent = parseAlsaEvent(event);
-    if (!midiEvent.empty() && !err) {
-      // we delegate to the given forEachClosure
-      err = forEachClosure(midiEvent, timeStamp);
+  auto processClosure = [&forEachClosure, &err, &releaseClosure,
+                         shifting](const snd_seq_event_t &event, a2jmidi::TimePoint timeStamp) {
+    if (event.source.client == SND_SEQ_CLIENT_SYSTEM &&
+        event.source.port == SND_SEQ_PORT_SYSTEM_ANNOUNCE) {
+      // a port has come or gone, the connection monitor will have a look.
+      g_portsAnnounced = true;
+      return;
     }
+    unsigned char scratch[MAX_MIDI_EVENT_SIZE];
+    const unsigned char *bytes;
+    size_t size = midiSize(event, scratch, &bytes);
+    if (size == 0) {
+      return;
+    }
+    countEvent(event, timeStamp);
+    if (err) {
+      return;
+    }
+    const PendingEvent pending = bytes ? PendingEvent{event, bytes, size} : PendingEvent{event};
+    if (shifting) {
+      if (g_holdBuffer.hold(timeStamp + delayOf(event.source), event, size,
+                            [&pending](unsigned char *buffer) { pending.writeTo(buffer); })) {
+        return;
+      }
+      // too large to be held (or the hold buffer is full), pass it on without shifting.
+      g_holdBuffer.release(timeStamp, releaseClosure);
+    }
+    // we delegate to the given forEachClosure
+    err = forEachClosure(pending, timeStamp);
   };
   // apply the processClosure on the queue
   alsaClient::receiverQueue::process(deadline, processClosure);
+  if (shifting) {
+    g_holdBuffer.release(deadline, releaseClosure);
+  }
   return err;
 }
 
+int retrieve(const a2jmidi::TimePoint deadline, const RetrieveCallback &forEachClosure) noexcept {
+  return retrieveDirect(deadline,
+                        [&forEachClosure](const PendingEvent &event, a2jmidi::TimePoint timeStamp) {
+                          midi::Event midiEvent(event.size());
+                          event.writeTo(midiEvent.data());
+                          return forEachClosure(midiEvent, timeStamp);
+                        });
+}
+
+int skip(const a2jmidi::TimePoint limit) noexcept {
+  RealTimeSection section;
+  if (!RealTimeSection::isRunning()) {
+    return 0;
+  }
+  int skipped = alsaClient::receiverQueue::skip(limit);
+  if (g_latencyOffsetCount > 0) {
+    skipped += g_holdBuffer.dropBefore(limit);
+  }
+  return skipped;
+}
+
 } // namespace alsaClient
@@ -20,9 +20,12 @@
 #define A_J_MIDI_SRC_ALSA_CLIENT_H
 
 #include "a2jmidi_clock.h"
+#include "alsa_encoder.h"
 #include "midi.h"
 #include "sys_clock.h"
 #include <alsa/asoundlib.h>
+#include <chrono>
+#include <cstring>
 #include <functional>
 #include <sstream>
 #include <stdexcept>
@@ -57,6 +60,10 @@ inline namespace impl {
 using namespace std::chrono_literals;
 
 constexpr sysClock::SysTimeUnits MONITOR_INTERVAL{500ms};
+/**
+ * How often the monitoring thread checks whether the receiver has failed.
+ */
+constexpr sysClock::SysTimeUnits RECOVERY_INTERVAL{20ms};
 
 
 using PortCaps = unsigned int;
@@ -69,7 +76,7 @@ constexpr PortCaps SENDER_PORT{SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_REA
  * A _receiver port_ has the capabilities to be __writable__ and to allow
  * write subscription. ALSA documentation calls such a port an __output__ port.
  */
-constexpr PortCaps RECEIVER_PORT{SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ};
+constexpr PortCaps RECEIVER_PORT{SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_SUBS_WRITE};
 inline bool fulfills(PortCaps actualCaps, PortCaps requestedCaps){
   return (requestedCaps == (actualCaps & requestedCaps));
 }
@@ -136,11 +143,20 @@ using OnMonitorConnectionsHandler = std::function<PortID(const std::string &conn
 /**
  * Register a handler that shall be called be regular time-intervals
  * to control the state of the connections to the port.
+ *
+ * The handler is first called from within `activate` (so that the requested connections
+ * exist when `activate` returns), later from the monitoring thread.
  * @param handler - the function to be called
  * @throws BadStateException - if the `alsaClient` is in `running` state.
  */
 void onMonitorConnections(const OnMonitorConnectionsHandler &handler) noexcept(false) ;
 
+/**
+ * The number of lists of sources held in memory: the current one, plus those replaced by
+ * `setConnectTargets` and not yet reclaimed.
+ */
+size_t sourceListCount();
+
 
 } // namespace impl
 
@@ -176,6 +192,22 @@ enum class State : int {
  * @return the current state of the `alsaClient`.
  */
 State state();
+
+/**
+ * The largest kernel input pool that the ALSA sequencer accepts (`SNDRV_SEQ_MAX_EVENTS`).
+ */
+constexpr int MAX_INPUT_POOL{2000};
+
+/**
+ * The sizes of the buffers that hold incoming events until the listener retrieves them.
+ *
+ * A value of zero keeps the ALSA default.
+ */
+struct InputPool {
+  int poolSize{0};       ///< the number of events in the kernel input pool.
+  size_t bufferSize{0};  ///< the size (in bytes) of the library input buffer.
+  bool adaptive{false};  ///< when true, the kernel pool grows each time it has overflowed.
+};
 /**
  * Open an external client session with the ALSA server.
  *
@@ -186,6 +218,32 @@ State state();
  * @throws BadStateException - if the `alsaClient` is not in `closed` state.
  */
 void open(const std::string &clientName) noexcept(false);
+/**
+ * Set the sizes of the kernel input pool and of the library input buffer.
+ *
+ * Larger sizes protect against losing events during SysEx dumps or controller floods.
+ *
+ * @param inputPool - the requested sizes.
+ * @throws BadStateException - if the `alsaClient` is not in `idle` state.
+ * @throws ServerException - if the ALSA server refuses the requested sizes.
+ */
+void setInputPool(const InputPool &inputPool) noexcept(false);
+/**
+ * Switch the client to UMP (MIDI 2.0) mode, so that packets are received as they are
+ * and translated into MIDI 1.0 bytes only when they are retrieved.
+ *
+ * Shall be called from the `idle` state, before `newReceiverPort`. Has no effect on a
+ * rawmidi input.
+ * @throws BadStateException - if the `alsaClient` is not in `idle` state.
+ * @throws ServerException - if alsa-lib (older than 1.2.10) or the kernel do not support UMP.
+ */
+void enableUmp() noexcept(false);
+/**
+ * The current size of the kernel input pool.
+ * @return the number of events the kernel input pool can hold, or zero if the
+ * `alsaClient` is closed.
+ */
+int inputPoolSize();
 /**
  * In future, we might introduce a dedicated `ReceiverPort` class.
  */
@@ -199,17 +257,299 @@ using ReceiverPort = void;
  * __Note 2__: in the current implementation, this function shall only be called from the
  * `idle` state.
  *
+ * Events from all sources arrive in one FIFO of the ALSA sequencer, thus they are
+ * delivered in the order of their arrival.
+ *
  * @param portName  - a desired name for the new port.
  * The server may modify this name to create a unique variant, if needed.
- * @param connectTo - the designation of a sender-port that this port shall try to connect.
- * If the connection fails, the port is nevertheless created. An empty string denotes
- * that no connection shall be attempted.
+ * @param connectTo - the designations of the sender-ports that this port shall try to connect.
+ * Each connection is monitored (and re-established) on its own. If a connection fails,
+ * the port is nevertheless created.
  * @return the input port.
  * @throws BadStateException - if port creation is attempted from a state other than `idle`.
  * @throws ServerException - if the ALSA server has encountered a problem.
  */
 ReceiverPort newReceiverPort(const std::string &portName,
-                             const std::string &connectTo = "") noexcept(false);
+                             const std::vector<std::string> &connectTo = {}) noexcept(false);
+/**
+ * Create a new ALSA MIDI input port that connects to (at most) one sender-port.
+ * @param portName  - a desired name for the new port.
+ * @param connectTo - the designation of a sender-port that this port shall try to connect.
+ * An empty string denotes that no connection shall be attempted.
+ * @throws BadStateException - if port creation is attempted from a state other than `idle`.
+ * @throws ServerException - if the ALSA server has encountered a problem.
+ */
+ReceiverPort newReceiverPort(const std::string &portName,
+                             const std::string &connectTo) noexcept(false);
+
+/**
+ * Read MIDI directly from a hardware port, bypassing the ALSA sequencer.
+ *
+ * The rawmidi device is opened in non-blocking mode; its byte stream is split into
+ * messages (honouring running status) and fed into the same receiver queue as the events
+ * of a receiver port. This avoids the hop through the kernel sequencer client and the
+ * re-encoding of its events.
+ *
+ * A client can either have a receiver port or a rawmidi input, not both.
+ * This function shall only be called from the `idle` state.
+ *
+ * @param device - the ALSA name of the rawmidi device (for example "hw:1,0,0").
+ * @throws BadStateException - if called from a state other than `idle`.
+ * @throws ServerException - if the device cannot be opened, or if the client already has
+ * an input.
+ */
+ReceiverPort newRawMidiInput(const std::string &device) noexcept(false);
+
+/**
+ * Create a port that sends probe notes into the receiver port of this client.
+ *
+ * Shall be called from the `idle` state, after `newReceiverPort`.
+ * @return the identity of the probe port, events sent through it carry it as `sender()`.
+ * @throws BadStateException - if called from a state other than `idle`.
+ * @throws ServerException - if there is no receiver port, or if the ALSA server has
+ * encountered a problem.
+ */
+PortID newProbePort() noexcept(false);
+/**
+ * Create a port that sends probe notes through an external loop (for example a MIDI
+ * cable from an output back to an input), instead of into the receiver port directly.
+ *
+ * The input end of the loop must be connected to the receiver port (see `newReceiverPort`).
+ * Shall be called from the `idle` state.
+ * @param through - the designation of the receiver-port where the loop starts.
+ * @return the identity of the probe port.
+ * @throws BadStateException - if called from a state other than `idle`.
+ * @throws ServerException - if the port `through` cannot be found or connected.
+ */
+PortID newProbePort(const std::string &through) noexcept(false);
+/**
+ * Send a note-on through the probe port, immediately (without scheduling).
+ * @param channel - the MIDI channel (zero based).
+ * @param key - the note number.
+ * @throws ServerException - if the event cannot be sent.
+ */
+void sendProbe(unsigned char channel, unsigned char key) noexcept(false);
+
+/**
+ * In future, we might introduce a dedicated `SenderPort` class.
+ */
+using SenderPort = void;
+
+/**
+ * The size (in bytes) of the library output buffer of a client with a sender port.
+ * It holds the events of one period before they are drained.
+ */
+constexpr size_t OUTPUT_BUFFER_SIZE{64 * 1024};
+
+/**
+ * Create a new ALSA MIDI output port, together with the queue on which its events
+ * are scheduled. External applications can read from this port.
+ *
+ * A client can have a sender port besides its receiver port. This function shall only be
+ * called from the `idle` state; the queue runs while the client is running.
+ *
+ * @param portName  - a desired name for the new port.
+ * @param connectTo - the designations of the receiver-ports that this port shall try to
+ * connect. Each connection is monitored (and re-established) on its own.
+ * @throws BadStateException - if called from a state other than `idle`.
+ * @throws ServerException - if there is already a sender port, or if the ALSA server has
+ * encountered a problem.
+ */
+SenderPort newSenderPort(const std::string &portName,
+                         const std::vector<std::string> &connectTo = {}) noexcept(false);
+
+/**
+ * Put one MIDI message into the output buffer of the sender port.
+ *
+ * The message is scheduled on the queue, `delay` after the buffer reaches the sequencer
+ * (see `flushOutput`), so that messages of one batch keep their spacing.
+ * Shall only be called in `running` state, from one thread at a time; it is not meant for
+ * the real-time thread.
+ * @param bytes - a complete MIDI message (or several).
+ * @param size - the number of bytes.
+ * @param delay - when the message shall be delivered, relative to the flush.
+ * @return zero on success, a negative ALSA error code if the message could not be buffered.
+ */
+int output(const unsigned char *bytes, size_t size, std::chrono::nanoseconds delay) noexcept;
+
+/**
+ * Hand the buffered messages over to the sequencer.
+ * @return zero on success, a negative ALSA error code otherwise.
+ */
+int flushOutput() noexcept;
+
+/**
+ * The number of MIDI messages sent through the sender port.
+ */
+long outputCount() noexcept;
+
+/**
+ * The largest number of entries in the latency offset table.
+ */
+constexpr int MAX_LATENCY_OFFSETS{32};
+
+/**
+ * Shifts the time stamps of the events from one source.
+ *
+ * A positive offset delays the events of the source. A negative offset would move them
+ * into the past; instead, the events of all other sources are delayed by its magnitude.
+ */
+struct LatencyOffset {
+  std::string designation;     ///< the sender-port (or client), designated as in `--connect`.
+  a2jmidi::TimePoint offset{0}; ///< the shift, in units of the clock given to `activate`.
+};
+
+/**
+ * Set the latency offset table, replacing the previous one.
+ *
+ * The designations are resolved (and re-resolved when ports come and go) by the connection
+ * monitor; events from a source are attributed by their sender address. Events whose
+ * shifted time is later than the deadline of `retrieve` stay in a hold buffer until they
+ * are due, so the events of one call are always in time order. An empty table turns the
+ * shifting off.
+ *
+ * @param offsets - at most `MAX_LATENCY_OFFSETS` entries.
+ * @throws BadStateException - if the `alsaClient` is not in `idle` state.
+ * @throws std::invalid_argument - if there are too many entries.
+ */
+void setLatencyOffsets(const std::vector<LatencyOffset> &offsets) noexcept(false);
+
+/**
+ * The largest number of sender-ports that can be bridged automatically at the same time.
+ */
+constexpr int MAX_AUTO_SOURCES{64};
+
+/**
+ * The kind of ALSA client whose ports are bridged automatically.
+ */
+enum class ClientKind : int {
+  hardware, ///< ports of kernel clients that are typed as hardware (the sound card drivers).
+  software, ///< ports of user-space clients (applications).
+  all,      ///< any port, except those of the system client and of this client.
+};
+
+/**
+ * Which sender-ports are bridged automatically (see `setAutoConnect`).
+ */
+struct AutoFilter {
+  PortCaps caps{SENDER_PORT};               ///< the capabilities a port must have.
+  ClientKind clientKind{ClientKind::hardware}; ///< the kind of client a port must belong to.
+};
+
+/**
+ * Implementation specific stuff.
+ */
+inline namespace impl {
+/**
+ * Decide whether a port passes the filter of the automatic mode.
+ *
+ * The ports of the system client, the ports of this client and ports that do not want
+ * to be exported (`SND_SEQ_PORT_CAP_NO_EXPORT`) never pass.
+ * @param filter - the requested capabilities and client kind.
+ * @param caps - the capabilities of the actual port.
+ * @param portType - the type bits of the actual port (`snd_seq_port_info_get_type`).
+ * @param clientType - the type of the client that owns the port.
+ * @param port - the formal identity of the actual port.
+ * @param ownClient - the client-number of this client.
+ * @return true if the port shall be bridged.
+ */
+bool autoMatches(const AutoFilter &filter, PortCaps caps, unsigned int portType,
+                 snd_seq_client_type_t clientType, PortID port, int ownClient);
+} // namespace impl
+
+/**
+ * Prototype for the function that is told when a sender-port appears or disappears
+ * in automatic mode.
+ *
+ * It is called by the connection monitor (never by the real-time thread).
+ * @param port - the sender-port.
+ * @param clientName - the name of the client that owns the port.
+ * @param portName - the name of the port.
+ * @param added - true when the port has appeared, false when it has gone.
+ * @return when `added`: true if the port shall be connected, false if it cannot be taken now
+ * (it is then offered again on the next check). Ignored when the port has gone.
+ */
+using OnAutoSourceHandler = std::function<bool(PortID port, const std::string &clientName,
+                                               const std::string &portName, bool added)>;
+
+/**
+ * Bridge every sender-port that passes the filter, as long as it exists.
+ *
+ * The receiver port subscribes to the announcements of the sequencer, so that the
+ * connection monitor checks the ports as soon as one comes or goes (and besides that,
+ * every `MONITOR_INTERVAL`). Each matching port is offered to the handler, and connected
+ * to the receiver port once the handler has accepted it. Events tell their port through
+ * `PendingEvent::sender()`.
+ *
+ * Shall be called from the `idle` state, after `newReceiverPort`.
+ * @param filter - which ports to bridge.
+ * @param handler - told about each port that appears or disappears.
+ * @throws BadStateException - if called from a state other than `idle`.
+ * @throws ServerException - if there is no receiver port, or if the ALSA server refuses
+ * the subscription to the announcements.
+ */
+void setAutoConnect(const AutoFilter &filter, const OnAutoSourceHandler &handler) noexcept(false);
+
+/**
+ * Replace the filter of the automatic mode, while the client is idle or running.
+ *
+ * The connection monitor applies the new filter at once: ports that no longer pass are
+ * disconnected (and reported to the handler as gone), new ones are offered.
+ * @param filter - which ports to bridge.
+ * @throws BadStateException - if the client is closed, or `setAutoConnect` has not been called.
+ */
+void setAutoFilter(const AutoFilter &filter) noexcept(false);
+
+/**
+ * Replace the sender-ports that the receiver port connects to, while the client is idle or
+ * running.
+ *
+ * The sources that are requested again keep their connection and their counters. The others
+ * are disconnected; the new ones are connected by the connection monitor at once. The new
+ * list is published to the real-time thread by an atomic pointer swap, so `retrieveDirect`
+ * never waits for the change.
+ * @param connectTo - the designations of the sender-ports, as in `newReceiverPort`.
+ * @throws BadStateException - if the client is closed, has no receiver port, or is in
+ * automatic mode.
+ */
+void setConnectTargets(const std::vector<std::string> &connectTo) noexcept(false);
+
+/**
+ * Counters for one of the sender-ports requested in `newReceiverPort`.
+ */
+struct SourceStatistics {
+  std::string designation;             ///< the designation of the port, as given by the user.
+  PortID port{NULL_PORT_ID};           ///< the currently connected port (or NULL_PORT_ID).
+  long eventCount{0};                  ///< the number of MIDI events received from this source.
+  long connectCount{0};                ///< how often this source has been (re-)connected.
+  a2jmidi::TimePoint lastArrival{0};   ///< when the latest event has been received.
+};
+
+/**
+ * The counters for each of the sender-ports requested in `newReceiverPort`.
+ * @return one entry per requested sender-port, in the order of the request.
+ */
+std::vector<SourceStatistics> sourceStatistics();
+/**
+ * The number of MIDI events received from ports that were not requested in `newReceiverPort`
+ * (for example ports connected through `aconnect`).
+ * @return the number of events.
+ */
+long otherSourcesEventCount();
+
+/**
+ * How often the connection to a requested sender-port has been lost, as noticed by
+ * the connection monitor. Can be called from the real-time thread.
+ * @return the number of lost connections since the start of the program.
+ */
+long disconnectCount() noexcept;
+
+/**
+ * How often the receiver has been restarted after it had failed (for example because
+ * a rawmidi device had been unplugged and plugged again).
+ * @return the number of successful recoveries since the start of the program.
+ */
+long recoveryCount() noexcept;
 
 /**
  * List all ports that are connected to the ReceiverPort.
@@ -259,11 +599,101 @@ using RetrieveCallback =
  *
  * All processed events will be removed from the input queue (and from memory).
  *
+ * This function is meant to be called from the JACK process thread; it never waits for
+ * a state change (`activate`, `stop`, `close`) in progress. When the client is not
+ * running, it returns at once.
+ *
  * @param deadline - the time limit beyond which events will remain in the queue.
  * @param forEachClosure - the function to execute on each Event. It must be of type `ProcessCallback`.
  * @return zero on success, a non zero value if an error occurred.
  */
 int retrieve(a2jmidi::TimePoint deadline, const RetrieveCallback &forEachClosure) noexcept;
+/**
+ * A received event whose MIDI bytes have not been written yet.
+ *
+ * The exact number of MIDI bytes is known beforehand, so that the caller can provide
+ * memory of the right size (for example through `jack_midi_event_reserve`) and let the
+ * bytes be written there directly.
+ */
+class PendingEvent {
+private:
+  const snd_seq_event_t &m_event;
+  const unsigned char *const m_bytes; ///< already available bytes, nullptr for the fast path.
+  const size_t m_size;
+
+public:
+  /**
+   * Constructor for an event that is encoded by the fast path.
+   * @param event - the sequencer event, it must have a fast path.
+   */
+  explicit PendingEvent(const snd_seq_event_t &event)
+      : m_event{event}, m_bytes{nullptr},
+        m_size{static_cast<size_t>(encoder::sizeOf(event))} {}
+  /**
+   * Constructor for an event whose MIDI bytes are already available.
+   * @param event - the sequencer event.
+   * @param bytes - the MIDI bytes of the event (must outlive this object).
+   * @param size - the number of MIDI bytes.
+   */
+  PendingEvent(const snd_seq_event_t &event, const unsigned char *bytes, size_t size)
+      : m_event{event}, m_bytes{bytes}, m_size{size} {}
+
+  /**
+   * The number of MIDI bytes of this event.
+   */
+  size_t size() const { return m_size; }
+  /**
+   * The port that has sent this event.
+   */
+  PortID sender() const { return PortID{m_event.source.client, m_event.source.port}; }
+  /**
+   * The first MIDI byte of this event.
+   */
+  unsigned char status() const { return m_bytes ? m_bytes[0] : encoder::statusOf(m_event); }
+  /**
+   * Write the MIDI bytes of this event.
+   * @param buffer - receives exactly `size()` bytes.
+   */
+  void writeTo(unsigned char *buffer) const {
+    if (m_bytes) {
+      std::memcpy(buffer, m_bytes, m_size);
+    } else {
+      encoder::encode(m_event, buffer);
+    }
+  }
+};
+
+/**
+ * The function type to be used in the `retrieveDirect` call.
+ * @param event - the current MIDI event, not yet written.
+ * @param timeStamp - the point in time when the event was recorded.
+ * @return a non zero value if an error occurred.
+ */
+using RetrieveDirectCallback =
+    std::function<int(const PendingEvent &event, const a2jmidi::TimePoint timeStamp)>;
+
+/**
+ * Retrieve all events that were registered up to a given deadline, without
+ * decoding them into intermediate storage.
+ *
+ * Apart from the callback, this function behaves like `retrieve`.
+ *
+ * @param deadline - the time limit beyond which events will remain in the queue.
+ * @param forEachClosure - the function to execute on each Event.
+ * @return zero on success, a non zero value if an error occurred.
+ */
+int retrieveDirect(a2jmidi::TimePoint deadline,
+                   const RetrieveDirectCallback &forEachClosure) noexcept;
+/**
+ * Discard all events that were received before the given time limit without processing them.
+ *
+ * Use this function to resynchronize after a discontinuity (hibernation,
+ * freewheeling or long xruns).
+ *
+ * @param limit - events received before this time limit are discarded.
+ * @return the number of discarded events.
+ */
+int skip(a2jmidi::TimePoint limit) noexcept;
 /**
  * The client-name aka device-name identifies a midi device or an application.
  * @return the name chosen by the ALSA system.
@@ -271,7 +701,7 @@ int retrieve(a2jmidi::TimePoint deadline, const RetrieveCallback &forEachClosure
 std::string clientName();
 /**
  *
- * @return the name of the port
+ * @return the name of the port (or the name of the rawmidi device).
  */
 std::string portName();
 
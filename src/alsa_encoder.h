@@ -0,0 +1,170 @@
+/*
+ * File: alsa_encoder.h
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef A_J_MIDI_SRC_ALSA_ENCODER_H
+#define A_J_MIDI_SRC_ALSA_ENCODER_H
+
+#include <alsa/asoundlib.h>
+#include <array>
+
+/**
+ * A fast path to turn the channel-voice events of the ALSA sequencer into MIDI bytes.
+ *
+ * Note on/off, polyphonic and channel pressure, controller, program change and pitch bend
+ * map directly from the fields of `snd_seq_event_t` to one to three bytes. For these
+ * events, the encoder produces exactly the same bytes as `snd_midi_event_decode()` does
+ * (with running status disabled), without going through the stateful alsa-lib decoder.
+ *
+ * All other events (SysEx, 14-bit controllers, RPN/NRPN, system messages...) are left to
+ * `snd_midi_event_decode()`.
+ */
+namespace alsaClient::encoder {
+
+/**
+ * The largest number of bytes that the fast path writes.
+ */
+constexpr int MAX_FAST_EVENT_SIZE{3};
+
+/**
+ * Implementation specific stuff.
+ */
+inline namespace impl {
+
+/**
+ * Prototype for a function that encodes one kind of event.
+ * @param event - the sequencer event.
+ * @param status - the status byte (without channel) for this kind of event.
+ * @param buffer - receives the MIDI bytes.
+ * @return the number of bytes written.
+ */
+using EncodeFunction = int (*)(const snd_seq_event_t &event, unsigned char status,
+                               unsigned char *buffer);
+
+inline int encodeNote(const snd_seq_event_t &event, unsigned char status, unsigned char *buffer) {
+  buffer[0] = status | (event.data.note.channel & 0x0FU);
+  buffer[1] = event.data.note.note & 0x7FU;
+  buffer[2] = event.data.note.velocity & 0x7FU;
+  return 3;
+}
+
+inline int encodeController(const snd_seq_event_t &event, unsigned char status,
+                            unsigned char *buffer) {
+  buffer[0] = status | (event.data.control.channel & 0x0FU);
+  buffer[1] = event.data.control.param & 0x7FU;
+  buffer[2] = event.data.control.value & 0x7FU;
+  return 3;
+}
+
+inline int encodeOneParameter(const snd_seq_event_t &event, unsigned char status,
+                              unsigned char *buffer) {
+  buffer[0] = status | (event.data.control.channel & 0x0FU);
+  buffer[1] = event.data.control.value & 0x7FU;
+  return 2;
+}
+
+inline int encodePitchBend(const snd_seq_event_t &event, unsigned char status,
+                           unsigned char *buffer) {
+  // the sequencer uses -8192...8191, MIDI uses 0...16383 split into two 7-bit bytes.
+  unsigned int value = event.data.control.value + 8192;
+  buffer[0] = status | (event.data.control.channel & 0x0FU);
+  buffer[1] = value & 0x7FU;
+  buffer[2] = (value >> 7U) & 0x7FU;
+  return 3;
+}
+
+/**
+ * How to encode one type of sequencer event.
+ */
+struct Encoding {
+  EncodeFunction encode{nullptr}; ///< nullptr - this type is left to alsa-lib.
+  unsigned char status{0};        ///< the MIDI status byte (without channel).
+  unsigned char size{0};          ///< the number of MIDI bytes.
+};
+
+/**
+ * The number of distinct sequencer event types (`snd_seq_event_type_t` is one byte).
+ */
+constexpr int EVENT_TYPE_COUNT{256};
+
+using EncodingTable = std::array<Encoding, EVENT_TYPE_COUNT>;
+
+constexpr EncodingTable makeEncodingTable() {
+  EncodingTable table{};
+  table[SND_SEQ_EVENT_NOTEOFF] = {encodeNote, 0x80, 3};
+  table[SND_SEQ_EVENT_NOTEON] = {encodeNote, 0x90, 3};
+  table[SND_SEQ_EVENT_KEYPRESS] = {encodeNote, 0xA0, 3};
+  table[SND_SEQ_EVENT_CONTROLLER] = {encodeController, 0xB0, 3};
+  table[SND_SEQ_EVENT_PGMCHANGE] = {encodeOneParameter, 0xC0, 2};
+  table[SND_SEQ_EVENT_CHANPRESS] = {encodeOneParameter, 0xD0, 2};
+  table[SND_SEQ_EVENT_PITCHBEND] = {encodePitchBend, 0xE0, 3};
+  return table;
+}
+
+/**
+ * For each sequencer event type, how to encode it.
+ */
+inline constexpr EncodingTable ENCODING_TABLE{makeEncodingTable()};
+
+} // namespace impl
+
+/**
+ * Indicates whether the given event can be encoded by the fast path.
+ * @param event - the sequencer event.
+ * @return true if `encode()` handles this event.
+ */
+inline bool hasFastPath(const snd_seq_event_t &event) noexcept {
+  return ENCODING_TABLE[event.type].encode != nullptr;
+}
+
+/**
+ * The number of bytes that `encode()` will write for the given event.
+ * @param event - the sequencer event.
+ * @return the number of MIDI bytes, or zero if the event has no fast path.
+ */
+inline int sizeOf(const snd_seq_event_t &event) noexcept {
+  return ENCODING_TABLE[event.type].size;
+}
+
+/**
+ * The status byte (including the channel) that `encode()` will write for the given event.
+ * @param event - a sequencer event that has a fast path.
+ * @return the first MIDI byte.
+ */
+inline unsigned char statusOf(const snd_seq_event_t &event) noexcept {
+  // `data.note.channel` and `data.control.channel` are at the same place.
+  return ENCODING_TABLE[event.type].status | (event.data.note.channel & 0x0FU);
+}
+
+/**
+ * Encode a channel-voice event into MIDI bytes.
+ * @param event - the sequencer event.
+ * @param buffer - receives the MIDI bytes, must hold at least `MAX_FAST_EVENT_SIZE` bytes.
+ * @return the number of bytes written, or zero if the event must be decoded by
+ * `snd_midi_event_decode()`.
+ */
+inline int encode(const snd_seq_event_t &event, unsigned char *buffer) noexcept {
+  const Encoding &encoding = ENCODING_TABLE[event.type];
+  if (!encoding.encode) {
+    return 0;
+  }
+  return encoding.encode(event, encoding.status, buffer);
+}
+
+} // namespace alsaClient::encoder
+
+#endif // A_J_MIDI_SRC_ALSA_ENCODER_H
@@ -17,13 +17,25 @@
  * limitations under the License.
  */
 #include "alsa_receiver_queue.h"
+#include "midi_stream_parser.h"
+#include "midi_ump.h"
 #include "spdlog/sinks/stdout_color_sinks.h"
 #include "spdlog/spdlog.h"
+#include <algorithm>
 #include <forward_list>
+#include <iterator>
+#include <limits>
 #include <memory>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
 #include <poll.h>
-#include <utility>
 #include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 namespace alsaClient::receiverQueue {
 static auto g_logger = spdlog::stdout_color_mt("alsa_receiver_queue");
@@ -50,6 +62,13 @@ using FutureAlsaEvents = std::future<AlsaEventPtr>;
  * A container that can hold several sequencer events.
  */
 using EventList = std::forward_list<snd_seq_event_t>;
+/**
+ * A container for the data of variable-length events (such as SysEx).
+ *
+ * The `data.ext.ptr` of a variable-length event in an `EventList` points into one of
+ * the elements. The element addresses are stable, even when the container is moved.
+ */
+using ExtDataList = std::forward_list<std::vector<unsigned char>>;
 
 static std::atomic<bool> g_carryOnFlag{false}; ///< when false, the receiverQueue will be shut down.
 /**
@@ -63,6 +82,75 @@ static State g_stateFlag{State::stopped};
  * The number of event-batches currently stored in the queue.
  */
 static std::atomic<int> g_currentEventBatchCount{0};
+/**
+ * The number of events currently stored in the queue.
+ */
+static std::atomic<int> g_currentEventCount{0};
+/**
+ * The (estimated) number of bytes occupied by the events currently stored in the queue.
+ */
+static std::atomic<long> g_currentByteCount{0};
+/**
+ * The largest number of events that has been stored in the queue so far.
+ */
+static std::atomic<int> g_highWatermarkEvents{0};
+/**
+ * The largest number of bytes that has been occupied by the queue so far.
+ */
+static std::atomic<long> g_highWatermarkBytes{0};
+/**
+ * The number of events that were discarded because the queue had reached its ceiling.
+ */
+static std::atomic<long> g_droppedEventCount{0};
+/**
+ * The number of controller values that were removed because a later value of the same
+ * controller had been received (see `OverflowPolicy::coalesceControllers`).
+ */
+static std::atomic<long> g_coalescedEventCount{0};
+/**
+ * The number of times the kernel input pool of the sequencer has overflowed.
+ */
+static std::atomic<long> g_kernelOverflowCount{0};
+/**
+ * True while incoming events are being dropped (used to avoid flooding the log).
+ */
+static std::atomic<bool> g_overflowing{false};
+
+static std::atomic<int> g_maxEvents{DEFAULT_MAX_EVENTS};         ///< see `Limits::maxEvents`.
+static std::atomic<long> g_maxBytes{DEFAULT_MAX_BYTES};          ///< see `Limits::maxBytes`.
+static std::atomic<OverflowPolicy> g_policy{OverflowPolicy::dropOldest}; ///< see `Limits::policy`.
+static std::atomic<IngestionMode> g_ingestionMode{IngestionMode::library};
+static std::atomic<bool> g_umpInput{false}; ///< see `setUmpInput`.
+
+/**
+ * The size of the buffer for raw reads. Large enough to hold a few thousand events
+ * (the largest variable-length event that the kernel delivers is smaller).
+ */
+constexpr size_t RAW_BUFFER_SIZE{64 * 1024};
+/**
+ * The preallocated buffer for raw reads.
+ * There is only one listener retrieving events at any time, so one buffer suffices.
+ */
+alignas(snd_seq_event_t) static unsigned char g_rawBuffer[RAW_BUFFER_SIZE];
+/**
+ * Splits the byte stream of a rawmidi input into messages. Like `g_rawBuffer`, it is
+ * only used by the one active listener.
+ */
+static midi::StreamParser g_streamParser;
+/**
+ * Collects the 7-bit SysEx packets of a sequencer client in UMP mode. Like `g_rawBuffer`,
+ * it is only used by the one active listener.
+ */
+static midi::ump::Sysex7Assembler g_sysex7Assembler;
+
+/**
+ * The device that the listeners read from. Exactly one of the handles is set.
+ */
+struct Input {
+  snd_seq_t *sequencer{nullptr}; ///< an ALSA sequencer client.
+  snd_rawmidi_t *rawMidi{nullptr}; ///< an ALSA rawmidi input.
+};
+
 /**
  * The first (and oldest) element in the receiverQueue.
  */
@@ -71,25 +159,96 @@ static FutureAlsaEvents g_queueHead{};
  * Protects the receiverQueue from being simultaneously accessed by multiple threads.
  */
 static std::mutex g_queueAccessMutex;
+/**
+ * Indicates that no purge is pending (see `g_pendingPurge`).
+ */
+constexpr a2jmidi::TimePoint NO_PENDING_PURGE{std::numeric_limits<a2jmidi::TimePoint>::min()};
+/**
+ * The largest limit of the purges that `skip` could not carry out because the queue was
+ * busy. The next `process` or `skip` that gets hold of the queue removes the events
+ * received before it.
+ */
+static std::atomic<a2jmidi::TimePoint> g_pendingPurge{NO_PENDING_PURGE};
 /**
  * The clock to be used for timestamping incoming events.
  */
 static a2jmidi::ClockPtr g_clock;
 
 /**
- * Error handling for ALSA functions.
+ * Raised inside the listener when the input cannot be used any longer.
+ */
+class ListenerFailure : public std::runtime_error {
+public:
+  explicit ListenerFailure(const char *operation) : std::runtime_error(operation){};
+};
+
+/**
+ * Set when the listener has given up, reset by `restart`.
+ */
+static std::atomic<bool> g_listenerFailed{false};
+/**
+ * The number of transient errors since the latest successful read.
+ */
+static std::atomic<int> g_consecutiveErrors{0};
+/**
+ * After so many transient errors in a row, the input is considered broken.
+ */
+constexpr int MAX_CONSECUTIVE_ERRORS{100};
+
+inline namespace impl {
+bool isTransientError(int alsaError) noexcept {
+  switch (alsaError) {
+  case -EINTR:
+  case -EAGAIN:
+  case -ENOMEM:
+  case -ENOBUFS:
+  case -EBUSY:
+    return true;
+  default:
+    return false;
+  }
+}
+} // namespace impl
+
+/**
+ * Error handling for ALSA functions called by the listener.
  * ALSA function often return the error code as a negative result. This function
  * checks the result for negativity.
- * - if negative, it prints the error message and dies.
  * - if positive or zero it does nothing.
+ * - if it is a transient error, it logs the error and backs off for a millisecond.
+ * - otherwise (or after `MAX_CONSECUTIVE_ERRORS` transient errors in a row) it raises
+ *   a `ListenerFailure`.
  * @param operation description of the operation that was attempted.
  * @param alsaResult possible error code from an ALSA call.
- * @ToDo move this function to a sequencer module.
  */
 void checkAlsa(const char *operation, int alsaResult) {
-  if (alsaResult < 0) {
-    SPDLOG_LOGGER_CRITICAL(g_logger, "Cannot {} - {}", operation, snd_strerror(alsaResult));
-    throw std::runtime_error("ALSA problem");
+  if (alsaResult >= 0) {
+    return;
+  }
+  if (isTransientError(alsaResult) && ++g_consecutiveErrors < MAX_CONSECUTIVE_ERRORS) {
+    SPDLOG_LOGGER_WARN(g_logger, "Cannot {} - {}, retrying.", operation, snd_strerror(alsaResult));
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    return;
+  }
+  SPDLOG_LOGGER_CRITICAL(g_logger, "Cannot {} - {}", operation, snd_strerror(alsaResult));
+  throw ListenerFailure(operation);
+}
+
+/**
+ * Register that the queue can no longer be read (called by the consumers, when the
+ * listener has ended on an unexpected exception).
+ */
+void markFailed(const std::exception &failure) noexcept {
+  SPDLOG_LOGGER_ERROR(g_logger, "receiverQueue - listener failed ({}).", failure.what());
+  g_listenerFailed = true;
+}
+
+/**
+ * Raise the given high-watermark to `value` if `value` is larger.
+ */
+template <typename T> inline void raiseWatermark(std::atomic<T> &watermark, T value) {
+  T previous = watermark;
+  while (previous < value && !watermark.compare_exchange_weak(previous, value)) {
   }
 }
 
@@ -104,18 +263,60 @@ struct AlsaEventBatch {
 private:
   FutureAlsaEvents m_next;
   EventList m_eventList;
+  ExtDataList m_extData;
+  const int m_eventCount;
   const a2jmidi::TimePoint m_timeStamp;
+  const long m_byteCount; ///< see `bytesFor`.
 
 public:
+  /**
+   * The estimated memory used by a batch, not counting its events.
+   */
+  static constexpr long BATCH_BYTES = sizeof(FutureAlsaEvents) + sizeof(EventList) + 64;
+  /**
+   * The estimated memory used by one event stored in a batch.
+   */
+  static constexpr long EVENT_BYTES = sizeof(snd_seq_event_t) + sizeof(void *);
+
+  /**
+   * The estimated memory used by one stored event, including the copy of its data when it
+   * has a variable length (SysEx).
+   * @param event - an event to be stored.
+   * @return the estimated number of bytes.
+   */
+  static long bytesFor(const snd_seq_event_t &event) {
+    return EVENT_BYTES +
+           (snd_seq_ev_is_variable(&event) ? static_cast<long>(event.data.ext.len) : 0L);
+  }
+
+  /**
+   * The estimated memory needed to store a batch with the given events.
+   * @param events - the events of the batch.
+   * @return the estimated number of bytes.
+   */
+  static long bytesFor(const EventList &events) {
+    long result = BATCH_BYTES;
+    for (const auto &event : events) {
+      result += bytesFor(event);
+    }
+    return result;
+  }
+
   /**
    * Constructor for an ALSA Events Batch container.
    * @param next - a pointer to the next ALSA event
    * @param eventList - the recorded ALSA sequencer data.
+   * @param extData - the data of the variable-length events in `eventList`.
+   * @param eventCount - the number of events in `eventList`.
    * @param timeStamp - the time point when the events were recorded.
    */
-  AlsaEventBatch(FutureAlsaEvents next, EventList eventList, a2jmidi::TimePoint timeStamp)
-      : m_next{std::move(next)}, m_eventList{std::move(eventList)}, m_timeStamp{timeStamp} {
+  AlsaEventBatch(FutureAlsaEvents next, EventList eventList, ExtDataList extData, int eventCount,
+                 a2jmidi::TimePoint timeStamp)
+      : m_next{std::move(next)}, m_eventList{std::move(eventList)}, m_extData{std::move(extData)},
+        m_eventCount{eventCount}, m_timeStamp{timeStamp}, m_byteCount{bytesFor(m_eventList)} {
     g_currentEventBatchCount++;
+    raiseWatermark(g_highWatermarkEvents, g_currentEventCount += m_eventCount);
+    raiseWatermark(g_highWatermarkBytes, g_currentByteCount += m_byteCount);
     SPDLOG_LOGGER_TRACE(g_logger, "AlsaEventBatch::constructor, event-count {}, state {}",
                         g_currentEventBatchCount, g_stateFlag);
   }
@@ -126,6 +327,8 @@ public:
 
   ~AlsaEventBatch() {
     g_currentEventBatchCount--;
+    g_currentEventCount -= m_eventCount;
+    g_currentByteCount -= m_byteCount;
     SPDLOG_LOGGER_TRACE(g_logger, "AlsaEventBatch::destructor, event-count {}, state {}",
                         g_currentEventBatchCount, g_stateFlag);
   }
@@ -153,6 +356,12 @@ public:
    */
   a2jmidi::TimePoint getTimeStamp() const { return m_timeStamp; }
 
+  /**
+   * The number of events in this batch.
+   * @return the number of events in this batch.
+   */
+  int getEventCount() const { return m_eventCount; }
+
   const EventList &getEventList() { return m_eventList; }
 }; // AlsaEventBatch
 
@@ -162,6 +371,62 @@ public:
  */
 int getCurrentEventBatchCount() { return g_currentEventBatchCount; }
 
+/**
+ * Choose how the listener reads the incoming events (through alsa-lib or in bulk).
+ */
+void setIngestionMode(IngestionMode mode) noexcept { g_ingestionMode = mode; }
+
+/**
+ * Choose whether the sequencer input delivers UMP (MIDI 2.0) packets.
+ */
+void setUmpInput(bool enabled) noexcept { g_umpInput = enabled; }
+
+/**
+ * Set the ceiling for the memory consumed by the queue.
+ * @param limits - the maximum number of events and bytes, and the overflow policy.
+ */
+void setLimits(const Limits &limits) noexcept {
+  g_maxEvents = limits.maxEvents;
+  g_maxBytes = limits.maxBytes;
+  g_policy = limits.policy;
+}
+
+/**
+ * The ceiling currently in use.
+ * @return the maximum number of events and bytes, and the overflow policy.
+ */
+Limits getLimits() noexcept {
+  Limits result;
+  result.maxEvents = g_maxEvents;
+  result.maxBytes = g_maxBytes;
+  result.policy = g_policy;
+  return result;
+}
+
+/**
+ * Get the current filling and the high-watermarks of the queue.
+ * @return the current statistics.
+ */
+Statistics getStatistics() noexcept {
+  Statistics result;
+  result.eventCount = g_currentEventCount;
+  result.byteCount = g_currentByteCount;
+  result.highWatermarkEvents = g_highWatermarkEvents;
+  result.highWatermarkBytes = g_highWatermarkBytes;
+  result.droppedEventCount = g_droppedEventCount;
+  result.coalescedEventCount = g_coalescedEventCount;
+  result.kernelOverflowCount = g_kernelOverflowCount;
+  return result;
+}
+
+void resetStatistics() noexcept {
+  g_highWatermarkEvents = g_currentEventCount.load();
+  g_highWatermarkBytes = g_currentByteCount.load();
+  g_droppedEventCount = 0;
+  g_coalescedEventCount = 0;
+  g_kernelOverflowCount = 0;
+}
+
 /**
  * Indicates the state of the current `receiverQueue`.
  * This function might block when the queue is shutting down.
@@ -195,6 +460,43 @@ bool isReady(const FutureAlsaEvents &futureAlsaEvent) {
   return result;
 }
 
+FutureAlsaEvents skipInternal(FutureAlsaEvents &&queueHeadInternal, a2jmidi::TimePoint limit,
+                              int &skippedCount) {
+  while (isReady(queueHeadInternal)) {
+    try {
+      AlsaEventPtr alsaEvents = queueHeadInternal.get(); // might throw when queue has been stopped.
+      if (alsaEvents->getTimeStamp() >= limit) {
+        // this batch is recent enough, give it back.
+        std::promise<AlsaEventPtr> restartEvents;
+        restartEvents.set_value(std::move(alsaEvents));
+        return restartEvents.get_future();
+      }
+      skippedCount += alsaEvents->getEventCount();
+      queueHeadInternal = std::move(alsaEvents->grabNext());
+    } catch (const InterruptedException &) {
+      break;
+    } catch (const std::exception &failure) {
+      markFailed(failure);
+      break;
+    }
+  }
+  return std::move(queueHeadInternal);
+}
+
+/**
+ * Carry out the purge that `skip` could not do. Shall be called with `g_queueAccessMutex`
+ * held.
+ * @return the number of events that have been removed.
+ */
+int applyPendingPurge() {
+  a2jmidi::TimePoint limit = g_pendingPurge.exchange(NO_PENDING_PURGE);
+  int skippedCount = 0;
+  if (limit != NO_PENDING_PURGE && g_queueHead.valid()) {
+    g_queueHead = std::move(skipInternal(std::move(g_queueHead), limit, skippedCount));
+  }
+  return skippedCount;
+}
+
 FutureAlsaEvents processInternal(FutureAlsaEvents &&queueHeadInternal, a2jmidi::TimePoint deadline,
                                  const ProcessCallback &closure) {
   //  SPDLOG_LOGGER_TRACE(g_logger,"receiverQueue::processInternal() - event-count {}, deadline {}
@@ -220,6 +522,10 @@ FutureAlsaEvents processInternal(FutureAlsaEvents &&queueHeadInternal, a2jmidi::
       // we have tried to get an alsaEventPtr from a future that has been stopped.
       // So we will stop here.
       break;
+    } catch (const std::exception &failure) {
+      // the listener has ended on an error, the queue stays empty until it is restarted.
+      markFailed(failure);
+      break;
     }
   }
   return std::move(queueHeadInternal);
@@ -237,11 +543,36 @@ FutureAlsaEvents processInternal(FutureAlsaEvents &&queueHeadInternal, a2jmidi::
  * @param closure - the function to execute on each Event. It must be of type `processCallback`.
  */
 void process(a2jmidi::TimePoint deadline, const ProcessCallback &closure) noexcept {
-  std::unique_lock<std::mutex> lock{g_queueAccessMutex};
+  // the caller is usually the real-time thread, it shall never wait. If the listener
+  // is trimming the queue just now, the events are processed on the next call.
+  std::unique_lock<std::mutex> lock{g_queueAccessMutex, std::try_to_lock};
+  if (!lock.owns_lock()) {
+    return;
+  }
+  applyPendingPurge(); // stale events are never delivered.
   if (g_queueHead.valid()) {
     g_queueHead = std::move(processInternal(std::move(g_queueHead), deadline, closure));
   }
 }
+
+/**
+ * Remove, in one go, all events that were received before the given time limit.
+ * @param limit - events received before this time limit are removed.
+ * @return the number of events that have been removed.
+ */
+int skip(a2jmidi::TimePoint limit) noexcept {
+  std::unique_lock<std::mutex> lock{g_queueAccessMutex, std::try_to_lock};
+  if (!lock.owns_lock()) {
+    // the purge is not lost, the next `process` or `skip` carries it out.
+    raiseWatermark(g_pendingPurge, limit);
+    return 0;
+  }
+  int skippedCount = applyPendingPurge();
+  if (g_queueHead.valid()) {
+    g_queueHead = std::move(skipInternal(std::move(g_queueHead), limit, skippedCount));
+  }
+  return skippedCount;
+}
 /**
  * The not-synchronized version of `stop()`. It is used internally to avoid dead locks.
  */
@@ -274,34 +605,481 @@ void stop() noexcept {
 }
 
 // forward declaration.
-FutureAlsaEvents startNextFuture(snd_seq_t *hSequencer);
+FutureAlsaEvents startNextFuture(Input input);
+
+/**
+ * Register that the kernel input pool has overrun.
+ */
+void countKernelOverflow() {
+  g_kernelOverflowCount++;
+  SPDLOG_LOGGER_WARN(g_logger, "ALSA input pool overrun - events lost ({} times so far).",
+                     g_kernelOverflowCount.load());
+}
+
+/**
+ * Copy the data of a variable-length event into storage owned by the queue and let
+ * the event point to the copy.
+ * @param event - a variable-length event, its `data.ext.ptr` is redirected to the copy.
+ * @param data - the data of the event.
+ * @param extData - the storage for the copy.
+ */
+inline void keepExtData(snd_seq_event_t &event, const unsigned char *data, ExtDataList &extData) {
+  auto &copy = extData.emplace_front(data, data + event.data.ext.len);
+  event.data.ext.ptr = copy.data();
+}
 
 /**
  * Retrieve all events currently in the sequencers FIFO-queue.
  * @param hSequencer - a handle for the ALSA sequencer.
+ * @param extData - receives the data of variable-length events.
  * @return the list of sequencer events that were retrieved.
  */
-EventList retrieveEvents(snd_seq_t *hSequencer) {
+EventList retrieveEvents(snd_seq_t *hSequencer, ExtDataList &extData) {
   SPDLOG_LOGGER_TRACE(g_logger, "receiverQueue::retrieveEvents");
   snd_seq_event_t *eventPtr;
   EventList eventList{};
+  auto tail = eventList.before_begin();
   int sequencerStatus;
 
   do {
+    eventPtr = nullptr;
     sequencerStatus = snd_seq_event_input(hSequencer, &eventPtr);
     switch (sequencerStatus) {
     case -EAGAIN: // sequencers FIFO is empty, return eventList.
       break;
+    case -ENOSPC: // the kernel input pool has overrun, some events are lost.
+      // The kernel has already flushed its FIFO. We keep what we have got so far and
+      // let the next poll pick up the events that arrive from now on.
+      countKernelOverflow();
+      break;
     default: //
       checkAlsa("snd_seq_event_input", sequencerStatus);
     }
     if (eventPtr) {
-      eventList.push_front(*eventPtr);
+      // keep the events in the order of their arrival.
+      tail = eventList.insert_after(tail, *eventPtr);
+      if (snd_seq_ev_is_variable(eventPtr)) {
+        // the data lives in the input buffer of alsa-lib, which is reused on the next call.
+        keepExtData(*tail, static_cast<const unsigned char *>(eventPtr->data.ext.ptr), extData);
+      }
+    }
+  } while (sequencerStatus > 0);
+
+  return eventList;
+}
+
+/**
+ * Parse the records that the kernel has delivered through a raw read.
+ *
+ * Each record is an `snd_seq_event_t`. Variable-length events are followed by their data,
+ * padded to a multiple of `sizeof(snd_seq_event_t)`.
+ * @param buffer - the data read from the sequencer.
+ * @param length - the number of bytes in `buffer`.
+ * @param tail - the last element of the list of events, new events are appended behind it.
+ * @param eventList - the list that receives the events.
+ * @param extData - receives the data of variable-length events.
+ * @return the new last element of `eventList`.
+ */
+EventList::iterator parseRawEvents(const unsigned char *buffer, size_t length,
+                                   EventList::iterator tail, EventList &eventList,
+                                   ExtDataList &extData) {
+  constexpr size_t cellSize = sizeof(snd_seq_event_t);
+  size_t offset = 0;
+  while (offset + cellSize <= length) {
+    tail = eventList.insert_after(tail, snd_seq_event_t{});
+    std::memcpy(&*tail, buffer + offset, cellSize);
+    offset += cellSize;
+    if (snd_seq_ev_is_variable(&*tail)) {
+      size_t dataCells = (tail->data.ext.len + cellSize - 1) / cellSize;
+      if (offset + dataCells * cellSize > length) {
+        // cannot happen, the kernel only delivers complete events.
+        SPDLOG_LOGGER_ERROR(g_logger, "receiverQueue - truncated variable-length event.");
+        tail->data.ext.len = 0;
+        tail->data.ext.ptr = nullptr;
+        break;
+      }
+      keepExtData(*tail, buffer + offset, extData);
+      offset += dataCells * cellSize;
+    }
+  }
+  return tail;
+}
+
+/**
+ * Retrieve all events currently in the sequencers FIFO-queue by reading
+ * the file descriptor of the sequencer in large chunks.
+ *
+ * This bypasses the (per event) bookkeeping of alsa-lib.
+ * @param fd - the file descriptor of the sequencer (opened in non-blocking mode).
+ * @param extData - receives the data of variable-length events.
+ * @return the list of sequencer events that were retrieved.
+ */
+EventList retrieveEventsRaw(int fd, ExtDataList &extData) {
+  SPDLOG_LOGGER_TRACE(g_logger, "receiverQueue::retrieveEventsRaw");
+  EventList eventList{};
+  auto tail = eventList.before_begin();
+
+  while (true) {
+    ssize_t bytesRead = read(fd, g_rawBuffer, RAW_BUFFER_SIZE);
+    if (bytesRead > 0) {
+      tail = parseRawEvents(g_rawBuffer, static_cast<size_t>(bytesRead), tail, eventList, extData);
+      continue;
+    }
+    if (bytesRead < 0 && errno == EINTR) {
+      continue;
+    }
+    if (bytesRead < 0 && errno == ENOSPC) {
+      countKernelOverflow();
+      break;
+    }
+    if (bytesRead < 0 && errno != EAGAIN) {
+      checkAlsa("read sequencer", -errno);
+    }
+    break; // the FIFO is empty.
+  }
+  return eventList;
+}
+
+/**
+ * Turn one MIDI message, read from a rawmidi input, into a `RAW_MIDI_EVENT`.
+ * @param bytes - the complete MIDI message.
+ * @param size - the number of bytes in the message.
+ * @param event - receives the message.
+ * @param extData - receives the bytes of messages that do not fit into the event.
+ */
+void toRawMidiEvent(const unsigned char *bytes, size_t size, snd_seq_event_t &event,
+                    ExtDataList &extData) {
+  event.type = RAW_MIDI_EVENT;
+  if (size <= RAW_MIDI_INLINE_SIZE) {
+    snd_seq_ev_set_fixed(&event);
+    std::memcpy(event.data.raw8.d, bytes, size);
+    event.data.raw8.d[RAW_MIDI_INLINE_SIZE] = static_cast<unsigned char>(size);
+    return;
+  }
+  snd_seq_ev_set_variable(&event, size, nullptr);
+  keepExtData(event, bytes, extData);
+}
+
+/**
+ * Retrieve all bytes currently available on a rawmidi input and split them into messages.
+ *
+ * A message that is not yet complete is kept by the parser until the next call.
+ * @param hRawMidi - a handle for the rawmidi input (opened in non-blocking mode).
+ * @param extData - receives the bytes of long messages.
+ * @return the list of messages, as `RAW_MIDI_EVENT`s.
+ */
+EventList retrieveRawMidi(snd_rawmidi_t *hRawMidi, ExtDataList &extData) {
+  SPDLOG_LOGGER_TRACE(g_logger, "receiverQueue::retrieveRawMidi");
+  EventList eventList{};
+  auto tail = eventList.before_begin();
+  auto onMessage = [&](const unsigned char *bytes, size_t size) {
+    tail = eventList.insert_after(tail, snd_seq_event_t{});
+    toRawMidiEvent(bytes, size, *tail, extData);
+  };
+
+  while (true) {
+    ssize_t bytesRead = snd_rawmidi_read(hRawMidi, g_rawBuffer, RAW_BUFFER_SIZE);
+    if (bytesRead > 0) {
+      g_streamParser.parse(g_rawBuffer, static_cast<size_t>(bytesRead), onMessage);
+      continue;
+    }
+    if (bytesRead == -EINTR) {
+      continue;
+    }
+    if (bytesRead < 0 && bytesRead != -EAGAIN) {
+      checkAlsa("snd_rawmidi_read", static_cast<int>(bytesRead));
+    }
+    break; // no more bytes available.
+  }
+  return eventList;
+}
+
+#if A2JMIDI_HAS_UMP
+/**
+ * Append one Universal MIDI Packet to a list of events.
+ *
+ * Packets that have a MIDI 1.0 translation are stored as they are, 7-bit SysEx packets
+ * are collected into rawmidi SysEx events, all other packets are dropped.
+ * @param umpEvent - the event read from the sequencer.
+ * @param tail - the last element of `eventList`, new events are appended behind it.
+ * @param eventList - the list that receives the events.
+ * @param extData - receives the bytes of SysEx messages.
+ * @return the new last element of `eventList`.
+ */
+EventList::iterator appendUmpEvent(const snd_seq_ump_event_t &umpEvent, EventList::iterator tail,
+                                   EventList &eventList, ExtDataList &extData) {
+  const uint32_t *words = umpEvent.ump;
+  auto appendEvent = [&]() {
+    tail = eventList.insert_after(tail, snd_seq_event_t{});
+    // keep the header (source, destination...) the data are filled in below.
+    std::memcpy(&*tail, &umpEvent, offsetof(snd_seq_event_t, data));
+    tail->flags &= ~SND_SEQ_EVENT_UMP;
+  };
+  switch (midi::ump::messageType(words[0])) {
+  case midi::ump::TYPE_SYSTEM:
+  case midi::ump::TYPE_MIDI1_VOICE:
+  case midi::ump::TYPE_MIDI2_VOICE:
+    appendEvent();
+    tail->type = UMP_EVENT;
+    snd_seq_ev_set_fixed(&*tail);
+    tail->data.raw32.d[0] = words[0];
+    tail->data.raw32.d[1] = words[1];
+    break;
+  case midi::ump::TYPE_SYSEX7:
+    g_sysex7Assembler.add(words, [&](const unsigned char *bytes, size_t size) {
+      appendEvent();
+      toRawMidiEvent(bytes, size, *tail, extData);
+    });
+    break;
+  default:
+    break; // no MIDI 1.0 equivalent (utility, flex data, SysEx8, stream...).
+  }
+  return tail;
+}
+
+/**
+ * Retrieve all events currently in the sequencers FIFO-queue of a client in UMP mode.
+ * @param hSequencer - a handle for the ALSA sequencer (in UMP mode).
+ * @param extData - receives the data of variable-length events.
+ * @return the list of events that were retrieved.
+ */
+EventList retrieveUmpEvents(snd_seq_t *hSequencer, ExtDataList &extData) {
+  SPDLOG_LOGGER_TRACE(g_logger, "receiverQueue::retrieveUmpEvents");
+  snd_seq_ump_event_t *eventPtr;
+  EventList eventList{};
+  auto tail = eventList.before_begin();
+  int sequencerStatus;
+
+  do {
+    eventPtr = nullptr;
+    sequencerStatus = snd_seq_ump_event_input(hSequencer, &eventPtr);
+    switch (sequencerStatus) {
+    case -EAGAIN: // sequencers FIFO is empty, return eventList.
+      break;
+    case -ENOSPC: // the kernel input pool has overrun, some events are lost.
+      countKernelOverflow();
+      break;
+    default: //
+      checkAlsa("snd_seq_ump_event_input", sequencerStatus);
+    }
+    if (!eventPtr) {
+      continue;
+    }
+    if (snd_seq_ev_is_ump(eventPtr)) {
+      tail = appendUmpEvent(*eventPtr, tail, eventList, extData);
+      continue;
+    }
+    // a legacy event (for example an announcement), its layout is that of `snd_seq_event_t`.
+    tail = eventList.insert_after(tail, snd_seq_event_t{});
+    std::memcpy(&*tail, eventPtr, sizeof(snd_seq_event_t));
+    if (snd_seq_ev_is_variable(&*tail)) {
+      keepExtData(*tail, static_cast<const unsigned char *>(eventPtr->data.ext.ptr), extData);
     }
   } while (sequencerStatus > 0);
 
   return eventList;
 }
+#endif
+
+/**
+ * Wait until the input has something to deliver.
+ * @param input - the device to listen to.
+ * @param fds - the poll descriptors of the input.
+ * @param fdsCount - the number of poll descriptors.
+ * @return true if data is available, false if the wait has timed out.
+ */
+bool waitForInput(const Input &input, struct pollfd *fds, int fdsCount) {
+  if (input.rawMidi) {
+    auto err = snd_rawmidi_poll_descriptors(input.rawMidi, fds, fdsCount);
+    checkAlsa("snd_rawmidi_poll_descriptors", err);
+    if (err < 0) {
+      return false;
+    }
+  } else {
+    auto err = snd_seq_poll_descriptors(input.sequencer, fds, fdsCount, POLLIN);
+    checkAlsa("snd_seq_poll_descriptors", err);
+    if (err < 0) {
+      return false;
+    }
+  }
+  return poll(fds, fdsCount, SHUTDOWN_POLL_PERIOD_MS) > 0;
+}
+
+/**
+ * Indicates whether a batch with the given number of events can be added to the queue
+ * without exceeding the limits.
+ * @param eventCount - the number of events to be added.
+ * @param byteCount - the memory needed by the batch (see `AlsaEventBatch::bytesFor`).
+ * @return true if the events fit into the queue.
+ */
+inline bool fitsIntoQueue(int eventCount, long byteCount) {
+  return (g_currentEventCount + eventCount <= g_maxEvents) &&
+         (g_currentByteCount + byteCount <= g_maxBytes);
+}
+
+/**
+ * Remove the oldest batches from the queue until the given number of events fits into the queue.
+ *
+ * This function never blocks. If the queue is currently being processed (or stopped)
+ * nothing is removed.
+ * @param eventCount - the number of events that shall be added.
+ * @param byteCount - the memory needed by these events.
+ */
+void dropOldestBatches(int eventCount, long byteCount) {
+  std::unique_lock<std::mutex> lock{g_queueAccessMutex, std::try_to_lock};
+  if (!lock.owns_lock()) {
+    return;
+  }
+  while (!fitsIntoQueue(eventCount, byteCount) && isReady(g_queueHead)) {
+    try {
+      AlsaEventPtr oldest = g_queueHead.get();
+      g_droppedEventCount += oldest->getEventCount();
+      g_queueHead = std::move(oldest->grabNext());
+    } catch (const InterruptedException &) {
+      break;
+    } catch (const std::exception &failure) {
+      markFailed(failure);
+      break;
+    }
+  }
+}
+
+/**
+ * The type of an event, with its channel and its controller number packed into one key.
+ * @param event - a controller-like event.
+ * @return a key that is identical for events that overwrite each other.
+ */
+inline uint32_t controllerKey(const snd_seq_event_t &event) {
+  if (event.type == SND_SEQ_EVENT_KEYPRESS) {
+    return (uint32_t{event.type} << 24U) | (uint32_t{event.data.note.channel} << 16U) |
+           event.data.note.note;
+  }
+  return (uint32_t{event.type} << 24U) | (uint32_t{event.data.control.channel} << 16U) |
+         (event.data.control.param & 0xFFFFU);
+}
+
+/**
+ * Indicates whether the given event carries a continuous value that is overwritten by
+ * subsequent events of the same kind.
+ */
+inline bool isCoalescable(const snd_seq_event_t &event) {
+  switch (event.type) {
+  case SND_SEQ_EVENT_CONTROLLER:
+  case SND_SEQ_EVENT_CONTROL14:
+  case SND_SEQ_EVENT_PITCHBEND:
+  case SND_SEQ_EVENT_CHANPRESS:
+  case SND_SEQ_EVENT_KEYPRESS:
+    return true;
+  default:
+    return false;
+  }
+}
+
+/**
+ * Within the given list, keep only the latest value of each controller.
+ * @param events - a list of events in the order of their arrival.
+ * @return the number of events that have been removed.
+ */
+int coalesceControllers(EventList &events) {
+  // first pass: find the position of the latest event for each controller.
+  std::unordered_map<uint32_t, int> latest;
+  int index = 0;
+  for (const auto &event : events) {
+    if (isCoalescable(event)) {
+      latest[controllerKey(event)] = index;
+    }
+    index++;
+  }
+  // second pass: remove all events that are superseded by a later one.
+  int removed = 0;
+  index = 0;
+  auto previous = events.before_begin();
+  for (auto current = events.begin(); current != events.end(); index++) {
+    if (isCoalescable(*current) && latest[controllerKey(*current)] != index) {
+      current = events.erase_after(previous);
+      removed++;
+    } else {
+      previous = current++;
+    }
+  }
+  return removed;
+}
+
+/**
+ * Release the copies of variable-length data that no event in the list refers to any more.
+ * @param events - the events that are kept.
+ * @param extData - the copies made for these (and possibly other) events.
+ */
+void releaseExtData(const EventList &events, ExtDataList &extData) {
+  std::unordered_set<const void *> referenced;
+  for (const auto &event : events) {
+    if (snd_seq_ev_is_variable(&event)) {
+      referenced.insert(event.data.ext.ptr);
+    }
+  }
+  extData.remove_if([&referenced](const std::vector<unsigned char> &copy) {
+    return referenced.count(copy.data()) == 0;
+  });
+}
+
+/**
+ * Make sure that the queue, including the given new events, stays below its ceiling.
+ *
+ * Depending on the overflow policy, old batches are removed or the controllers
+ * in the new events are coalesced. If the new events still do not fit, the newest
+ * events are discarded. The data of SysEx messages counts towards the byte ceiling.
+ * @param events - the newly received events. The list might be shortened.
+ * @param extData - the data of the variable-length events; the data of discarded events
+ * is released.
+ * @return the number of events remaining in `events`.
+ */
+int enforceLimits(EventList &events, ExtDataList &extData) {
+  int eventCount = static_cast<int>(std::distance(events.begin(), events.end()));
+  long byteCount = AlsaEventBatch::bytesFor(events);
+  if (fitsIntoQueue(eventCount, byteCount)) {
+    g_overflowing = false;
+    return eventCount;
+  }
+
+  switch (g_policy.load()) {
+  case OverflowPolicy::dropOldest:
+    dropOldestBatches(eventCount, byteCount);
+    break;
+  case OverflowPolicy::coalesceControllers: {
+    int removed = coalesceControllers(events);
+    g_coalescedEventCount += removed;
+    eventCount -= removed;
+    break;
+  }
+  case OverflowPolicy::dropNewest:
+    break;
+  }
+
+  // whatever the policy, events that still do not fit are discarded.
+  long roomEvents = g_maxEvents - g_currentEventCount;
+  long roomBytes = g_maxBytes - g_currentByteCount - AlsaEventBatch::BATCH_BYTES;
+  int room = 0;
+  auto lastKept = events.before_begin();
+  for (auto next = events.begin(); next != events.end() && room < roomEvents; ++next) {
+    long bytes = AlsaEventBatch::bytesFor(*next);
+    if (bytes > roomBytes) {
+      break;
+    }
+    roomBytes -= bytes;
+    lastKept = next;
+    room++;
+  }
+  if (eventCount > room) {
+    if (!g_overflowing.exchange(true)) {
+      SPDLOG_LOGGER_WARN(g_logger, "receiverQueue - queue full, incoming events are dropped.");
+    }
+    events.erase_after(lastKept, events.end());
+    releaseExtData(events, extData);
+    g_droppedEventCount += eventCount - room;
+    eventCount = room;
+  }
+  return eventCount;
+}
 
 /**
  * This is the main listening loop which listens for a batch of incoming events.
@@ -312,32 +1090,50 @@ EventList retrieveEvents(snd_seq_t *hSequencer) {
  * If, while waiting, the `carryOnFlag` turns `false`, the current thread will end on
  * a `InterruptedException` and no follow-on thread will be launched.
  *
- * @param hSequencer - a handle for the ALSA sequencer.
+ * @param input - the device to listen to.
  * @return a smart pointer to an AlsaEventBatch object which holds the received events and
  * the newly created future.
  */
-AlsaEventPtr listenForEvents(snd_seq_t *hSequencer) {
+AlsaEventPtr listenForEventsInternal(Input input) {
   SPDLOG_LOGGER_TRACE(g_logger, "receiverQueue::listenForEvents");
 
   // poll descriptors for the poll function below.
-  int fdsCount = snd_seq_poll_descriptors_count(hSequencer, POLLIN);
-  checkAlsa("snd_seq_poll_descriptors_count", fdsCount);
+  int fdsCount = input.rawMidi ? snd_rawmidi_poll_descriptors_count(input.rawMidi)
+                               : snd_seq_poll_descriptors_count(input.sequencer, POLLIN);
+  if (fdsCount <= 0) {
+    throw ListenerFailure("poll_descriptors_count");
+  }
   struct pollfd fds[fdsCount];
+  const bool rawRead = (g_ingestionMode == IngestionMode::rawRead);
+#if A2JMIDI_HAS_UMP
+  const bool ump = g_umpInput && !input.rawMidi;
+#endif
 
   while (g_carryOnFlag) {
-    auto err = snd_seq_poll_descriptors(hSequencer, fds, fdsCount, POLLIN);
-    checkAlsa("snd_seq_poll_descriptors", err);
-
-    // wait until one or several incoming ALSA-sequencer-events are registered.
-    auto hasEvents = poll(fds, fdsCount, SHUTDOWN_POLL_PERIOD_MS);
-    if ((hasEvents > 0) && g_carryOnFlag) {
-      auto events = retrieveEvents(hSequencer);
-      if (!events.empty()) {
-        // recursively call `startNextFuture()` to listen for the next ALSA sequencer event.
-        FutureAlsaEvents nextFuture = startNextFuture(hSequencer);
+    // wait until one or several incoming events are registered.
+    bool hasEvents = waitForInput(input, fds, fdsCount);
+    if (hasEvents && g_carryOnFlag) {
+      ExtDataList extData;
+#if A2JMIDI_HAS_UMP
+      auto events = input.rawMidi ? retrieveRawMidi(input.rawMidi, extData)
+                    : ump         ? retrieveUmpEvents(input.sequencer, extData)
+                    : rawRead     ? retrieveEventsRaw(fds[0].fd, extData)
+                                  : retrieveEvents(input.sequencer, extData);
+#else
+      auto events = input.rawMidi ? retrieveRawMidi(input.rawMidi, extData)
+                    : rawRead     ? retrieveEventsRaw(fds[0].fd, extData)
+                                  : retrieveEvents(input.sequencer, extData);
+#endif
+      auto timeStamp = g_clock->now();
+      int eventCount = enforceLimits(events, extData);
+      g_consecutiveErrors = 0;
+      if (eventCount > 0) {
+        // recursively call `startNextFuture()` to listen for the next incoming events.
+        FutureAlsaEvents nextFuture = startNextFuture(input);
 
         // pack the the events data and the next future into an `AlsaEventBatch`- object.
-        auto *pAlsaEvent = new AlsaEventBatch(std::move(nextFuture), events, g_clock->now());
+        auto *pAlsaEvent = new AlsaEventBatch(std::move(nextFuture), std::move(events),
+                                              std::move(extData), eventCount, timeStamp);
         // delegate the ownership of the `AlsaEventBatch`-object to the caller by using a smart
         // pointer
         // ... and return (ending the current thread).
@@ -348,15 +1144,33 @@ AlsaEventPtr listenForEvents(snd_seq_t *hSequencer) {
   // Here `carryOnFlag` is false -> we end this thread on the appropriate exception.
   throw InterruptedException();
 }
+
 /**
- * Launch a new thread that will be listening for the next ALSA sequencer event.
- * @param hSequencer - a handle for the ALSA sequencer.
+ * Supervises `listenForEventsInternal`: when the listener cannot carry on, the failure
+ * is registered (to be picked up by `hasFailed`) and the thread ends like a stopped
+ * listener does, so that the consumers never see an error.
+ * @param input - the device to listen to.
+ * @return see `listenForEventsInternal`.
+ */
+AlsaEventPtr listenForEvents(Input input) {
+  try {
+    return listenForEventsInternal(input);
+  } catch (const InterruptedException &) {
+    throw;
+  } catch (const std::exception &failure) {
+    markFailed(failure);
+    throw InterruptedException();
+  }
+}
+/**
+ * Launch a new thread that will be listening for the next incoming events.
+ * @param input - the device to listen to.
  * @return an object of type `FutureAlsaEvents` that holds the future result.
  */
-FutureAlsaEvents startNextFuture(snd_seq_t *hSequencer) {
+FutureAlsaEvents startNextFuture(Input input) {
   SPDLOG_LOGGER_TRACE(g_logger, "receiverQueue::startNextFuture");
   return std::async(std::launch::async,
-                    [hSequencer]() -> AlsaEventPtr { return listenForEvents(hSequencer); });
+                    [input]() -> AlsaEventPtr { return listenForEvents(input); });
 }
 
 /**
@@ -364,11 +1178,11 @@ FutureAlsaEvents startNextFuture(snd_seq_t *hSequencer) {
  *
  * A new FutureAlsaEvents is created.
  * The newly created future will be listening to
- * new ALSA sequencer events.
- * @param hSequencer handle to the ALSA sequencer.
+ * new incoming events.
+ * @param input the device to listen to.
  * @return the newly created future.
  */
-FutureAlsaEvents startInternal(snd_seq_t *hSequencer) {
+FutureAlsaEvents startInternal(Input input) {
   SPDLOG_LOGGER_TRACE(g_logger, "receiverQueue::startInternal");
   if (g_stateFlag == State::running) {
     stopInternal();
@@ -376,8 +1190,42 @@ FutureAlsaEvents startInternal(snd_seq_t *hSequencer) {
     throw std::runtime_error("Cannot start the receiverQueue, it is already running.");
   }
   g_carryOnFlag = true;
+  g_pendingPurge = NO_PENDING_PURGE;
+  g_listenerFailed = false;
+  g_consecutiveErrors = 0;
   g_stateFlag = State::running;
-  return startNextFuture(hSequencer);
+  return startNextFuture(input);
+}
+
+/**
+ * Stop the current (failed) listener and start a new one, keeping the clock.
+ * @param input the device to listen to.
+ */
+void restartInternal(Input input) {
+  std::unique_lock<std::mutex> lock{g_queueAccessMutex};
+  SPDLOG_LOGGER_TRACE(g_logger, "receiverQueue::restart");
+  a2jmidi::ClockPtr clock = std::move(g_clock);
+  stopInternal();
+  g_clock = std::move(clock);
+  if (input.rawMidi) {
+    g_streamParser.reset();
+  }
+  g_sysex7Assembler.reset();
+  g_queueHead = std::move(startInternal(input));
+}
+
+bool hasFailed() noexcept { return g_listenerFailed; }
+
+void restart(snd_seq_t *hSequencer) noexcept(false) {
+  Input input;
+  input.sequencer = hSequencer;
+  restartInternal(input);
+}
+
+void restart(snd_rawmidi_t *hRawMidi) noexcept(false) {
+  Input input;
+  input.rawMidi = hRawMidi;
+  restartInternal(input);
 }
 
 /**
@@ -387,7 +1235,23 @@ FutureAlsaEvents startInternal(snd_seq_t *hSequencer) {
 void start(snd_seq_t *hSequencer, a2jmidi::ClockPtr clock) noexcept(false) {
   std::unique_lock<std::mutex> lock{g_queueAccessMutex};
   g_clock = std::move(clock);
-  g_queueHead = std::move(startInternal(hSequencer));
+  g_sysex7Assembler.reset();
+  Input input;
+  input.sequencer = hSequencer;
+  g_queueHead = std::move(startInternal(input));
+}
+
+/**
+ * Start listening for incoming MIDI bytes on an ALSA rawmidi input.
+ * @param hRawMidi handle to a rawmidi input, opened in non-blocking mode.
+ */
+void start(snd_rawmidi_t *hRawMidi, a2jmidi::ClockPtr clock) noexcept(false) {
+  std::unique_lock<std::mutex> lock{g_queueAccessMutex};
+  g_clock = std::move(clock);
+  g_streamParser.reset();
+  Input input;
+  input.rawMidi = hRawMidi;
+  g_queueHead = std::move(startInternal(input));
 }
 
 /**
@@ -24,6 +24,7 @@
 
 #include <alsa/asoundlib.h>
 #include <chrono>
+#include <cstdint>
 #include <functional>
 #include <future>
 #include <stdexcept>
@@ -49,12 +50,202 @@ public:
   InterruptedException() : std::future_error(std::future_errc::broken_promise){};
 };
 
+/**
+ * What the `receiverQueue` shall do with incoming events when its ceiling has been reached.
+ */
+enum class OverflowPolicy : int {
+  dropOldest,          ///< discard the oldest (not yet processed) events to make room.
+  dropNewest,          ///< discard the incoming events that do not fit.
+  coalesceControllers, ///< keep only the latest value of each controller, then drop newest.
+};
+
+/**
+ * The default maximum number of events that can be stored in the queue.
+ */
+constexpr int DEFAULT_MAX_EVENTS{32768};
+/**
+ * The default maximum number of bytes that the queued events may occupy.
+ */
+constexpr long DEFAULT_MAX_BYTES{4L * 1024L * 1024L};
+
+/**
+ * The ceiling for the memory consumed by the `receiverQueue`.
+ *
+ * When the consumer stops draining the queue (for example while the JACK server is frozen),
+ * the queue will not grow beyond these limits.
+ */
+struct Limits {
+  int maxEvents{DEFAULT_MAX_EVENTS};                 ///< maximum number of queued events.
+  long maxBytes{DEFAULT_MAX_BYTES};                  ///< maximum memory used by queued events.
+  OverflowPolicy policy{OverflowPolicy::dropOldest}; ///< what to do when a limit is hit.
+};
+
+/**
+ * How the `receiverQueue` reads incoming events from the ALSA sequencer.
+ */
+enum class IngestionMode : int {
+  library, ///< one event at a time through `snd_seq_event_input()`.
+  rawRead, ///< large chunks read directly from the file descriptor of the sequencer.
+};
+
+/**
+ * The sequencer event type that carries a MIDI message read from a rawmidi input.
+ *
+ * Such events are never sent to the sequencer, they only live in the `receiverQueue`.
+ * Messages of up to `RAW_MIDI_INLINE_SIZE` bytes are stored in `data.raw8.d`, followed by
+ * their length. Longer messages (SysEx) are stored as variable-length events.
+ */
+constexpr snd_seq_event_type_t RAW_MIDI_EVENT{SND_SEQ_EVENT_USR0};
+/**
+ * The largest MIDI message that is stored inside a `RAW_MIDI_EVENT`.
+ */
+constexpr size_t RAW_MIDI_INLINE_SIZE{11};
+
+/**
+ * Indicates whether the given event holds a MIDI message read from a rawmidi input.
+ */
+inline bool isRawMidi(const snd_seq_event_t &event) { return event.type == RAW_MIDI_EVENT; }
+/**
+ * The number of MIDI bytes held by a `RAW_MIDI_EVENT`.
+ */
+inline size_t rawMidiSize(const snd_seq_event_t &event) {
+  return snd_seq_ev_is_variable(&event) ? event.data.ext.len
+                                        : event.data.raw8.d[RAW_MIDI_INLINE_SIZE];
+}
+/**
+ * The MIDI bytes held by a `RAW_MIDI_EVENT`.
+ */
+inline const unsigned char *rawMidiBytes(const snd_seq_event_t &event) {
+  return snd_seq_ev_is_variable(&event) ? static_cast<const unsigned char *>(event.data.ext.ptr)
+                                        : event.data.raw8.d;
+}
+
+/**
+ * alsa-lib supports sequencer clients in UMP (MIDI 2.0) mode from version 1.2.10 on.
+ */
+#define A2JMIDI_HAS_UMP (SND_LIB_VERSION >= 0x01020a)
+
+/**
+ * The sequencer event type that carries a Universal MIDI Packet read from a sequencer
+ * client in UMP mode (see `setUmpInput`).
+ *
+ * Such events are never sent to the sequencer, they only live in the `receiverQueue`.
+ * The packet (one or two words) is stored as is in `data.raw32.d`; it is translated
+ * into MIDI 1.0 bytes only when it is retrieved.
+ */
+constexpr snd_seq_event_type_t UMP_EVENT{SND_SEQ_EVENT_USR1};
+
+/**
+ * Indicates whether the given event holds a Universal MIDI Packet.
+ */
+inline bool isUmp(const snd_seq_event_t &event) { return event.type == UMP_EVENT; }
+/**
+ * The words of the Universal MIDI Packet held by a `UMP_EVENT`.
+ */
+inline const uint32_t *umpWords(const snd_seq_event_t &event) { return event.data.raw32.d; }
+
+/**
+ * Counters that describe the filling of the `receiverQueue`.
+ */
+struct Statistics {
+  int eventCount{0};           ///< the number of events currently stored in the queue.
+  long byteCount{0};           ///< the memory currently used by the queued events.
+  int highWatermarkEvents{0};  ///< the largest number of events that has been queued so far.
+  long highWatermarkBytes{0};  ///< the largest amount of memory that has been used so far.
+  long droppedEventCount{0};   ///< the number of events discarded because of the limits.
+  long coalescedEventCount{0}; ///< controller values superseded by a later value (not lost).
+  long kernelOverflowCount{0}; ///< how often the kernel input pool has overflowed.
+};
+
+/**
+ * Set the ceiling for the memory consumed by the queue.
+ *
+ * The new limits apply to events received after this call.
+ * @param limits - the maximum number of events and bytes, and the overflow policy.
+ */
+void setLimits(const Limits &limits) noexcept;
+
+/**
+ * The ceiling currently in use.
+ * @return the maximum number of events and bytes, and the overflow policy.
+ */
+Limits getLimits() noexcept;
+
+/**
+ * Choose how incoming events are read from the ALSA sequencer.
+ *
+ * Shall be called while the queue is stopped.
+ * @param mode - the ingestion mode.
+ */
+void setIngestionMode(IngestionMode mode) noexcept;
+
+/**
+ * Tell the queue whether the sequencer client has been switched to UMP mode
+ * (`snd_seq_set_client_midi_version`).
+ *
+ * In UMP mode, events are read with `snd_seq_ump_event_input()` (whatever the ingestion
+ * mode) and stored as `UMP_EVENT`s; 7-bit SysEx packets are collected into complete SysEx
+ * messages, packets without a MIDI 1.0 equivalent are dropped.
+ *
+ * Shall be called while the queue is stopped.
+ * @param enabled - true if the client is in UMP mode.
+ */
+void setUmpInput(bool enabled) noexcept;
+
+/**
+ * Get the current filling and the high-watermarks of the queue.
+ *
+ * The high-watermarks and the drop counter are not reset when the queue is stopped,
+ * thus they cover the whole lifetime of the process (see `resetStatistics`).
+ * @return the current statistics.
+ */
+Statistics getStatistics() noexcept;
+
+/**
+ * Restart the statistics: the high-watermarks are lowered to the current filling, the
+ * drop and overflow counters are set to zero.
+ */
+void resetStatistics() noexcept;
+
 /**
  * Start listening for incoming ALSA events.
  * @param hSequencer handle to the ALSA sequencer.
  */
 void start(snd_seq_t *hSequencer, a2jmidi::ClockPtr clock) noexcept(false);
 
+/**
+ * Start listening for incoming MIDI bytes on an ALSA rawmidi input.
+ *
+ * The byte stream is split into messages, which are queued as `RAW_MIDI_EVENT`s.
+ * The ingestion mode does not apply to rawmidi inputs.
+ * @param hRawMidi handle to a rawmidi input, opened in non-blocking mode.
+ */
+void start(snd_rawmidi_t *hRawMidi, a2jmidi::ClockPtr clock) noexcept(false);
+
+/**
+ * Indicates whether the listener has stopped on an error that it could not handle
+ * (for example a rawmidi device that has been unplugged).
+ *
+ * A failed queue delivers no more events; it can be revived with `restart`.
+ * @return true if the queue has failed.
+ */
+bool hasFailed() noexcept;
+
+/**
+ * Replace a failed listener by a new one.
+ *
+ * The events still queued are discarded; the clock, the limits and the statistics
+ * are kept.
+ * @param hSequencer handle to the ALSA sequencer.
+ */
+void restart(snd_seq_t *hSequencer) noexcept(false);
+
+/**
+ * Replace a failed listener by a new one, listening on a (re-opened) rawmidi input.
+ * @param hRawMidi handle to a rawmidi input, opened in non-blocking mode.
+ */
+void restart(snd_rawmidi_t *hRawMidi) noexcept(false);
+
 /**
  * Force all processes to stop listening for incoming events.
  *
@@ -101,10 +292,41 @@ using ProcessCallback =
  *
  * All processed events will be removed from the queue (and from memory).
  *
+ * This function never blocks. If the queue is busy (being stopped, or trimmed because
+ * of its limits) nothing is processed; the events remain for the next call.
+ *
  * @param deadline - the time limit beyond which events will remain in the queue.
  * @param closure - the function to execute on each Event. It must be of type `processCallback`.
  */
 void process(a2jmidi::TimePoint deadline, const ProcessCallback &closure) noexcept;
 
+/**
+ * Remove, in one go, all events that were received before the given time limit.
+ *
+ * The events are discarded batch by batch without being decoded. This is used
+ * to resynchronize after hibernation, freewheeling or long xruns, when a
+ * huge number of stale events might have accumulated.
+ *
+ * Like `process`, this function never blocks. If the queue is busy, the limit is kept
+ * and the events are removed by the next `process` or `skip` that gets hold of the queue.
+ *
+ * @param limit - events received before this time limit are removed.
+ * @return the number of events that have been removed by this call.
+ */
+int skip(a2jmidi::TimePoint limit) noexcept;
+
+/**
+ * Implementation specific stuff.
+ */
+inline namespace impl {
+/**
+ * Indicates whether an error reported by alsa-lib is worth waiting for (the listener
+ * backs off and carries on) or whether the input must be considered broken.
+ * @param alsaError - a negative error code returned by alsa-lib.
+ * @return true if the error is transient.
+ */
+bool isTransientError(int alsaError) noexcept;
+} // namespace impl
+
 } // namespace alsaClient::receiverQueue
 #endif // A_J_MIDI_SRC_ALSA_RECEIVER_QUEUE_H
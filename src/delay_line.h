@@ -0,0 +1,137 @@
+/*
+ * File: delay_line.h
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef A_J_MIDI_SRC_DELAY_LINE_H
+#define A_J_MIDI_SRC_DELAY_LINE_H
+
+#include "a2jmidi_clock.h"
+#include <array>
+#include <cstddef>
+#include <cstring>
+
+namespace a2jmidi {
+
+/**
+ * Holds short MIDI messages back until they are due, and hands them out in the order
+ * of their due time.
+ *
+ * Used to delay the events of some sources with respect to others. Messages with equal due
+ * times keep the order in which they were held. All memory is part of the object, so
+ * `hold` and `release` never allocate and can be used on the real-time thread.
+ * Not thread safe.
+ *
+ * @tparam Tag - information kept along with each message (must be trivially copyable).
+ * @tparam CAPACITY - the largest number of messages held at a time.
+ * @tparam MAX_SIZE - the largest size (in bytes) of a message.
+ */
+template <typename Tag, size_t CAPACITY, size_t MAX_SIZE> class DelayLine {
+public:
+  /**
+   * A message that is held back.
+   */
+  struct Entry {
+    a2jmidi::TimePoint due;        ///< when the message shall be handed out.
+    Tag tag;                       ///< as given to `hold`.
+    size_t size;                   ///< the number of bytes of the message.
+    unsigned char bytes[MAX_SIZE]; ///< the message.
+  };
+
+private:
+  std::array<Entry, CAPACITY> m_entries; ///< sorted by due time.
+  size_t m_count{0};
+
+public:
+  /**
+   * Hold back a message.
+   * @param due - when the message shall be handed out.
+   * @param tag - information to keep along with the message.
+   * @param size - the number of bytes of the message.
+   * @param write - invoked as `write(unsigned char *buffer)`, shall write `size` bytes.
+   * @return false if the message is too large or the delay line is full (nothing is held).
+   */
+  template <typename Writer>
+  bool hold(a2jmidi::TimePoint due, const Tag &tag, size_t size, Writer &&write) {
+    if (size > MAX_SIZE || m_count == CAPACITY) {
+      return false;
+    }
+    // messages mostly arrive in order, so the search starts from the back.
+    size_t slot = m_count;
+    while (slot > 0 && m_entries[slot - 1].due > due) {
+      m_entries[slot] = m_entries[slot - 1];
+      slot--;
+    }
+    Entry &entry = m_entries[slot];
+    entry.due = due;
+    entry.tag = tag;
+    entry.size = size;
+    write(entry.bytes);
+    m_count++;
+    return true;
+  }
+
+  /**
+   * Hand out, and forget, all messages that are due.
+   * @param deadline - messages due at this time or before are handed out.
+   * @param onEntry - invoked as `onEntry(const Entry &entry)` for each message, in order.
+   */
+  template <typename Handler> void release(a2jmidi::TimePoint deadline, Handler &&onEntry) {
+    size_t released = 0;
+    while (released < m_count && m_entries[released].due <= deadline) {
+      onEntry(m_entries[released]);
+      released++;
+    }
+    drop(released);
+  }
+
+  /**
+   * Forget all messages that are due before the given limit.
+   * @param limit - messages due before this time are dropped.
+   * @return the number of messages dropped.
+   */
+  int dropBefore(a2jmidi::TimePoint limit) {
+    size_t dropped = 0;
+    while (dropped < m_count && m_entries[dropped].due < limit) {
+      dropped++;
+    }
+    drop(dropped);
+    return static_cast<int>(dropped);
+  }
+
+  /**
+   * Forget all messages.
+   */
+  void clear() { m_count = 0; }
+
+  /**
+   * The number of messages held.
+   */
+  size_t size() const { return m_count; }
+
+private:
+  void drop(size_t count) {
+    if (count == 0) {
+      return;
+    }
+    m_count -= count;
+    std::memmove(m_entries.data(), m_entries.data() + count, m_count * sizeof(Entry));
+  }
+};
+
+} // namespace a2jmidi
+
+#endif // A_J_MIDI_SRC_DELAY_LINE_H
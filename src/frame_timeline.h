@@ -0,0 +1,115 @@
+/*
+ * File: frame_timeline.h
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef A_J_MIDI_SRC_FRAME_TIMELINE_H
+#define A_J_MIDI_SRC_FRAME_TIMELINE_H
+
+#include "a2jmidi_clock.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <utility>
+
+namespace jackClient {
+
+/**
+ * The JACK server counts frames in a 32-bit counter (`jack_nframes_t`). This counter wraps
+ * after about 24.8 hours at 48 kHz (12.4 hours at 96 kHz).
+ *
+ * The FrameTimeline extends the 32-bit counter to a 64-bit timeline that does not wrap
+ * (in any practical sense).
+ *
+ * The extension is correct as long as the timeline is consulted at least once per half
+ * wrap period (2^31 frames). This is guaranteed by the process callback, which
+ * reads the timeline on every cycle.
+ *
+ * The FrameTimeline can be used simultaneously from several threads.
+ */
+class FrameTimeline {
+private:
+  /**
+   * The largest extended value seen so far.
+   */
+  std::atomic<a2jmidi::TimePoint> m_reference;
+
+public:
+  /**
+   * Constructor.
+   * @param start - the current value of the 32-bit frame counter.
+   */
+  explicit FrameTimeline(uint32_t start = 0) : m_reference{start} {}
+
+  /**
+   * Restart the timeline.
+   * @param start - the current value of the 32-bit frame counter.
+   */
+  void reset(uint32_t start) noexcept { m_reference = start; }
+
+  /**
+   * Extend a value of the 32-bit frame counter into the 64-bit timeline.
+   * @param frames - a value of the 32-bit frame counter, not further than 2^31 frames
+   * away from the most recently extended value.
+   * @return the corresponding point on the 64-bit timeline.
+   */
+  a2jmidi::TimePoint extend(uint32_t frames) noexcept {
+    a2jmidi::TimePoint reference = m_reference.load(std::memory_order_acquire);
+    // the signed distance from the reference, correct across the wrap point.
+    auto distance = static_cast<int32_t>(frames - static_cast<uint32_t>(reference));
+    a2jmidi::TimePoint result = reference + distance;
+    // let the reference follow the counter (but never go backwards).
+    while (result > reference &&
+           !m_reference.compare_exchange_weak(reference, result, std::memory_order_acq_rel)) {
+    }
+    return result;
+  }
+};
+
+/**
+ * Prototype for a function that reads a 32-bit frame counter.
+ */
+using FrameCounter = std::function<uint32_t()>;
+
+/**
+ * A Clock that extends the values of a 32-bit frame counter into a 64-bit timeline.
+ */
+class FrameTimelineClock : public a2jmidi::Clock {
+private:
+  FrameTimeline &m_timeline;
+  const FrameCounter m_counter;
+
+public:
+  /**
+   * Constructor.
+   * @param timeline - the timeline that extends the counter values (must outlive the clock).
+   * @param counter - the function that reads the 32-bit frame counter.
+   */
+  FrameTimelineClock(FrameTimeline &timeline, FrameCounter counter)
+      : m_timeline{timeline}, m_counter{std::move(counter)} {}
+  /**
+   * Destructor
+   */
+  ~FrameTimelineClock() override = default;
+  /**
+   * The current time on the 64-bit timeline.
+   * @return the current time in frames.
+   */
+  a2jmidi::TimePoint now() override { return m_timeline.extend(m_counter()); }
+};
+
+} // namespace jackClient
+#endif // A_J_MIDI_SRC_FRAME_TIMELINE_H
@@ -17,11 +17,16 @@
  * limitations under the License.
  */
 #include "jack_client.h"
+#include "frame_timeline.h"
 #include "spdlog/sinks/stdout_color_sinks.h"
 #include "spdlog/spdlog.h"
-#include <climits>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
 #include <mutex>
 #include <thread>
+#include <vector>
 namespace jackClient {
 inline namespace impl {
 
@@ -32,9 +37,70 @@ static auto g_logger = spdlog::stdout_color_mt("jack_client");
 
 std::atomic<jack_client_t *> g_jackClientHandle{nullptr};
 /**
- * The 'g_customCallback' is invoked on each cycle.
+ * False when the session has been handed to us through `attach`.
  */
-ProcessCallback g_customCallback{nullptr};
+static bool g_ownsClientHandle{true};
+
+/**
+ * The functions invoked from the process thread.
+ */
+struct Callbacks {
+  ProcessCallback process{nullptr}; ///< invoked on each cycle.
+  ResyncCallback resync{nullptr};   ///< invoked before the first cycle after a discontinuity.
+};
+/**
+ * The callbacks currently in use, read (without lock) by the process thread.
+ */
+static std::atomic<const Callbacks *> g_callbacks{nullptr};
+/**
+ * Owns the object that `g_callbacks` points to.
+ */
+static std::unique_ptr<Callbacks> g_callbacksOwner;
+
+/**
+ * Set by the xrun- and the freewheel-callbacks, reset by the process callback.
+ */
+static std::atomic<bool> g_resyncRequested{false};
+
+/**
+ * The frame time at the start of the previous cycle (only used on the process thread).
+ */
+static a2jmidi::TimePoint g_previousCycleStart{0};
+/**
+ * False until the first cycle has been processed (only used on the process thread).
+ */
+static bool g_hasPreviousCycle{false};
+
+/**
+ * The ports created by `newSenderPort`, whose latency is published to the server.
+ */
+static std::vector<JackPort> g_senderPorts;
+/**
+ * The ports created by `newReceiverPort`, whose latency is published to the server.
+ */
+static std::vector<JackPort> g_receiverPorts;
+/**
+ * Guards `g_senderPorts` and `g_receiverPorts`, which the latency callback reads while
+ * ports may come and go (see `addSenderPort`). Never held during a call into the server.
+ */
+static std::mutex g_portsMutex;
+/**
+ * See `setTimestampError()`.
+ */
+static std::atomic<jack_nframes_t> g_timestampError{0};
+
+/**
+ * The two slots of the double-buffered per-period parameters.
+ */
+static PeriodParameters g_periodParameters[2];
+/**
+ * The index of the slot in `g_periodParameters` that is currently in use.
+ */
+static std::atomic<int> g_activePeriodParameters{0};
+/**
+ * Serializes the (rare) updates of the per-period parameters.
+ */
+static std::mutex g_periodParametersMutex;
 
 /**
  * The `g_onServerAbendHandler` is invoked on if the server ends abnormally.
@@ -47,9 +113,20 @@ OnServerAbendHandler g_onServerAbendHandler{nullptr};
  */
 static std::mutex g_stateAccessMutex;
 
-static State g_stateFlag{State::closed};
+/**
+ * The current state. Changed under `g_stateAccessMutex`, but also read without lock
+ * from the threads of the JACK server.
+ */
+static std::atomic<State> g_stateFlag{State::closed};
 
 inline State stateInternal() { return g_stateFlag; }
+
+/**
+ * Extends the 32-bit frame counter of the JACK server into a 64-bit timeline.
+ * All time points handed out by the `jackClient` are points on this timeline.
+ */
+static FrameTimeline g_frameTimeline;
+
 /**
  * The JackClock is an instance of the general clock.
  * This class gets the time from the JACK sever.
@@ -62,13 +139,13 @@ public:
   ~JackClock() override = default;
   /**
    * The estimated current time in frames.
-   * @return the estimated current time in system specific ticks.
+   * @return the estimated current time on the 64-bit frame timeline.
    */
-  long now() override {
+  a2jmidi::TimePoint now() override {
     if (!g_jackClientHandle) {
-      return LONG_MAX;
+      return std::numeric_limits<a2jmidi::TimePoint>::max();
     }
-    return jack_frame_time(g_jackClientHandle);
+    return g_frameTimeline.extend(jack_frame_time(g_jackClientHandle));
   }
 };
 
@@ -121,6 +198,26 @@ void jackInfoCallback(const char *msg) {
                      msg);
 }
 
+/**
+ * Hand a new set of callbacks over to the process thread.
+ *
+ * The callbacks are only replaced while the client is not activated, so the process
+ * thread cannot be using the previous set; it is released at once.
+ * @param next - the new callbacks (nullptr - none).
+ */
+void publishCallbacks(std::unique_ptr<Callbacks> next) {
+  g_callbacks.store(next.get(), std::memory_order_release);
+  g_callbacksOwner = std::move(next);
+}
+
+/**
+ * A modifiable copy of the callbacks currently in use.
+ */
+std::unique_ptr<Callbacks> copyCallbacks() {
+  return g_callbacksOwner ? std::make_unique<Callbacks>(*g_callbacksOwner)
+                          : std::make_unique<Callbacks>();
+}
+
 void stopInternal() {
   switch (g_stateFlag) {
   case State::closed:
@@ -138,27 +235,78 @@ void stopInternal() {
   }
   }
   g_onServerAbendHandler = nullptr;
-  g_customCallback = nullptr;
+  publishCallbacks(nullptr);
+  g_hasPreviousCycle = false;
   g_stateFlag = State::idle;
 }
 
 
 using namespace std::chrono_literals;
+
+PeriodParameters computePeriodParameters(jack_nframes_t bufferSize, jack_nframes_t sampleRate) {
+  PeriodParameters result;
+  result.bufferSize = bufferSize;
+  result.sampleRate = sampleRate;
+  result.jitterCompensation =
+      std::max<a2jmidi::TimePoint>(1, std::lround(sampleRate * JITTER_COMPENSATION_SECONDS));
+  result.discontinuityLimit = DISCONTINUITY_PERIODS * static_cast<a2jmidi::TimePoint>(bufferSize);
+  return result;
+}
+
+PeriodParameters periodParameters() noexcept {
+  return g_periodParameters[g_activePeriodParameters.load(std::memory_order_acquire)];
+}
+
+/**
+ * Compute new per-period parameters and make them visible to the process callback.
+ *
+ * The new values are written into the inactive slot, then the slots are switched. The
+ * server does not change its configuration twice within one cycle, so the process
+ * callback never reads a slot that is being written.
+ * @param bufferSize - the number of frames per period.
+ * @param sampleRate - the number of frames per second.
+ */
+void publishPeriodParameters(jack_nframes_t bufferSize, jack_nframes_t sampleRate) {
+  std::unique_lock<std::mutex> lock{g_periodParametersMutex};
+  int next = 1 - g_activePeriodParameters.load(std::memory_order_relaxed);
+  g_periodParameters[next] = computePeriodParameters(bufferSize, sampleRate);
+  g_activePeriodParameters.store(next, std::memory_order_release);
+  SPDLOG_LOGGER_TRACE(g_logger, "jackClient - period parameters: {} frames at {} Hz.", bufferSize,
+                      sampleRate);
+}
+
+/**
+ * Called by the JACK server when the buffer size changes.
+ * @param nFrames - the new number of frames per period.
+ * @param arg - (unused) a pointer to an arbitrary, user supplied, data.
+ * @return always zero.
+ */
+int jackBufferSizeCallback(jack_nframes_t nFrames, [[maybe_unused]] void *arg) {
+  publishPeriodParameters(nFrames, periodParameters().sampleRate);
+  return 0;
+}
+
 /**
- * A small amount of time (less than half a millisecond) used
- * to compensate for jitter in the JACK library.
+ * Called by the JACK server when the sample rate changes.
+ * @param nFrames - the new number of frames per second.
+ * @param arg - (unused) a pointer to an arbitrary, user supplied, data.
+ * @return always zero.
  */
-const a2jmidi::TimePoint JITTER_COMPENSATION = 16;
+int jackSampleRateCallback(jack_nframes_t nFrames, [[maybe_unused]] void *arg) {
+  publishPeriodParameters(periodParameters().bufferSize, nFrames);
+  return 0;
+}
 
 /**
  * The time at the start of the current process cycle.
  *
  * This function may only be used from the process callback.
- *
+ * @param parameters - the current per-period parameters.
  * @return the precise time at the start of the current process cycle.
  */
-inline a2jmidi::TimePoint newDeadline() {
-  return jack_last_frame_time(g_jackClientHandle) - JITTER_COMPENSATION;
+inline a2jmidi::TimePoint newDeadline(const PeriodParameters &parameters) {
+  return g_frameTimeline.extend(jack_last_frame_time(g_jackClientHandle)) -
+         parameters.jitterCompensation;
 }
 
 void jackShutdownCallback([[maybe_unused]] void *arg) {
@@ -171,6 +319,79 @@ void jackShutdownCallback([[maybe_unused]] void *arg) {
   }
 }
 
+jack_latency_range_t captureLatencyRange(const PeriodParameters &parameters,
+                                         jack_nframes_t timestampError) {
+  jack_latency_range_t range;
+  range.min = parameters.bufferSize + static_cast<jack_nframes_t>(parameters.jitterCompensation);
+  range.max = range.min + timestampError;
+  return range;
+}
+
+jack_latency_range_t playbackLatencyRange(const PeriodParameters &parameters) {
+  jack_latency_range_t range;
+  range.min = parameters.bufferSize;
+  range.max = parameters.bufferSize;
+  return range;
+}
+
+/**
+ * Called by the JACK server when the latencies of the graph must be recomputed.
+ *
+ * Our sender ports are where the data enters the graph, our receiver ports are where it
+ * leaves, so we publish the capture latency of the former and the playback latency of
+ * the latter.
+ * @param mode - whether the capture or the playback latency shall be updated.
+ * @param arg - (unused) a pointer to an arbitrary, user supplied, data.
+ */
+void jackLatencyCallback(jack_latency_callback_mode_t mode, [[maybe_unused]] void *arg) {
+  std::unique_lock<std::mutex> lock{g_portsMutex};
+  if (mode == JackPlaybackLatency) {
+    jack_latency_range_t range = playbackLatencyRange(periodParameters());
+    for (auto *port : g_receiverPorts) {
+      jack_port_set_latency_range(port, JackPlaybackLatency, &range);
+    }
+    return;
+  }
+  jack_latency_range_t range = captureLatencyRange(periodParameters(), g_timestampError);
+  for (auto *port : g_senderPorts) {
+    jack_port_set_latency_range(port, JackCaptureLatency, &range);
+  }
+}
+
+/**
+ * Called by the JACK server after an xrun.
+ * @param arg - (unused) a pointer to an arbitrary, user supplied, data.
+ * @return always zero.
+ */
+int jackXrunCallback([[maybe_unused]] void *arg) {
+  g_resyncRequested = true;
+  return 0;
+}
+
+/**
+ * Called by the JACK server when it enters or leaves freewheel mode.
+ * @param starting - non-zero when entering freewheel mode, zero when leaving.
+ * @param arg - (unused) a pointer to an arbitrary, user supplied, data.
+ */
+void jackFreewheelCallback([[maybe_unused]] int starting, [[maybe_unused]] void *arg) {
+  g_resyncRequested = true;
+}
+
+/**
+ * Indicates whether the frame time has jumped since the previous cycle.
+ * This function may only be used from the process callback.
+ * @param cycleStart - the frame time at the start of the current cycle.
+ * @param parameters - the current per-period parameters.
+ * @return true if the frame time has advanced by far more than one period.
+ */
+inline bool isDiscontinuity(a2jmidi::TimePoint cycleStart, const PeriodParameters &parameters) {
+  bool result = g_hasPreviousCycle &&
+                (cycleStart - g_previousCycleStart > parameters.discontinuityLimit);
+  g_previousCycleStart = cycleStart;
+  g_hasPreviousCycle = true;
+  return result;
+}
+
 /**
  * This callback will be invoked by the JACK server on each cycle.
  * It delegates to the custom defined callback.
@@ -180,8 +401,19 @@ void jackShutdownCallback([[maybe_unused]] void *arg) {
  * the client__.
  */
 int jackInternalCallback(jack_nframes_t nFrames, [[maybe_unused]] void *arg) {
-  if (g_customCallback) {
-    return g_customCallback(nFrames, newDeadline());
+  const Callbacks *callbacks = g_callbacks.load(std::memory_order_acquire);
+  PeriodParameters parameters = periodParameters();
+  a2jmidi::TimePoint deadline = newDeadline(parameters);
+  bool discontinuity = isDiscontinuity(deadline, parameters);
+  bool resync = g_resyncRequested.exchange(false) || discontinuity;
+  if (!callbacks) {
+    return 0;
+  }
+  if (resync && callbacks->resync) {
+    callbacks->resync(deadline);
+  }
+  if (callbacks->process) {
+    return callbacks->process(nFrames, deadline);
   }
   return 0;
 }
@@ -207,7 +439,7 @@ void close() noexcept {
   }
   stopInternal();
 
-  if (g_jackClientHandle) {
+  if (g_jackClientHandle && g_ownsClientHandle) {
     SPDLOG_LOGGER_TRACE(g_logger, "jackClient::close - closing \"{}\".", clientNameInternal());
     int err = jack_client_close(g_jackClientHandle);
     if (err) {
@@ -216,8 +448,53 @@ void close() noexcept {
   }
 
   g_jackClientHandle = nullptr;
+  g_ownsClientHandle = true;
+  {
+    std::unique_lock<std::mutex> portsLock{g_portsMutex};
+    g_senderPorts.clear();
+    g_receiverPorts.clear();
+  }
   g_stateFlag = State::closed;
 }
+
+/**
+ * Register our callbacks with the session in `g_jackClientHandle` and enter the
+ * `idle` state. Common part of `open` and `attach`.
+ */
+void setUpSession() {
+  g_frameTimeline.reset(jack_frame_time(g_jackClientHandle));
+
+  // Register a function to be called if and when the JACK server shuts down the client thread.
+  jack_on_shutdown(g_jackClientHandle, jackShutdownCallback, nullptr);
+
+  // Register the functions that tell us about discontinuities of the frame time.
+  if (jack_set_xrun_callback(g_jackClientHandle, jackXrunCallback, nullptr)) {
+    SPDLOG_LOGGER_ERROR(g_logger, "jackClient::open - cannot register xrun callback.");
+  }
+  if (jack_set_freewheel_callback(g_jackClientHandle, jackFreewheelCallback, nullptr)) {
+    SPDLOG_LOGGER_ERROR(g_logger, "jackClient::open - cannot register freewheel callback.");
+  }
+  // Precompute the per-period parameters, and keep them up to date.
+  publishPeriodParameters(jack_get_buffer_size(g_jackClientHandle),
+                          jack_get_sample_rate(g_jackClientHandle));
+  if (jack_set_buffer_size_callback(g_jackClientHandle, jackBufferSizeCallback, nullptr)) {
+    SPDLOG_LOGGER_ERROR(g_logger, "jackClient::open - cannot register buffer size callback.");
+  }
+  if (jack_set_sample_rate_callback(g_jackClientHandle, jackSampleRateCallback, nullptr)) {
+    SPDLOG_LOGGER_ERROR(g_logger, "jackClient::open - cannot register sample rate callback.");
+  }
+  // Register the function that publishes the latency of our ports.
+  if (jack_set_latency_callback(g_jackClientHandle, jackLatencyCallback, nullptr)) {
+    SPDLOG_LOGGER_ERROR(g_logger, "jackClient::open - cannot register latency callback.");
+  }
+  {
+    std::unique_lock<std::mutex> portsLock{g_portsMutex};
+    g_senderPorts.clear();
+    g_receiverPorts.clear();
+  }
+  g_resyncRequested = false;
+  g_stateFlag = State::idle;
+}
 /**
  * Open an external client session with the JACK server.
  *
@@ -250,10 +527,21 @@ void open(const std::string &clientName, bool startServer) noexcept(false) {
     SPDLOG_LOGGER_ERROR(g_logger, "Error opening JACK status={}.", status);
     throw ServerNotRunningException();
   }
+  g_ownsClientHandle = true;
+  setUpSession();
+}
 
-  // Register a function to be called if and when the JACK server shuts down the client thread.
-  jack_on_shutdown(g_jackClientHandle, jackShutdownCallback, nullptr);
-  g_stateFlag = State::idle;
+void attach(jack_client_t *client) noexcept(false) {
+  std::unique_lock<std::mutex> lock{g_stateAccessMutex};
+  SPDLOG_LOGGER_TRACE(g_logger, "jackClient::attach");
+
+  if (g_stateFlag != State::closed) {
+    throw BadStateException("Cannot attach JACK client. Wrong state " + stateAsString(g_stateFlag));
+  }
+  // the error and info functions belong to the server process, we leave them alone.
+  g_jackClientHandle = client;
+  g_ownsClientHandle = false;
+  setUpSession();
 }
 /**
  * Tell the Jack server to stop calling the processCallback function.
@@ -319,6 +607,17 @@ void onServerAbend(const OnServerAbendHandler &handler) noexcept(false) {
   }
   g_onServerAbendHandler = handler;
 }
+
+void setTimestampError(jack_nframes_t frames) noexcept {
+  std::unique_lock<std::mutex> lock{g_stateAccessMutex};
+  g_timestampError = frames;
+  if (g_stateFlag == State::closed) {
+    return;
+  }
+  if (jack_recompute_total_latencies(g_jackClientHandle)) {
+    SPDLOG_LOGGER_ERROR(g_logger, "jackClient::setTimestampError - cannot recompute latencies.");
+  }
+}
 /**
  * Create a new Clock that gets its timing from the JACK server.
  * @return a smart pointer holding the clock.
@@ -347,12 +646,33 @@ void registerProcessCallback(const ProcessCallback &processCallback) noexcept(fa
   if (g_stateFlag != State::idle) {
     throw BadStateException("Cannot register callback. Wrong state " + stateAsString(g_stateFlag));
   }
-  g_customCallback = processCallback;
+  auto callbacks = copyCallbacks();
+  callbacks->process = processCallback;
+  publishCallbacks(std::move(callbacks));
   int err = jack_set_process_callback(g_jackClientHandle, jackInternalCallback, nullptr);
   if (err) {
     throw ServerException("JACK error when registering callback.");
   }
 }
+/**
+ * Register a function that shall be called before the first cycle that follows
+ * a discontinuity of the frame time.
+ *
+ * `registerResyncCallback()` can only be called from the `idle` state.
+ *
+ * @param resyncCallback - the function to be called
+ * @throws BadStateException - if this function is called from a state other than `idle`.
+ */
+void registerResyncCallback(const ResyncCallback &resyncCallback) noexcept(false) {
+  std::unique_lock<std::mutex> lock{g_stateAccessMutex};
+  SPDLOG_LOGGER_TRACE(g_logger, "jackClient::registerResyncCallback");
+  if (g_stateFlag != State::idle) {
+    throw BadStateException("Cannot register callback. Wrong state " + stateAsString(g_stateFlag));
+  }
+  auto callbacks = copyCallbacks();
+  callbacks->resync = resyncCallback;
+  publishCallbacks(std::move(callbacks));
+}
 /**
  * Create a new JACK MIDI port. External applications can read from this port.
  *
@@ -378,7 +698,61 @@ JackPort newSenderPort(const std::string &portName) noexcept(false) {
   if (!result) {
     throw std::runtime_error("Failed to create JACK MIDI port!\n");
   }
+  std::unique_lock<std::mutex> portsLock{g_portsMutex};
+  g_senderPorts.push_back(result);
   SPDLOG_LOGGER_TRACE(g_logger, "jackClient::newSenderPort - port \"{}\" created.", portName);
   return result;
 }
+
+JackPort addSenderPort(const std::string &portName) noexcept(false) {
+  std::unique_lock<std::mutex> lock{g_stateAccessMutex};
+  if (g_stateFlag != State::idle && g_stateFlag != State::running) {
+    throw BadStateException("Cannot add SenderPort. Wrong state " + stateAsString(g_stateFlag));
+  }
+  auto *result = jack_port_register(g_jackClientHandle, portName.c_str(), JACK_DEFAULT_MIDI_TYPE,
+                                    JackPortIsOutput, 0);
+  if (!result) {
+    throw ServerException("Failed to create JACK MIDI port.");
+  }
+  std::unique_lock<std::mutex> portsLock{g_portsMutex};
+  g_senderPorts.push_back(result);
+  SPDLOG_LOGGER_TRACE(g_logger, "jackClient::addSenderPort - port \"{}\" created.", portName);
+  return result;
+}
+
+void removeSenderPort(JackPort port) noexcept {
+  std::unique_lock<std::mutex> lock{g_stateAccessMutex};
+  if (g_stateFlag == State::closed) {
+    return; // the ports have gone with the client.
+  }
+  {
+    std::unique_lock<std::mutex> portsLock{g_portsMutex};
+    auto found = std::find(g_senderPorts.begin(), g_senderPorts.end(), port);
+    if (found == g_senderPorts.end()) {
+      return;
+    }
+    g_senderPorts.erase(found);
+  }
+  int err = jack_port_unregister(g_jackClientHandle, port);
+  if (err) {
+    SPDLOG_LOGGER_ERROR(g_logger, "jackClient::removeSenderPort - Error({})", err);
+  }
+}
+
+JackPort newReceiverPort(const std::string &portName) noexcept(false) {
+  std::unique_lock<std::mutex> lock{g_stateAccessMutex};
+  if (g_stateFlag != State::idle) {
+    throw BadStateException("Cannot create new ReceiverPort. Wrong state " +
+                            stateAsString(g_stateFlag));
+  }
+  auto *result = jack_port_register(g_jackClientHandle, portName.c_str(), JACK_DEFAULT_MIDI_TYPE,
+                                    JackPortIsInput, 0);
+  if (!result) {
+    throw ServerException("Failed to create JACK MIDI input port.");
+  }
+  std::unique_lock<std::mutex> portsLock{g_portsMutex};
+  g_receiverPorts.push_back(result);
+  SPDLOG_LOGGER_TRACE(g_logger, "jackClient::newReceiverPort - port \"{}\" created.", portName);
+  return result;
+}
 } // namespace jackClient
\ No newline at end of file
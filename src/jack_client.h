@@ -96,6 +96,18 @@ a2jmidi::ClockPtr clock();
  */
 void open(const std::string &clientName, bool startServer = false) noexcept(false);
 
+/**
+ * Take over a client session that has been opened by somebody else; this is how
+ * an internal client receives its session from the JACK server (see `jack_initialize`).
+ *
+ * When this function succeeds the `jackClient` is in `idle` state. The session is
+ * used exactly like one created by `open`, except that `close` leaves it open.
+ *
+ * @param client - the handle of the open session.
+ * @throws BadStateException - if the `jackClient` is not in `closed` state.
+ */
+void attach(jack_client_t *client) noexcept(false);
+
 /**
  * The name given by the JACK server to this client (aka device).
  *
@@ -127,6 +139,44 @@ using JackPort = jack_port_t *;
  */
 JackPort newSenderPort(const std::string& portName) noexcept(false);
 
+/**
+ * Create a new JACK MIDI output port, in `idle` or in `running` state.
+ *
+ * Unlike `newSenderPort`, this function can be called while the process callback runs
+ * (but never from the process callback itself): the callback shall only use the new
+ * port once this function has returned.
+ *
+ * @param portName  - a desired name for the new port.
+ * @return the output port.
+ * @throws BadStateException - if called from the `closed` state.
+ * @throws ServerException - if the JACK server has encountered a problem (for example,
+ * there is already a port with this name).
+ */
+JackPort addSenderPort(const std::string &portName) noexcept(false);
+
+/**
+ * Remove an output port created by `newSenderPort` or `addSenderPort`.
+ *
+ * The caller must make sure that the process callback no longer uses the port.
+ * Does nothing if the client is closed or the port is unknown.
+ * @param port - the port to remove.
+ */
+void removeSenderPort(JackPort port) noexcept;
+
+/**
+ * Create a new JACK MIDI input port. External applications can write to this port.
+ *
+ * This function can only be called from the `idle` state. The process callback reads the
+ * port through `jack_port_get_buffer`.
+ *
+ * @param portName  - a desired name for the new port.
+ * The server may modify this name to create a unique variant, if needed.
+ * @return the input port.
+ * @throws BadStateException - if port creation is attempted from a state other than `idle`.
+ * @throws ServerException - if the JACK server has encountered a problem.
+ */
+JackPort newReceiverPort(const std::string &portName) noexcept(false);
+
 
 /**
  * Tell the JACK server that the client is ready to process.
@@ -171,6 +221,15 @@ using ProcessCallback = std::function<int(const int nFrames, const a2jmidi::Time
  * server is ending abnormally.
  */
 using OnServerAbendHandler = std::function<void()>;
+/**
+ * Prototype for the client supplied function that is called, on the process thread,
+ * before the first cycle that follows a discontinuity of the frame time.
+ *
+ * Such discontinuities happen after an xrun, when the server leaves freewheel mode or
+ * after the system has been suspended.
+ * @param deadLine - the deadline of the cycle that is about to be processed.
+ */
+using ResyncCallback = std::function<void(const a2jmidi::TimePoint deadLine)>;
 /**
  * Tell the Jack server to call the given processCallback function on each cycle.
  *
@@ -181,6 +240,16 @@ using OnServerAbendHandler = std::function<void()>;
  * @throws ServerException - if the JACK server has encountered an other problem.
  */
 void registerProcessCallback(const ProcessCallback &processCallback) noexcept(false);
+/**
+ * Register a function that shall be called before the first cycle that follows
+ * a discontinuity of the frame time (xrun, freewheel or system suspend).
+ *
+ * `registerResyncCallback()` can only be called from the `idle` state.
+ *
+ * @param resyncCallback - the function to be called
+ * @throws BadStateException - if this function is called from a state other than `idle`.
+ */
+void registerResyncCallback(const ResyncCallback &resyncCallback) noexcept(false);
 /**
  * Register a handler that shall be called when the server is ending abnormally.
  * @param handler - the function to be called
@@ -188,18 +257,95 @@ void registerProcessCallback(const ProcessCallback &processCallback) noexcept(fa
  */
 void onServerAbend(const OnServerAbendHandler &handler) noexcept(false) ;
 
+/**
+ * Declare by how much the time stamps of incoming events may lag behind their actual
+ * arrival (for example as measured with `--probe`).
+ *
+ * The capture latency published for the sender ports is widened by this amount, and the
+ * JACK server is asked to recompute the latencies of the graph.
+ * @param frames - the largest expected time stamp error, in frames.
+ */
+void setTimestampError(jack_nframes_t frames) noexcept;
+
 /**
  * Implementation specific stuff.
  */
 inline namespace impl {
 
+/**
+ * When the frame time advances by more than this number of periods from one cycle
+ * to the next, we have a discontinuity.
+ */
+constexpr int DISCONTINUITY_PERIODS{2};
+
+/**
+ * A small amount of time (a third of a millisecond, 16 frames at 48 kHz) used
+ * to compensate for jitter in the JACK library.
+ */
+constexpr double JITTER_COMPENSATION_SECONDS{1.0 / 3000.0};
+
+/**
+ * The server configuration that the process callback depends on.
+ *
+ * The parameters are computed whenever the buffer size or the sample rate changes, so that
+ * the process callback never has to query the server for its configuration.
+ */
+struct PeriodParameters {
+  jack_nframes_t bufferSize{0};             ///< the number of frames per period.
+  jack_nframes_t sampleRate{0};             ///< the number of frames per second.
+  a2jmidi::TimePoint jitterCompensation{0}; ///< `JITTER_COMPENSATION_SECONDS` in frames.
+  a2jmidi::TimePoint discontinuityLimit{0}; ///< larger advances of the frame time are jumps.
+};
+
+/**
+ * Derive the per-period parameters from the server configuration.
+ * @param bufferSize - the number of frames per period.
+ * @param sampleRate - the number of frames per second.
+ * @return the parameters to be published to the process callback.
+ */
+PeriodParameters computePeriodParameters(jack_nframes_t bufferSize, jack_nframes_t sampleRate);
+
+/**
+ * The parameters currently in use.
+ *
+ * The parameters are double-buffered: a change is prepared in the inactive slot, then the
+ * active slot is switched atomically. Reading them is real-time safe.
+ * @return a copy of the current parameters.
+ */
+PeriodParameters periodParameters() noexcept;
+
+/**
+ * The capture latency of the sender ports.
+ *
+ * An event time-stamped at frame `t` is written at the position of `t + jitterCompensation`
+ * in the buffer of the following cycle, thus it leaves the port one period plus the
+ * jitter compensation after its time stamp. Errors of the time stamp widen the range.
+ * @param parameters - the current per-period parameters.
+ * @param timestampError - the largest expected time stamp error, in frames.
+ * @return the latency range to be published for the sender ports.
+ */
+jack_latency_range_t captureLatencyRange(const PeriodParameters &parameters,
+                                         jack_nframes_t timestampError);
+
+/**
+ * The playback latency of the receiver ports.
+ *
+ * Events leave the bridge one period after the frame at which they were read (the sender
+ * thread forwards them once per period, scheduled to keep their spacing).
+ * @param parameters - the current per-period parameters.
+ * @return the latency range to be published for the receiver ports.
+ */
+jack_latency_range_t playbackLatencyRange(const PeriodParameters &parameters);
+
 /** handle to the JACK server **/
 extern std::atomic<jack_client_t *> g_jackClientHandle;
 /**
  * The current sample rate in samples per second.
+ *
+ * The value is cached, this function does not call into the server.
  * @return the current sample rate in samples per second.
  */
-inline int sampleRate() { return jack_get_sample_rate(g_jackClientHandle); }
+inline int sampleRate() { return static_cast<int>(periodParameters().sampleRate); }
 } // namespace impl
 } // namespace jackClient
 
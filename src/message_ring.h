@@ -0,0 +1,157 @@
+/*
+ * File: message_ring.h
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef A_J_MIDI_SRC_MESSAGE_RING_H
+#define A_J_MIDI_SRC_MESSAGE_RING_H
+
+#include "a2jmidi_clock.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace a2jmidi {
+
+/**
+ * A lock-free ring that carries time-stamped MIDI messages from one producer thread to
+ * one consumer thread.
+ *
+ * All memory is allocated by the constructor; `write` neither allocates nor waits, so
+ * the producer can be the JACK process thread. Each message is stored in one piece
+ * (a message that does not fit before the end of the buffer starts over at its beginning),
+ * so the consumer reads the bytes in place.
+ */
+class MessageRing {
+private:
+  /**
+   * Precedes each message in the buffer.
+   */
+  struct Header {
+    a2jmidi::TimePoint time;
+    uint32_t size;
+    uint32_t reserved;
+  };
+  /**
+   * Records start at multiples of the header size, so a header never wraps.
+   */
+  static constexpr size_t ALIGNMENT{sizeof(Header)};
+  /**
+   * Marks the unused space at the end of the buffer.
+   */
+  static constexpr uint32_t SKIP{UINT32_MAX};
+
+  std::vector<unsigned char> m_buffer;
+  size_t m_mask;
+  std::atomic<size_t> m_writeIndex{0}; ///< advanced by the producer, never wraps.
+  std::atomic<size_t> m_readIndex{0};  ///< advanced by the consumer, never wraps.
+
+  static constexpr size_t roundUp(size_t value, size_t step) {
+    return (value + step - 1) / step * step;
+  }
+  static size_t powerOfTwo(size_t minimum) {
+    size_t result = 2 * ALIGNMENT;
+    while (result < minimum) {
+      result *= 2;
+    }
+    return result;
+  }
+
+public:
+  /**
+   * Constructor.
+   * @param capacity - the size of the buffer in bytes (rounded up to a power of two). Each
+   * message takes its size plus 16 bytes, rounded up to a multiple of 16.
+   */
+  explicit MessageRing(size_t capacity)
+      : m_buffer(powerOfTwo(capacity)), m_mask{m_buffer.size() - 1} {}
+
+  MessageRing(const MessageRing &) = delete;
+  MessageRing &operator=(const MessageRing &) = delete;
+
+  /**
+   * Append a message (producer side).
+   * @param time - the time stamp of the message.
+   * @param bytes - the MIDI bytes.
+   * @param size - the number of bytes.
+   * @return false if there is not enough room (the message is not written).
+   */
+  bool write(a2jmidi::TimePoint time, const unsigned char *bytes, size_t size) noexcept {
+    const size_t capacity = m_buffer.size();
+    const size_t write = m_writeIndex.load(std::memory_order_relaxed);
+    const size_t read = m_readIndex.load(std::memory_order_acquire);
+    const size_t position = write & m_mask;
+    const size_t needed = roundUp(sizeof(Header) + size, ALIGNMENT);
+    const size_t tail = capacity - position;
+    const size_t skipped = (needed > tail) ? tail : 0;
+    if (needed + skipped > capacity - (write - read)) {
+      return false;
+    }
+    if (skipped) {
+      Header skip{0, SKIP, 0};
+      std::memcpy(&m_buffer[position], &skip, sizeof(Header));
+    }
+    const size_t start = (write + skipped) & m_mask;
+    Header header{time, static_cast<uint32_t>(size), 0};
+    std::memcpy(&m_buffer[start], &header, sizeof(Header));
+    std::memcpy(&m_buffer[start + sizeof(Header)], bytes, size);
+    m_writeIndex.store(write + skipped + needed, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * Take all messages written so far (consumer side).
+   * @param onMessage - invoked as `onMessage(TimePoint time, const unsigned char *bytes,
+   * size_t size)` for each message, in the order of writing. The bytes are only valid
+   * during the call.
+   * @return the number of messages taken.
+   */
+  template <typename Handler> int read(Handler &&onMessage) {
+    size_t read = m_readIndex.load(std::memory_order_relaxed);
+    const size_t write = m_writeIndex.load(std::memory_order_acquire);
+    int count = 0;
+    while (read != write) {
+      const size_t position = read & m_mask;
+      Header header;
+      std::memcpy(&header, &m_buffer[position], sizeof(Header));
+      if (header.size == SKIP) {
+        read += m_buffer.size() - position;
+        continue;
+      }
+      onMessage(header.time, &m_buffer[position + sizeof(Header)],
+                static_cast<size_t>(header.size));
+      read += roundUp(sizeof(Header) + header.size, ALIGNMENT);
+      m_readIndex.store(read, std::memory_order_release);
+      count++;
+    }
+    m_readIndex.store(read, std::memory_order_release);
+    return count;
+  }
+
+  /**
+   * Indicates whether there are no messages to read.
+   */
+  bool empty() const {
+    return m_readIndex.load(std::memory_order_acquire) ==
+           m_writeIndex.load(std::memory_order_acquire);
+  }
+};
+
+} // namespace a2jmidi
+
+#endif // A_J_MIDI_SRC_MESSAGE_RING_H
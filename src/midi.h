@@ -19,12 +19,128 @@
 #ifndef A_J_MIDI_SRC_MIDI_H
 #define A_J_MIDI_SRC_MIDI_H
 
+#include <atomic>
 #include <vector>
 
 namespace midi {
 
 using Event = std::vector<unsigned char>;
 
+/**
+ * The number of MIDI channels.
+ */
+constexpr int CHANNEL_COUNT{16};
+
+/**
+ * Indicates whether the given status byte starts a channel message (note, controller,
+ * program change, pressure or pitch bend).
+ * @param status - the first byte of a MIDI message.
+ * @return true if the message is addressed to one channel, false for system messages.
+ */
+constexpr bool isChannelMessage(unsigned char status) {
+  return (status >= 0x80U) && (status < 0xF0U);
+}
+
+/**
+ * The channel that a channel message is addressed to.
+ * @param status - the first byte of a channel message.
+ * @return the channel number (zero based).
+ */
+constexpr int channelOf(unsigned char status) { return status & 0x0FU; }
+
+/**
+ * The kinds of MIDI messages, as bits of a mask (see `classOf`).
+ */
+namespace messageClass {
+constexpr unsigned int NOTE{1U << 0U};           ///< note-on and note-off.
+constexpr unsigned int CONTROL{1U << 1U};        ///< control change (including channel mode).
+constexpr unsigned int PROGRAM{1U << 2U};        ///< program change.
+constexpr unsigned int PRESSURE{1U << 3U};       ///< polyphonic and channel pressure.
+constexpr unsigned int PITCH_BEND{1U << 4U};     ///< pitch bend.
+constexpr unsigned int SYSEX{1U << 5U};          ///< system exclusive.
+constexpr unsigned int CLOCK{1U << 6U};          ///< timing clock, start, continue and stop.
+constexpr unsigned int ACTIVE_SENSING{1U << 7U}; ///< active sensing.
+constexpr unsigned int SYSTEM{1U << 8U};         ///< the other system messages.
+} // namespace messageClass
+
+/**
+ * The kind of a MIDI message.
+ * @param status - the first byte of a MIDI message.
+ * @return one of the `messageClass` bits.
+ */
+constexpr unsigned int classOf(unsigned char status) {
+  switch (status & 0xF0U) {
+  case 0x80U:
+  case 0x90U:
+    return messageClass::NOTE;
+  case 0xA0U:
+  case 0xD0U:
+    return messageClass::PRESSURE;
+  case 0xB0U:
+    return messageClass::CONTROL;
+  case 0xC0U:
+    return messageClass::PROGRAM;
+  case 0xE0U:
+    return messageClass::PITCH_BEND;
+  default:
+    break;
+  }
+  switch (status) {
+  case 0xF0U:
+    return messageClass::SYSEX;
+  case 0xF8U:
+  case 0xFAU:
+  case 0xFBU:
+  case 0xFCU:
+    return messageClass::CLOCK;
+  case 0xFEU:
+    return messageClass::ACTIVE_SENSING;
+  default:
+    return messageClass::SYSTEM;
+  }
+}
+
+/**
+ * Holds back the messages of some kinds.
+ *
+ * The mask can be changed from any thread while another thread (for example the JACK
+ * process thread) filters: both sides only use atomic operations, nobody waits.
+ */
+class MessageFilter {
+private:
+  std::atomic<unsigned int> m_dropped{0};
+  std::atomic<long> m_filteredCount{0};
+
+public:
+  /**
+   * Choose the kinds of messages to hold back.
+   * @param droppedClasses - a mask of `messageClass` bits; zero lets all messages pass.
+   */
+  void set(unsigned int droppedClasses) noexcept {
+    m_dropped.store(droppedClasses, std::memory_order_relaxed);
+  }
+  /**
+   * The mask set by `set`.
+   */
+  unsigned int dropped() const noexcept { return m_dropped.load(std::memory_order_relaxed); }
+  /**
+   * Indicates whether a message passes the filter. Those that do not are counted.
+   * @param status - the first byte of the message.
+   * @return false if the message shall be held back.
+   */
+  bool passes(unsigned char status) noexcept {
+    if ((m_dropped.load(std::memory_order_relaxed) & classOf(status)) == 0) {
+      return true;
+    }
+    m_filteredCount.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  /**
+   * The number of messages held back so far.
+   */
+  long filteredCount() const noexcept { return m_filteredCount; }
+};
+
 } // namespace midi
 
 #endif // A_J_MIDI_SRC_MIDI_H
@@ -0,0 +1,117 @@
+/*
+ * File: midi_active_notes.h
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef A_J_MIDI_SRC_MIDI_ACTIVE_NOTES_H
+#define A_J_MIDI_SRC_MIDI_ACTIVE_NOTES_H
+
+#include "midi.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace midi {
+
+/**
+ * The number of note numbers per channel.
+ */
+constexpr int KEY_COUNT{128};
+
+/**
+ * Keeps track of the notes that are sounding (note-on sent, note-off not yet sent).
+ *
+ * One bit per channel and key (16 x 128 bits). The `update` function is meant to be
+ * called for every message that leaves the bridge; it has no data dependent branches,
+ * so that the cost stays at a few instructions per message, whatever the message is.
+ *
+ * When the flow of messages is disrupted (a source disappears, events are dropped)
+ * `releaseAll` produces the note-offs that would otherwise be missing downstream.
+ */
+class ActiveNotes {
+private:
+  static constexpr int WORDS_PER_CHANNEL{KEY_COUNT / 64};
+  std::array<uint64_t, CHANNEL_COUNT * WORDS_PER_CHANNEL> m_bits{};
+
+public:
+  /**
+   * Register a message that has been sent.
+   * @param bytes - the MIDI message.
+   * @param size - the number of bytes; only three-byte messages can be notes.
+   */
+  void update(const unsigned char *bytes, size_t size) noexcept {
+    if (size != 3) {
+      return;
+    }
+    uint64_t kind = bytes[0] & 0xF0U;
+    uint64_t silent = (bytes[2] == 0);
+    uint64_t isOn = (kind == 0x90U) & !silent;
+    uint64_t isOff = (kind == 0x80U) | ((kind == 0x90U) & silent);
+    unsigned key = bytes[1] & 0x7FU;
+    uint64_t &word = m_bits[(bytes[0] & 0x0FU) * WORDS_PER_CHANNEL + (key >> 6U)];
+    uint64_t bit = uint64_t{1} << (key & 63U);
+    // `0 - flag` is either all zeros or all ones.
+    word = (word | (bit & (0 - isOn))) & ~(bit & (0 - isOff));
+  }
+
+  /**
+   * Indicates whether the given note is sounding.
+   * @param channel - the channel (zero based).
+   * @param key - the note number.
+   */
+  bool isActive(int channel, int key) const noexcept {
+    return (m_bits[channel * WORDS_PER_CHANNEL + (key >> 6)] >> (key & 63)) & 1U;
+  }
+
+  /**
+   * Indicates whether any note is sounding.
+   */
+  bool any() const noexcept {
+    uint64_t all = 0;
+    for (auto word : m_bits) {
+      all |= word;
+    }
+    return all != 0;
+  }
+
+  /**
+   * Produce a note-off for each sounding note and forget all notes.
+   * @param onMessage - invoked as `onMessage(const unsigned char *bytes, size_t size)` for
+   * each note-off. The bytes are only valid during the call.
+   * @return the number of note-offs produced.
+   */
+  template <typename Handler> int releaseAll(Handler &&onMessage) {
+    int count = 0;
+    for (int i = 0; i < static_cast<int>(m_bits.size()); i++) {
+      uint64_t word = m_bits[i];
+      while (word) {
+        int bit = __builtin_ctzll(word);
+        word &= word - 1;
+        unsigned char noteOff[3]{
+            static_cast<unsigned char>(0x80U | (i / WORDS_PER_CHANNEL)),
+            static_cast<unsigned char>((i % WORDS_PER_CHANNEL) * 64 + bit), 0};
+        onMessage(noteOff, sizeof(noteOff));
+        count++;
+      }
+      m_bits[i] = 0;
+    }
+    return count;
+  }
+};
+
+} // namespace midi
+
+#endif // A_J_MIDI_SRC_MIDI_ACTIVE_NOTES_H
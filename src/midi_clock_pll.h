@@ -0,0 +1,163 @@
+/*
+ * File: midi_clock_pll.h
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef A_J_MIDI_SRC_MIDI_CLOCK_PLL_H
+#define A_J_MIDI_SRC_MIDI_CLOCK_PLL_H
+
+#include "a2jmidi_clock.h"
+#include <algorithm>
+#include <cmath>
+
+namespace midi {
+
+/**
+ * MIDI clock sends 24 ticks per quarter note.
+ */
+constexpr int TICKS_PER_QUARTER{24};
+
+/**
+ * Indicates whether the given status byte is a MIDI clock tick.
+ */
+constexpr bool isClockTick(unsigned char status) { return status == 0xF8U; }
+/**
+ * Indicates whether the given status byte is start, continue or stop.
+ */
+constexpr bool isTransport(unsigned char status) {
+  return status == 0xFAU || status == 0xFBU || status == 0xFCU;
+}
+
+/**
+ * A phase-locked loop that removes the arrival jitter of MIDI clock ticks.
+ *
+ * Ticks from USB devices arrive in bursts (aligned to USB frames and to the wake-ups of the
+ * listener), so their time stamps jitter. The loop (a second order delay-locked loop, as in
+ * F. Adriaensen, "Using a DLL to filter time") predicts the time of each tick from the
+ * previous ones; the prediction replaces the time stamp. A tick is never moved by more than
+ * `maxCorrection` frames, so the added latency stays bounded.
+ *
+ * Large deviations (tempo jumps, missing ticks, a restarted clock) let the loop lock again.
+ * Not thread safe; it is meant to live on the JACK process thread.
+ */
+class ClockPll {
+private:
+  double m_b;                    ///< the loop coefficient for the phase.
+  double m_c;                    ///< the loop coefficient for the period.
+  a2jmidi::TimePoint m_maxCorrection;
+  int m_count{0};                ///< the number of ticks since the loop (re)started.
+  double m_last{0};              ///< the arrival time of the previous tick (while locking).
+  double m_next{0};              ///< the predicted time of the next tick.
+  double m_period{0};            ///< the estimated period (frames per tick).
+  double m_errorSquare{0};       ///< the (smoothed) square of the phase error.
+
+  /**
+   * Ticks needed before the estimate is trusted.
+   */
+  static constexpr int LOCK_COUNT{TICKS_PER_QUARTER};
+
+  void restart(double arrival) {
+    m_count = 1;
+    m_last = arrival;
+    m_errorSquare = 0;
+  }
+
+public:
+  /**
+   * Constructor.
+   * @param maxCorrection - the largest shift (in frames) applied to a time stamp.
+   * @param bandwidth - the bandwidth of the loop, relative to the tick rate.
+   */
+  explicit ClockPll(a2jmidi::TimePoint maxCorrection, double bandwidth = 0.01)
+      : m_maxCorrection{maxCorrection} {
+    double omega = 2 * M_PI * bandwidth;
+    m_b = std::sqrt(2.0) * omega;
+    m_c = omega * omega;
+  }
+
+  /**
+   * Register a clock tick and compute its smoothed time.
+   * @param arrival - the time stamp of the tick.
+   * @return the time at which the tick shall be placed.
+   */
+  a2jmidi::TimePoint placeTick(a2jmidi::TimePoint arrival) {
+    auto t = static_cast<double>(arrival);
+    if (m_count == 0) {
+      restart(t);
+      return arrival;
+    }
+    if (m_count == 1) {
+      if (t <= m_last) {
+        return arrival; // ticks of the same burst, cannot tell the period yet.
+      }
+      m_period = t - m_last;
+      m_next = t + m_period;
+      m_count = 2;
+      return arrival;
+    }
+    double error = t - m_next;
+    if (std::abs(error) > m_period) {
+      restart(t); // tempo jump, missing ticks or a restarted clock.
+      return arrival;
+    }
+    double placed = m_next;
+    m_next += m_b * error + m_period;
+    m_period += m_c * error;
+    m_errorSquare += (error * error - m_errorSquare) / LOCK_COUNT;
+    m_count = std::min(m_count + 1, LOCK_COUNT);
+    auto result = static_cast<a2jmidi::TimePoint>(std::llround(placed));
+    return std::clamp(result, arrival - m_maxCorrection, arrival + m_maxCorrection);
+  }
+
+  /**
+   * Compute the time for a start, continue or stop message.
+   *
+   * These messages are aligned to the tick that is expected next, if it is close enough.
+   * @param arrival - the time stamp of the message.
+   * @return the time at which the message shall be placed.
+   */
+  a2jmidi::TimePoint placeTransport(a2jmidi::TimePoint arrival) const {
+    if (!isLocked()) {
+      return arrival;
+    }
+    auto predicted = static_cast<a2jmidi::TimePoint>(std::llround(m_next));
+    if (std::abs(predicted - arrival) > m_maxCorrection) {
+      return arrival;
+    }
+    return predicted;
+  }
+
+  /**
+   * Indicates whether the loop follows a steady clock.
+   */
+  bool isLocked() const { return m_count >= LOCK_COUNT; }
+
+  /**
+   * The estimated period of the clock.
+   * @return frames per tick, zero if the loop is not locked.
+   */
+  double period() const { return isLocked() ? m_period : 0; }
+
+  /**
+   * The estimated jitter of the arrival times.
+   * @return the root mean square of the deviation from the prediction, in frames.
+   */
+  double jitter() const { return std::sqrt(m_errorSquare); }
+};
+
+} // namespace midi
+
+#endif // A_J_MIDI_SRC_MIDI_CLOCK_PLL_H
@@ -0,0 +1,163 @@
+/*
+ * File: midi_stream_parser.h
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef A_J_MIDI_SRC_MIDI_STREAM_PARSER_H
+#define A_J_MIDI_SRC_MIDI_STREAM_PARSER_H
+
+#include <cstddef>
+#include <vector>
+
+namespace midi {
+
+/**
+ * An incremental parser that splits a MIDI byte stream (as read from a hardware port)
+ * into complete messages.
+ *
+ * The stream may be delivered in arbitrary chunks; a message that is cut at the end of
+ * one chunk is completed with the next chunk. The parser follows the MIDI 1.0 rules:
+ * - channel messages may use running status, the parser emits them with their status byte;
+ * - system common messages cancel running status;
+ * - real-time messages (0xF8...0xFF) may appear anywhere, even inside other messages,
+ *   they are emitted immediately and leave the message under construction untouched;
+ * - a SysEx message is collected until its terminating 0xF7 (any status byte other than
+ *   a real-time message also ends it, the message is then closed with an 0xF7);
+ * - data bytes without a valid status are ignored.
+ */
+class StreamParser {
+private:
+  std::vector<unsigned char> m_sysex; ///< the SysEx message under construction.
+  unsigned char m_message[3]{0, 0, 0};
+  unsigned char m_runningStatus{0}; ///< zero when there is no valid running status.
+  int m_expected{0};                ///< the length of the message under construction.
+  int m_count{0};                   ///< the number of bytes already in `m_message`.
+  bool m_inSysex{false};
+
+  /**
+   * The number of bytes (including the status byte) of a message with the given status.
+   * @param status - a status byte other than SysEx and real-time.
+   * @return the message length, zero for undefined status bytes.
+   */
+  static int messageLength(unsigned char status) {
+    switch (status & 0xF0U) {
+    case 0xC0:
+    case 0xD0:
+      return 2;
+    case 0xF0:
+      switch (status) {
+      case 0xF1: // MTC quarter frame
+      case 0xF3: // song select
+        return 2;
+      case 0xF2: // song position pointer
+        return 3;
+      case 0xF6: // tune request
+        return 1;
+      default: // 0xF4, 0xF5 are undefined, 0xF7 without a SysEx.
+        return 0;
+      }
+    default:
+      return 3;
+    }
+  }
+
+  template <typename Handler> void endSysex(Handler &onMessage) {
+    m_sysex.push_back(0xF7);
+    onMessage(m_sysex.data(), m_sysex.size());
+    m_sysex.clear();
+    m_inSysex = false;
+  }
+
+  template <typename Handler> void startMessage(unsigned char status, Handler &onMessage) {
+    if (status == 0xF0) {
+      m_inSysex = true;
+      m_sysex.assign(1, status);
+      m_runningStatus = 0;
+      m_expected = 0;
+      return;
+    }
+    m_runningStatus = (status < 0xF0) ? status : 0;
+    m_message[0] = status;
+    m_count = 1;
+    m_expected = messageLength(status);
+    if (m_expected == 1) {
+      onMessage(m_message, 1);
+      m_expected = 0;
+    }
+  }
+
+public:
+  /**
+   * Feed the next chunk of the byte stream.
+   * @param data - the bytes.
+   * @param length - the number of bytes.
+   * @param onMessage - invoked as `onMessage(const unsigned char *bytes, size_t size)` for
+   * each completed message. The bytes are only valid during the call.
+   */
+  template <typename Handler>
+  void parse(const unsigned char *data, size_t length, Handler &&onMessage) {
+    for (size_t i = 0; i < length; i++) {
+      unsigned char byte = data[i];
+      if (byte >= 0xF8) { // real-time
+        onMessage(&data[i], 1);
+        continue;
+      }
+      if (byte & 0x80U) { // status
+        if (m_inSysex) {
+          endSysex(onMessage);
+          if (byte == 0xF7) {
+            continue;
+          }
+        }
+        startMessage(byte, onMessage);
+        continue;
+      }
+      // data byte
+      if (m_inSysex) {
+        m_sysex.push_back(byte);
+        continue;
+      }
+      if (m_expected == 0) {
+        if (m_runningStatus == 0) {
+          continue; // no valid status, ignore.
+        }
+        m_message[0] = m_runningStatus;
+        m_count = 1;
+        m_expected = messageLength(m_runningStatus);
+      }
+      m_message[m_count++] = byte;
+      if (m_count == m_expected) {
+        onMessage(m_message, static_cast<size_t>(m_count));
+        m_expected = 0;
+      }
+    }
+  }
+
+  /**
+   * Forget any partially received message and the running status.
+   */
+  void reset() {
+    m_sysex.clear();
+    m_runningStatus = 0;
+    m_expected = 0;
+    m_count = 0;
+    m_inSysex = false;
+  }
+};
+
+} // namespace midi
+
+#endif // A_J_MIDI_SRC_MIDI_STREAM_PARSER_H
@@ -0,0 +1,235 @@
+/*
+ * File: midi_ump.h
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef A_J_MIDI_SRC_MIDI_UMP_H
+#define A_J_MIDI_SRC_MIDI_UMP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Universal MIDI Packets (MIDI 2.0) and their translation into MIDI 1.0 bytes.
+ *
+ * A packet is made of one to four 32-bit words; the message type in the top nibble of the
+ * first word determines its size. JACK MIDI carries MIDI 1.0 bytes, so packets are
+ * translated at the JACK boundary, following the default translation of the
+ * MIDI 2.0 specification (high resolution values are scaled down by dropping the
+ * least significant bits).
+ */
+namespace midi::ump {
+
+/**
+ * The message types that have a MIDI 1.0 representation.
+ */
+constexpr unsigned int TYPE_SYSTEM{0x1};        ///< system real-time and system common.
+constexpr unsigned int TYPE_MIDI1_VOICE{0x2};   ///< MIDI 1.0 channel voice.
+constexpr unsigned int TYPE_SYSEX7{0x3};        ///< 7-bit SysEx, in chunks of six bytes.
+constexpr unsigned int TYPE_MIDI2_VOICE{0x4};   ///< MIDI 2.0 channel voice.
+
+/**
+ * The largest number of MIDI 1.0 bytes that `toMidi1` writes.
+ */
+constexpr size_t MAX_MIDI1_SIZE{3};
+
+/**
+ * The message type of a packet.
+ * @param word - the first word of the packet.
+ */
+constexpr unsigned int messageType(uint32_t word) { return word >> 28U; }
+
+/**
+ * The number of 32-bit words of a packet.
+ * @param word - the first word of the packet.
+ * @return one to four.
+ */
+constexpr int wordCount(uint32_t word) {
+  switch (messageType(word)) {
+  case 0x3:
+  case 0x4:
+  case 0x8:
+  case 0x9:
+  case 0xA:
+    return 2;
+  case 0xB:
+  case 0xC:
+    return 3;
+  case 0x5:
+  case 0xD:
+  case 0xE:
+  case 0xF:
+    return 4;
+  default:
+    return 1;
+  }
+}
+
+/**
+ * Translate a packet into one MIDI 1.0 message.
+ *
+ * Messages without a MIDI 1.0 equivalent in a single message (per-note controllers,
+ * RPN/NRPN as one packet, utility and flex data, SysEx...) are not translated. The bank
+ * of a MIDI 2.0 program change is not translated either.
+ * @param words - the packet, at least `wordCount(words[0])` words.
+ * @param buffer - receives the MIDI bytes, must hold at least `MAX_MIDI1_SIZE` bytes.
+ * @return the number of bytes written, zero if the packet has no MIDI 1.0 translation.
+ */
+inline size_t toMidi1(const uint32_t *words, unsigned char *buffer) {
+  const uint32_t word = words[0];
+  const auto status = static_cast<unsigned char>((word >> 16U) & 0xFFU);
+  const auto data1 = static_cast<unsigned char>((word >> 8U) & 0x7FU);
+  const auto data2 = static_cast<unsigned char>(word & 0x7FU);
+  switch (messageType(word)) {
+  case TYPE_SYSTEM: {
+    size_t size;
+    switch (status) {
+    case 0xF1: // MTC quarter frame
+    case 0xF3: // song select
+      size = 2;
+      break;
+    case 0xF2: // song position pointer
+      size = 3;
+      break;
+    case 0xF6: // tune request
+    case 0xF8:
+    case 0xFA:
+    case 0xFB:
+    case 0xFC:
+    case 0xFE:
+    case 0xFF:
+      size = 1;
+      break;
+    default:
+      return 0;
+    }
+    buffer[0] = status;
+    buffer[1] = data1;
+    buffer[2] = data2;
+    return size;
+  }
+  case TYPE_MIDI1_VOICE: {
+    if (status < 0x80U || status >= 0xF0U) {
+      return 0;
+    }
+    buffer[0] = status;
+    buffer[1] = data1;
+    buffer[2] = data2;
+    unsigned int kind = status & 0xF0U;
+    return (kind == 0xC0U || kind == 0xD0U) ? 2 : 3;
+  }
+  case TYPE_MIDI2_VOICE: {
+    const uint32_t value = words[1];
+    const auto channel = static_cast<unsigned char>(status & 0x0FU);
+    const auto value7 = static_cast<unsigned char>(value >> 25U);
+    switch (status & 0xF0U) {
+    case 0x80: // note off, 16-bit velocity
+      buffer[0] = 0x80U | channel;
+      buffer[1] = data1;
+      buffer[2] = value7;
+      return 3;
+    case 0x90: // note on, 16-bit velocity; a scaled down velocity must not turn into a note off.
+      buffer[0] = 0x90U | channel;
+      buffer[1] = data1;
+      buffer[2] = value7 ? value7 : 1;
+      return 3;
+    case 0xA0: // poly pressure, 32-bit
+    case 0xB0: // controller, 32-bit
+      buffer[0] = status;
+      buffer[1] = data1;
+      buffer[2] = value7;
+      return 3;
+    case 0xC0: // program change, the program in the top byte of the second word
+      buffer[0] = status;
+      buffer[1] = static_cast<unsigned char>((value >> 24U) & 0x7FU);
+      return 2;
+    case 0xD0: // channel pressure, 32-bit
+      buffer[0] = status;
+      buffer[1] = value7;
+      return 2;
+    case 0xE0: { // pitch bend, 32-bit
+      uint32_t value14 = value >> 18U;
+      buffer[0] = status;
+      buffer[1] = static_cast<unsigned char>(value14 & 0x7FU);
+      buffer[2] = static_cast<unsigned char>(value14 >> 7U);
+      return 3;
+    }
+    default:
+      return 0;
+    }
+  }
+  default:
+    return 0;
+  }
+}
+
+/**
+ * Collects the chunks of 7-bit SysEx packets into complete SysEx messages
+ * (framed by 0xF0 and 0xF7).
+ */
+class Sysex7Assembler {
+private:
+  std::vector<unsigned char> m_message; ///< the SysEx message under construction.
+  bool m_inSysex{false};
+
+  enum Status : unsigned int { complete = 0x0, start = 0x1, middle = 0x2, end = 0x3 };
+
+public:
+  /**
+   * Feed the next 7-bit SysEx packet.
+   * @param words - a packet of type `TYPE_SYSEX7` (two words).
+   * @param onMessage - invoked as `onMessage(const unsigned char *bytes, size_t size)` when
+   * a message is complete. The bytes are only valid during the call.
+   */
+  template <typename Handler> void add(const uint32_t *words, Handler &&onMessage) {
+    const auto status = (words[0] >> 20U) & 0x0FU;
+    auto count = (words[0] >> 16U) & 0x0FU;
+    if (status == complete || status == start) {
+      m_message.assign(1, 0xF0);
+      m_inSysex = true;
+    } else if (!m_inSysex) {
+      return; // a chunk without its start, ignore.
+    }
+    const unsigned char bytes[6]{static_cast<unsigned char>(words[0] >> 8U),
+                                 static_cast<unsigned char>(words[0]),
+                                 static_cast<unsigned char>(words[1] >> 24U),
+                                 static_cast<unsigned char>(words[1] >> 16U),
+                                 static_cast<unsigned char>(words[1] >> 8U),
+                                 static_cast<unsigned char>(words[1])};
+    count = count > 6 ? 6 : count;
+    for (unsigned int i = 0; i < count; i++) {
+      m_message.push_back(bytes[i] & 0x7FU);
+    }
+    if (status == complete || status == end) {
+      m_message.push_back(0xF7);
+      onMessage(m_message.data(), m_message.size());
+      reset();
+    }
+  }
+
+  /**
+   * Forget a partially received message.
+   */
+  void reset() {
+    m_message.clear();
+    m_inSysex = false;
+  }
+};
+
+} // namespace midi::ump
+
+#endif // A_J_MIDI_SRC_MIDI_UMP_H
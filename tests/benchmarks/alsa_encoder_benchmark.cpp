@@ -0,0 +1,96 @@
+/*
+ * File: alsa_encoder_benchmark.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "alsa_encoder.h"
+
+#include "gtest/gtest.h"
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+namespace benchmarks {
+
+/**
+ * Compares the fast-path encoder with `snd_midi_event_decode()` on a typical mix of
+ * channel-voice events.
+ */
+class AlsaEncoderBenchmark : public ::testing::Test {
+protected:
+  static constexpr int EVENT_COUNT = 1000000;
+  static constexpr int BUFFER_SIZE = 16;
+  std::vector<snd_seq_event_t> m_events;
+
+  void SetUp() override {
+    m_events.resize(1024);
+    for (size_t i = 0; i < m_events.size(); i++) {
+      snd_seq_event_t &event = m_events[i];
+      snd_seq_ev_clear(&event);
+      switch (i % 4) {
+      case 0:
+        snd_seq_ev_set_noteon(&event, i % 16, i % 128, 100);
+        break;
+      case 1:
+        snd_seq_ev_set_noteoff(&event, i % 16, i % 128, 0);
+        break;
+      case 2:
+        snd_seq_ev_set_controller(&event, i % 16, 1, i % 128);
+        break;
+      default:
+        snd_seq_ev_set_pitchbend(&event, i % 16, static_cast<int>(i * 16) - 8192);
+        break;
+      }
+    }
+  }
+
+  static void report(const char *name, std::chrono::nanoseconds duration, long checksum) {
+    std::cout << "[ MEASURE  ] " << name << ": "
+              << static_cast<double>(duration.count()) / EVENT_COUNT << " ns/event (checksum "
+              << checksum << ")" << std::endl;
+  }
+};
+
+TEST_F(AlsaEncoderBenchmark, fastPath) {
+  unsigned char buffer[BUFFER_SIZE];
+  long checksum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < EVENT_COUNT; i++) {
+    checksum += alsaClient::encoder::encode(m_events[i % m_events.size()], buffer);
+    checksum += buffer[1];
+  }
+  report("fast path", std::chrono::steady_clock::now() - start, checksum);
+}
+
+TEST_F(AlsaEncoderBenchmark, alsaDecoder) {
+  snd_midi_event_t *decoder;
+  ASSERT_EQ(snd_midi_event_new(BUFFER_SIZE, &decoder), 0);
+  snd_midi_event_init(decoder);
+  snd_midi_event_no_status(decoder, 1);
+
+  unsigned char buffer[BUFFER_SIZE];
+  long checksum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < EVENT_COUNT; i++) {
+    checksum +=
+        snd_midi_event_decode(decoder, buffer, BUFFER_SIZE, &m_events[i % m_events.size()]);
+    checksum += buffer[1];
+  }
+  report("snd_midi_event_decode", std::chrono::steady_clock::now() - start, checksum);
+  snd_midi_event_free(decoder);
+}
+
+} // namespace benchmarks
@@ -0,0 +1,99 @@
+/*
+ * File: midi_active_notes_benchmark.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "midi_active_notes.h"
+
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+namespace benchmarks {
+
+/**
+ * Measures what the active-note tracking adds to each message written by the bridge.
+ *
+ * Both loops copy a mix of note-on, note-off and controller messages into a buffer (as
+ * the process callback does); the second one also updates the active notes.
+ */
+class MidiActiveNotesBenchmark : public ::testing::Test {
+protected:
+  static constexpr int EVENT_COUNT = 10000000;
+  using Message = std::array<unsigned char, 3>;
+  std::vector<Message> m_messages;
+
+  void SetUp() override {
+    m_messages.resize(1024);
+    for (size_t i = 0; i < m_messages.size(); i++) {
+      auto channel = static_cast<unsigned char>(i % 16);
+      auto key = static_cast<unsigned char>((i * 7) % 128);
+      switch (i % 4) {
+      case 0:
+        m_messages[i] = {static_cast<unsigned char>(0x90 | channel), key, 100};
+        break;
+      case 1:
+        m_messages[i] = {static_cast<unsigned char>(0x90 | channel), key, 0};
+        break;
+      case 2:
+        m_messages[i] = {static_cast<unsigned char>(0x80 | channel), key, 0};
+        break;
+      default:
+        m_messages[i] = {static_cast<unsigned char>(0xB0 | channel), 1, key};
+        break;
+      }
+    }
+  }
+
+  static void report(const char *name, std::chrono::nanoseconds duration, long checksum) {
+    std::cout << "[ MEASURE  ] " << name << ": "
+              << static_cast<double>(duration.count()) / EVENT_COUNT << " ns/event (checksum "
+              << checksum << ")" << std::endl;
+  }
+};
+
+TEST_F(MidiActiveNotesBenchmark, copyOnly) {
+  unsigned char buffer[3];
+  long checksum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < EVENT_COUNT; i++) {
+    const Message &message = m_messages[i % m_messages.size()];
+    std::copy(message.begin(), message.end(), buffer);
+    checksum += buffer[1];
+  }
+  report("copy only", std::chrono::steady_clock::now() - start, checksum);
+}
+
+TEST_F(MidiActiveNotesBenchmark, copyAndTrack) {
+  midi::ActiveNotes activeNotes;
+  unsigned char buffer[3];
+  long checksum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < EVENT_COUNT; i++) {
+    const Message &message = m_messages[i % m_messages.size()];
+    std::copy(message.begin(), message.end(), buffer);
+    activeNotes.update(buffer, sizeof(buffer));
+    checksum += buffer[1];
+  }
+  report("copy and track", std::chrono::steady_clock::now() - start, checksum);
+  checksum = activeNotes.releaseAll([](const unsigned char *, size_t) {});
+  std::cout << "[ MEASURE  ] " << checksum << " notes left sounding." << std::endl;
+}
+
+} // namespace benchmarks
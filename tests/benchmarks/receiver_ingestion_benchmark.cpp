@@ -0,0 +1,145 @@
+/*
+ * File: receiver_ingestion_benchmark.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "alsa_receiver_queue.h"
+
+#include "alsa_helper.h"
+#include "spdlog/spdlog.h"
+#include "gtest/gtest.h"
+#include <atomic>
+#include <chrono>
+#include <sys/resource.h>
+#include <thread>
+
+namespace benchmarks {
+using namespace unitTestHelpers;
+using namespace alsaClient;
+
+/**
+ * Compares the ingestion modes of the receiverQueue at different event rates.
+ *
+ * A sender emits controller events at a steady rate, a consumer drains the queue
+ * once per millisecond (like a JACK process callback would do).
+ */
+class ReceiverIngestionBenchmark : public ::testing::Test {
+protected:
+  ReceiverIngestionBenchmark() { spdlog::set_level(spdlog::level::warn); }
+
+  void SetUp() override { AlsaHelper::openAlsaSequencer("ingestion-benchmark"); }
+
+  void TearDown() override {
+    receiverQueue::setIngestionMode(receiverQueue::IngestionMode::library);
+    AlsaHelper::closeAlsaSequencer();
+  }
+
+  /**
+   * The CPU time (user and system) consumed so far by this process.
+   */
+  static std::chrono::microseconds cpuTime() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return std::chrono::seconds{usage.ru_utime.tv_sec + usage.ru_stime.tv_sec} +
+           std::chrono::microseconds{usage.ru_utime.tv_usec + usage.ru_stime.tv_usec};
+  }
+
+  /**
+   * Send controller events at the given rate for one second and drain the queue.
+   * @param mode - the ingestion mode to measure.
+   * @param eventsPerSecond - the rate at which events are sent.
+   */
+  static void measure(receiverQueue::IngestionMode mode, int eventsPerSecond) {
+    using namespace std::chrono_literals;
+    namespace queue = receiverQueue;
+    snd_seq_t *hSequencer = AlsaHelper::getSequencerHandle();
+    snd_seq_set_client_pool_input(hSequencer, 2000);
+    queue::setIngestionMode(mode);
+    queue::start(hSequencer, AlsaHelper::clock());
+
+    auto emitterPort = AlsaHelper::createOutputPort("out");
+    auto receiverPort = AlsaHelper::createInputPort("in");
+    AlsaHelper::connectPorts(emitterPort, receiverPort);
+
+    std::atomic<bool> carryOn{true};
+    long received = 0;
+    std::thread consumer{[&]() {
+      while (carryOn) {
+        queue::process(AlsaHelper::clock()->now(),
+                       [&](const snd_seq_event_t &, a2jmidi::TimePoint) { received++; });
+        std::this_thread::sleep_for(1ms);
+      }
+    }};
+
+    snd_seq_event_t evController;
+    snd_seq_ev_clear(&evController);
+    snd_seq_ev_set_subs(&evController);
+    snd_seq_ev_set_direct(&evController);
+    snd_seq_ev_set_source(&evController, emitterPort);
+
+    constexpr int milliseconds = 1000;
+    const int eventsPerMillisecond = eventsPerSecond / 1000;
+    long sent = 0;
+    auto overflowsBefore = queue::getStatistics().kernelOverflowCount;
+    auto cpuStart = cpuTime();
+    auto wakeUp = std::chrono::steady_clock::now();
+    for (int ms = 0; ms < milliseconds; ms++) {
+      for (int i = 0; i < eventsPerMillisecond; i++) {
+        snd_seq_ev_set_controller(&evController, 0, 1, i % 128);
+        if (snd_seq_event_output(hSequencer, &evController) >= 0) {
+          sent++;
+        }
+      }
+      snd_seq_drain_output(hSequencer);
+      wakeUp += 1ms;
+      std::this_thread::sleep_until(wakeUp);
+    }
+    std::this_thread::sleep_for(50ms); // let the consumer catch up.
+    auto cpuUsed = cpuTime() - cpuStart;
+    carryOn = false;
+    consumer.join();
+    queue::stop();
+
+    auto overflows = queue::getStatistics().kernelOverflowCount - overflowsBefore;
+    std::cout << "[ MEASURE  ] "
+              << (mode == queue::IngestionMode::rawRead ? "rawRead " : "library ")
+              << eventsPerSecond << " events/s: sent " << sent << ", received " << received
+              << ", kernel overflows " << overflows << ", cpu " << cpuUsed.count() << " us"
+              << std::endl;
+    EXPECT_LE(received, sent);
+  }
+};
+
+TEST_F(ReceiverIngestionBenchmark, library10k) {
+  measure(receiverQueue::IngestionMode::library, 10000);
+}
+TEST_F(ReceiverIngestionBenchmark, rawRead10k) {
+  measure(receiverQueue::IngestionMode::rawRead, 10000);
+}
+TEST_F(ReceiverIngestionBenchmark, library30k) {
+  measure(receiverQueue::IngestionMode::library, 30000);
+}
+TEST_F(ReceiverIngestionBenchmark, rawRead30k) {
+  measure(receiverQueue::IngestionMode::rawRead, 30000);
+}
+TEST_F(ReceiverIngestionBenchmark, library100k) {
+  measure(receiverQueue::IngestionMode::library, 100000);
+}
+TEST_F(ReceiverIngestionBenchmark, rawRead100k) {
+  measure(receiverQueue::IngestionMode::rawRead, 100000);
+}
+
+} // namespace benchmarks
@@ -0,0 +1,163 @@
+/*
+ * File: startup_benchmark.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "alsa_helper.h"
+#include "spdlog/spdlog.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fcntl.h>
+#include <jack/jack.h>
+#include <jack/midiport.h>
+#include <signal.h>
+#include <spawn.h>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace benchmarks {
+using namespace unitTestHelpers;
+using Clock = std::chrono::steady_clock;
+using Milliseconds = std::chrono::duration<double, std::milli>;
+
+/**
+ * Measures how quickly a freshly launched `a2jmidi` process becomes usable.
+ *
+ * The bridge is started as a child process, the way a session script would start it.
+ * While it starts up, a sender emits a controller event every millisecond towards the
+ * ALSA port the bridge connects to, and a JACK reader waits for the first event to
+ * come out of the bridge. Two figures are taken for each launch:
+ * - exec to activated: until the JACK port of the bridge can be connected (JACK only
+ *   allows connections to active clients);
+ * - exec to first event: until the first event arrives at the JACK reader.
+ */
+class StartupBenchmark : public ::testing::Test {
+protected:
+  static constexpr const char *SENDER_NAME{"startup-benchmark"};
+  static constexpr const char *READER_NAME{"startup-benchmark-reader"};
+  static constexpr int LAUNCH_COUNT{10};
+  static constexpr Milliseconds STARTUP_BUDGET{20.0};
+
+  jack_client_t *m_reader{nullptr};
+  jack_port_t *m_readerPort{nullptr};
+  int m_emitterPort{0};
+  static std::atomic<Clock::rep> g_firstEventTime;
+
+  StartupBenchmark() { spdlog::set_level(spdlog::level::warn); }
+
+  void SetUp() override {
+    AlsaHelper::openAlsaSequencer(SENDER_NAME);
+    m_emitterPort = AlsaHelper::createOutputPort("out");
+    m_reader = jack_client_open(READER_NAME, JackNoStartServer, nullptr);
+    ASSERT_NE(m_reader, nullptr) << "a running JACK server is needed.";
+    m_readerPort =
+        jack_port_register(m_reader, "in", JACK_DEFAULT_MIDI_TYPE, JackPortIsInput, 0);
+    ASSERT_NE(m_readerPort, nullptr);
+    jack_set_process_callback(m_reader, process, m_readerPort);
+    ASSERT_EQ(jack_activate(m_reader), 0);
+  }
+
+  void TearDown() override {
+    if (m_reader) {
+      jack_client_close(m_reader);
+    }
+    AlsaHelper::closeAlsaSequencer();
+  }
+
+  static int process(jack_nframes_t nFrames, void *arg) {
+    auto *port = static_cast<jack_port_t *>(arg);
+    void *buffer = jack_port_get_buffer(port, nFrames);
+    if (g_firstEventTime == 0 && jack_midi_get_event_count(buffer) > 0) {
+      g_firstEventTime = Clock::now().time_since_epoch().count();
+    }
+    return 0;
+  }
+
+  /**
+   * Start the bridge as a child process, its output is discarded.
+   */
+  static pid_t launchBridge(const std::string &name) {
+    std::string connect = std::string{SENDER_NAME} + ":out";
+    std::vector<char *> argv{const_cast<char *>(A2JMIDI_EXECUTABLE),
+                             const_cast<char *>("--connect"), connect.data(),
+                             const_cast<char *>(name.c_str()), nullptr};
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+    pid_t pid{0};
+    int err = posix_spawn(&pid, A2JMIDI_EXECUTABLE, &actions, nullptr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    return err == 0 ? pid : 0;
+  }
+
+  static Milliseconds median(std::vector<Milliseconds> values) {
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+  }
+};
+
+std::atomic<Clock::rep> StartupBenchmark::g_firstEventTime{0};
+
+TEST_F(StartupBenchmark, coldStart) {
+  using namespace std::chrono_literals;
+  std::vector<Milliseconds> toActivated;
+  std::vector<Milliseconds> toFirstEvent;
+
+  for (int i = 0; i < LAUNCH_COUNT; i++) {
+    std::string name = "startup-bench-" + std::to_string(i);
+    std::string bridgePort = name + ":" + name;
+    std::string readerPort = std::string{READER_NAME} + ":in";
+    g_firstEventTime = 0;
+
+    auto start = Clock::now();
+    pid_t pid = launchBridge(name);
+    ASSERT_NE(pid, 0) << "cannot launch " << A2JMIDI_EXECUTABLE;
+
+    bool connected{false};
+    auto giveUp = start + 2s;
+    while (g_firstEventTime == 0 && Clock::now() < giveUp) {
+      AlsaHelper::sendControllerEvents(m_emitterPort, 1);
+      if (!connected &&
+          jack_connect(m_reader, bridgePort.c_str(), readerPort.c_str()) == 0) {
+        connected = true;
+        toActivated.emplace_back(Clock::now() - start);
+      }
+      std::this_thread::sleep_for(1ms);
+    }
+    auto firstEvent = Clock::time_point{Clock::duration{g_firstEventTime}};
+
+    kill(pid, SIGTERM);
+    waitpid(pid, nullptr, 0);
+    ASSERT_TRUE(connected) << "bridge " << name << " did not activate.";
+    ASSERT_NE(g_firstEventTime, 0) << "bridge " << name << " did not deliver an event.";
+    toFirstEvent.emplace_back(firstEvent - start);
+  }
+
+  auto maxActivated = *std::max_element(toActivated.begin(), toActivated.end());
+  auto maxFirstEvent = *std::max_element(toFirstEvent.begin(), toFirstEvent.end());
+  std::cout << "[ MEASURE  ] exec to activated: median " << median(toActivated).count()
+            << " ms, max " << maxActivated.count() << " ms" << std::endl;
+  std::cout << "[ MEASURE  ] exec to first event: median " << median(toFirstEvent).count()
+            << " ms, max " << maxFirstEvent.count() << " ms" << std::endl;
+  EXPECT_LT(median(toFirstEvent).count(), STARTUP_BUDGET.count());
+}
+
+} // namespace benchmarks
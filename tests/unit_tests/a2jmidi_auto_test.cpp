@@ -0,0 +1,45 @@
+/*
+ * File: a2jmidi_auto_test.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "a2jmidi_auto.h"
+
+#include "gtest/gtest.h"
+
+namespace unitTests {
+
+/**
+ * The client name is left out when the port name repeats it.
+ */
+TEST(A2jmidiAutoTest, jackPortNameWithoutRepetition) {
+  using a2jmidi::autoBridge::jackPortName;
+  EXPECT_EQ(jackPortName("Keystation 61", "Keystation 61 MIDI 1"), "Keystation 61 MIDI 1");
+  EXPECT_EQ(jackPortName("UM-ONE", "UM-ONE MIDI 1"), "UM-ONE MIDI 1");
+  EXPECT_EQ(jackPortName("VMPK Output", "out"), "VMPK Output out");
+}
+
+/**
+ * Colons separate the client name in JACK port names, they are replaced.
+ */
+TEST(A2jmidiAutoTest, jackPortNameWithoutColons) {
+  using a2jmidi::autoBridge::jackPortName;
+  EXPECT_EQ(jackPortName("Synth", "Port: A"), "Synth Port- A");
+  EXPECT_EQ(jackPortName("A:B", "A:B 1"), "A-B 1");
+}
+
+} // namespace unitTests
@@ -138,16 +138,306 @@ TEST_F(A2jmidiCommandLineParserTest, connectOption) {
   // the long version
   const char *avl[parmCount] = {"./a2jmidi", "--connect", "[128:0]" };
   CommandLineInterpretation result1 = parseCommandLine(parmCount, avl);
-  EXPECT_EQ(result1.connectTo, "[128:0]");
+  EXPECT_EQ(result1.connectTo, std::vector<std::string>{"[128:0]"});
 
   // the short version
   const char *avs[parmCount] = {"./a2jmidi", "-c", "[129:0]"};
   CommandLineInterpretation result2 = parseCommandLine(parmCount, avs);
-  EXPECT_EQ(result2.connectTo, "[129:0]");
+  EXPECT_EQ(result2.connectTo, std::vector<std::string>{"[129:0]"});
 
   // `noStartServerOption` not present
   const char *avn[parmCount] = {"./a2jmidi", "deviceName" "-s"};
   CommandLineInterpretation result3 = parseCommandLine(parmCount, avn);
-  EXPECT_EQ(result3.connectTo, "");
+  EXPECT_TRUE(result3.connectTo.empty());
+}
+/**
+ *  the --connect option can be repeated.
+ */
+TEST_F(A2jmidiCommandLineParserTest, connectOptionRepeated) {
+  using namespace a2jmidi;
+  constexpr int parmCount = 1 + 6;
+
+  const char *av[parmCount] = {"./a2jmidi", "--connect", "[128:0]", "-c",
+                               "USB-MIDI",  "-c",        "Keystation:0"};
+  CommandLineInterpretation result = parseCommandLine(parmCount, av);
+  EXPECT_EQ(result.action, CommandLineAction::run);
+  EXPECT_EQ(result.connectTo,
+            (std::vector<std::string>{"[128:0]", "USB-MIDI", "Keystation:0"}));
+}
+/**
+ *  --queue-max-events, --queue-max-bytes and --overflow options
+ */
+TEST_F(A2jmidiCommandLineParserTest, queueLimitOptions) {
+  using namespace a2jmidi;
+  using alsaClient::receiverQueue::OverflowPolicy;
+
+  // the defaults
+  const char *avd[1] = {"./a2jmidi"};
+  CommandLineInterpretation result1 = parseCommandLine(1, avd);
+  EXPECT_EQ(result1.queueLimits.maxEvents, alsaClient::receiverQueue::DEFAULT_MAX_EVENTS);
+  EXPECT_EQ(result1.queueLimits.maxBytes, alsaClient::receiverQueue::DEFAULT_MAX_BYTES);
+  EXPECT_EQ(result1.queueLimits.policy, OverflowPolicy::dropOldest);
+
+  // all options given
+  constexpr int parmCount = 1 + 6;
+  const char *avl[parmCount] = {"./a2jmidi",          "--queue-max-events", "100",
+                                "--queue-max-bytes", "4096",              "--overflow",
+                                "coalesce"};
+  CommandLineInterpretation result2 = parseCommandLine(parmCount, avl);
+  EXPECT_EQ(result2.action, CommandLineAction::run);
+  EXPECT_EQ(result2.queueLimits.maxEvents, 100);
+  EXPECT_EQ(result2.queueLimits.maxBytes, 4096);
+  EXPECT_EQ(result2.queueLimits.policy, OverflowPolicy::coalesceControllers);
+
+  // an unknown policy
+  const char *avu[3] = {"./a2jmidi", "--overflow", "drop-all"};
+  CommandLineInterpretation result3 = parseCommandLine(3, avu);
+  EXPECT_EQ(result3.action, CommandLineAction::messageError);
+
+  // a ceiling of zero (or less) would drop every event
+  EXPECT_EQ(parseArguments("--queue-max-events 0").action, CommandLineAction::messageError);
+  EXPECT_EQ(parseArguments("--queue-max-events=-5").action, CommandLineAction::messageError);
+  EXPECT_EQ(parseArguments("--queue-max-bytes 0").action, CommandLineAction::messageError);
+  EXPECT_EQ(parseArguments("--queue-max-bytes=-4096").action, CommandLineAction::messageError);
+}
+/**
+ *  --max-event-age option
+ */
+TEST_F(A2jmidiCommandLineParserTest, maxEventAgeOption) {
+  using namespace a2jmidi;
+
+  const char *avd[1] = {"./a2jmidi"};
+  CommandLineInterpretation result1 = parseCommandLine(1, avd);
+  EXPECT_EQ(result1.maxEventAgeMs, DEFAULT_MAX_EVENT_AGE_MS);
+
+  const char *avl[3] = {"./a2jmidi", "--max-event-age", "250"};
+  CommandLineInterpretation result2 = parseCommandLine(3, avl);
+  EXPECT_EQ(result2.maxEventAgeMs, 250);
+
+  EXPECT_EQ(parseArguments("--max-event-age 0").action, CommandLineAction::messageError);
+  EXPECT_EQ(parseArguments("--max-event-age=-50").action, CommandLineAction::messageError);
+}
+/**
+ *  --input-pool, --input-buffer and --adaptive-pool options
+ */
+TEST_F(A2jmidiCommandLineParserTest, inputPoolOptions) {
+  using namespace a2jmidi;
+
+  // the defaults
+  const char *avd[1] = {"./a2jmidi"};
+  CommandLineInterpretation result1 = parseCommandLine(1, avd);
+  EXPECT_EQ(result1.inputPool.poolSize, 0);
+  EXPECT_EQ(result1.inputPool.bufferSize, 0);
+  EXPECT_FALSE(result1.inputPool.adaptive);
+
+  // all options given
+  constexpr int parmCount = 1 + 5;
+  const char *avl[parmCount] = {"./a2jmidi",      "--input-pool", "1000", "--input-buffer",
+                                "65536", "--adaptive-pool"};
+  CommandLineInterpretation result2 = parseCommandLine(parmCount, avl);
+  EXPECT_EQ(result2.action, CommandLineAction::run);
+  EXPECT_EQ(result2.inputPool.poolSize, 1000);
+  EXPECT_EQ(result2.inputPool.bufferSize, 65536);
+  EXPECT_TRUE(result2.inputPool.adaptive);
+}
+/**
+ *  --split-channels option
+ */
+TEST_F(A2jmidiCommandLineParserTest, splitChannelsOption) {
+  using namespace a2jmidi;
+
+  const char *avd[1] = {"./a2jmidi"};
+  CommandLineInterpretation result1 = parseCommandLine(1, avd);
+  EXPECT_FALSE(result1.splitChannels);
+
+  const char *avl[2] = {"./a2jmidi", "--split-channels"};
+  CommandLineInterpretation result2 = parseCommandLine(2, avl);
+  EXPECT_TRUE(result2.splitChannels);
+}
+/**
+ *  --raw-input option
+ */
+TEST_F(A2jmidiCommandLineParserTest, rawInputOption) {
+  using namespace a2jmidi;
+  using alsaClient::receiverQueue::IngestionMode;
+
+  const char *avd[1] = {"./a2jmidi"};
+  CommandLineInterpretation result1 = parseCommandLine(1, avd);
+  EXPECT_EQ(result1.ingestionMode, IngestionMode::library);
+
+  const char *avl[2] = {"./a2jmidi", "--raw-input"};
+  CommandLineInterpretation result2 = parseCommandLine(2, avl);
+  EXPECT_EQ(result2.ingestionMode, IngestionMode::rawRead);
+}
+
+/**
+ * The `--rawmidi` option names a hardware device to be read directly.
+ */
+TEST_F(A2jmidiCommandLineParserTest, rawMidiOption) {
+  using namespace a2jmidi;
+
+  const char *avd[1] = {"./a2jmidi"};
+  CommandLineInterpretation result1 = parseCommandLine(1, avd);
+  EXPECT_TRUE(result1.rawMidiDevice.empty());
+
+  const char *avr[3] = {"./a2jmidi", "--rawmidi", "hw:1,0,0"};
+  CommandLineInterpretation result2 = parseCommandLine(3, avr);
+  EXPECT_EQ(result2.action, CommandLineAction::run);
+  EXPECT_EQ(result2.rawMidiDevice, "hw:1,0,0");
+}
+
+/**
+ * The `--probe` option takes a positive number of probes and excludes `--rawmidi`.
+ */
+TEST_F(A2jmidiCommandLineParserTest, probeOption) {
+  using namespace a2jmidi;
+
+  const char *avd[1] = {"./a2jmidi"};
+  CommandLineInterpretation result1 = parseCommandLine(1, avd);
+  EXPECT_EQ(result1.probeCount, 0);
+
+  const char *avp[3] = {"./a2jmidi", "--probe", "500"};
+  CommandLineInterpretation result2 = parseCommandLine(3, avp);
+  EXPECT_EQ(result2.action, CommandLineAction::run);
+  EXPECT_EQ(result2.probeCount, 500);
+
+  const char *avz[3] = {"./a2jmidi", "--probe", "0"};
+  CommandLineInterpretation result3 = parseCommandLine(3, avz);
+  EXPECT_EQ(result3.action, CommandLineAction::messageError);
+
+  const char *avr[5] = {"./a2jmidi", "--probe", "10", "--rawmidi", "hw:1,0"};
+  CommandLineInterpretation result4 = parseCommandLine(5, avr);
+  EXPECT_EQ(result4.action, CommandLineAction::messageError);
+}
+
+/**
+ * The load-init string of the internal client is split like a shell command line.
+ */
+TEST_F(A2jmidiCommandLineParserTest, loadInitString) {
+  using namespace a2jmidi;
+
+  CommandLineInterpretation result1 = parseArguments("");
+  EXPECT_EQ(result1.action, CommandLineAction::run);
+
+  CommandLineInterpretation result2 = parseArguments("--connect 'USB-MIDI MIDI 1' -n bridge");
+  EXPECT_EQ(result2.action, CommandLineAction::run);
+  ASSERT_EQ(result2.connectTo.size(), 1U);
+  EXPECT_EQ(result2.connectTo[0], "USB-MIDI MIDI 1");
+  EXPECT_EQ(result2.clientName, "bridge");
+
+  CommandLineInterpretation result3 = parseArguments("--unknown");
+  EXPECT_EQ(result3.action, CommandLineAction::messageError);
+}
+
+/**
+ * Probes can be sent through an external loop, but only when probing.
+ */
+TEST_F(A2jmidiCommandLineParserTest, probeThroughOption) {
+  using namespace a2jmidi;
+
+  CommandLineInterpretation result1 = parseArguments("--probe 10 --probe-through 'Synth:0'");
+  EXPECT_EQ(result1.action, CommandLineAction::run);
+  EXPECT_EQ(result1.probeThrough, "Synth:0");
+
+  CommandLineInterpretation result2 = parseArguments("--probe-through 'Synth:0'");
+  EXPECT_EQ(result2.action, CommandLineAction::messageError);
+}
+
+/**
+ * The reverse direction cannot be combined with the options that read ALSA.
+ */
+TEST_F(A2jmidiCommandLineParserTest, j2aOption) {
+  using namespace a2jmidi;
+
+  CommandLineInterpretation result1 = parseArguments("");
+  EXPECT_FALSE(result1.j2a);
+
+  CommandLineInterpretation result2 = parseArguments("--j2a --connect 'Synth:0'");
+  EXPECT_EQ(result2.action, CommandLineAction::run);
+  EXPECT_TRUE(result2.j2a);
+  ASSERT_EQ(result2.connectTo.size(), 1U);
+
+  CommandLineInterpretation result3 = parseArguments("--j2a --probe 10");
+  EXPECT_EQ(result3.action, CommandLineAction::messageError);
+  CommandLineInterpretation result4 = parseArguments("--j2a --rawmidi hw:1,0");
+  EXPECT_EQ(result4.action, CommandLineAction::messageError);
+}
+
+/**
+ * The automatic mode bridges hardware inputs unless another filter is given.
+ */
+TEST_F(A2jmidiCommandLineParserTest, autoOption) {
+  using namespace a2jmidi;
+
+  CommandLineInterpretation result1 = parseArguments("");
+  EXPECT_FALSE(result1.autoConnect);
+
+  CommandLineInterpretation result2 = parseArguments("--auto");
+  EXPECT_EQ(result2.action, CommandLineAction::run);
+  EXPECT_TRUE(result2.autoConnect);
+  EXPECT_EQ(result2.autoFilter.clientKind, alsaClient::ClientKind::hardware);
+
+  CommandLineInterpretation result3 = parseArguments("--auto --auto-filter all");
+  EXPECT_EQ(result3.action, CommandLineAction::run);
+  EXPECT_EQ(result3.autoFilter.clientKind, alsaClient::ClientKind::all);
+
+  CommandLineInterpretation result4 = parseArguments("--auto-filter software");
+  EXPECT_EQ(result4.action, CommandLineAction::messageError);
+  CommandLineInterpretation result5 = parseArguments("--auto --auto-filter sometimes");
+  EXPECT_EQ(result5.action, CommandLineAction::messageError);
+  CommandLineInterpretation result6 = parseArguments("--auto --connect 'Synth:0'");
+  EXPECT_EQ(result6.action, CommandLineAction::messageError);
+  CommandLineInterpretation result7 = parseArguments("--auto --j2a");
+  EXPECT_EQ(result7.action, CommandLineAction::messageError);
+}
+
+/**
+ * The option `--control` names the socket on which the running bridge accepts requests.
+ */
+TEST_F(A2jmidiCommandLineParserTest, controlOption) {
+  using namespace a2jmidi;
+
+  CommandLineInterpretation result1 = parseArguments("");
+  EXPECT_TRUE(result1.controlSocket.empty());
+
+  CommandLineInterpretation result2 = parseArguments("--control /tmp/a2jmidi.sock");
+  EXPECT_EQ(result2.action, CommandLineAction::run);
+  EXPECT_EQ(result2.controlSocket, "/tmp/a2jmidi.sock");
+
+  CommandLineInterpretation result3 = parseArguments("--control");
+  EXPECT_EQ(result3.action, CommandLineAction::messageError);
+  CommandLineInterpretation result4 = parseArguments("--control /tmp/a2jmidi.sock --probe 10");
+  EXPECT_EQ(result4.action, CommandLineAction::messageError);
+}
+
+/**
+ * Latency profiles are read line by line; comments and blank lines are skipped.
+ */
+TEST_F(A2jmidiCommandLineParserTest, latencyProfiles) {
+  using namespace a2jmidi;
+
+  std::stringstream input{"# measured with --probe-through\n"
+                          "\n"
+                          "Keystation = 2.5\n"
+                          "  \"USB MIDI: port=1\" = -1  # a late interface\n"
+                          "20:0=0\n"};
+  auto profiles = parseLatencyProfiles(input);
+  ASSERT_EQ(profiles.size(), 3U);
+  EXPECT_EQ(profiles[0].designation, "Keystation");
+  EXPECT_DOUBLE_EQ(profiles[0].milliseconds, 2.5);
+  EXPECT_EQ(profiles[1].designation, "USB MIDI: port=1");
+  EXPECT_DOUBLE_EQ(profiles[1].milliseconds, -1);
+  EXPECT_EQ(profiles[2].designation, "20:0");
+  EXPECT_DOUBLE_EQ(profiles[2].milliseconds, 0);
+
+  std::stringstream noValue{"Keystation\n"};
+  EXPECT_THROW(parseLatencyProfiles(noValue), std::invalid_argument);
+  std::stringstream badValue{"Keystation = 2ms\n"};
+  EXPECT_THROW(parseLatencyProfiles(badValue), std::invalid_argument);
+  std::stringstream noDesignation{" = 2\n"};
+  EXPECT_THROW(parseLatencyProfiles(noDesignation), std::invalid_argument);
+
+  CommandLineInterpretation result = parseArguments("--latency-profiles /nonexistent/profiles");
+  EXPECT_EQ(result.action, CommandLineAction::messageError);
 }
 } // namespace unitTests
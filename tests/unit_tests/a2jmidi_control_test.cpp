@@ -0,0 +1,118 @@
+/*
+ * File: a2jmidi_control_test.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "a2jmidi_control.h"
+#include "midi.h"
+
+#include "gtest/gtest.h"
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace unitTests {
+
+/**
+ * Requests are split like a shell would do.
+ */
+TEST(A2jmidiControlTest, tokenize) {
+  using a2jmidi::control::tokenize;
+  EXPECT_TRUE(tokenize("   ").empty());
+  EXPECT_EQ(tokenize("filter messages clock,sensing"),
+            std::vector<std::string>({"filter", "messages", "clock,sensing"}));
+  EXPECT_EQ(tokenize("connect 'UM-ONE:0' \"Midi Through\""),
+            std::vector<std::string>({"connect", "UM-ONE:0", "Midi Through"}));
+}
+
+/**
+ * The response ends with `OK`, or with `ERR` and the reason when the handler throws.
+ */
+TEST(A2jmidiControlTest, respond) {
+  using a2jmidi::control::respond;
+  auto handler = [](const std::vector<std::string> &words) -> std::string {
+    if (words[0] == "fail") {
+      throw std::invalid_argument("it failed\nbadly");
+    }
+    return words[0] + " " + std::to_string(words.size()) + "\n";
+  };
+  EXPECT_EQ(respond("stats now", handler), "stats 2\nOK\n");
+  EXPECT_EQ(respond("fail", handler), "ERR it failed badly\n");
+  EXPECT_EQ(respond("", handler), "");
+}
+
+/**
+ * Message classes are given by name, `none` clears the filter.
+ */
+TEST(A2jmidiControlTest, parseMessageClasses) {
+  using a2jmidi::control::parseMessageClasses;
+  namespace messageClass = midi::messageClass;
+  EXPECT_EQ(parseMessageClasses("none"), 0u);
+  EXPECT_EQ(parseMessageClasses("clock,sensing"),
+            messageClass::CLOCK | messageClass::ACTIVE_SENSING);
+  EXPECT_EQ(parseMessageClasses("note"), messageClass::NOTE);
+  EXPECT_THROW(parseMessageClasses("clock,tempo"), std::invalid_argument);
+  EXPECT_THROW(parseMessageClasses(""), std::invalid_argument);
+  EXPECT_THROW(parseMessageClasses("clock,"), std::invalid_argument);
+}
+
+/**
+ * The names of the classes in a mask can be parsed again.
+ */
+TEST(A2jmidiControlTest, messageClassNames) {
+  using a2jmidi::control::messageClassNames;
+  using a2jmidi::control::parseMessageClasses;
+  EXPECT_EQ(messageClassNames(0), "none");
+  EXPECT_EQ(messageClassNames(parseMessageClasses("sensing,sysex")), "sysex,sensing");
+  EXPECT_EQ(parseMessageClasses(messageClassNames(0x1FF)), 0x1FFu);
+}
+
+/**
+ * A client sends a request over the socket and reads the response.
+ */
+TEST(A2jmidiControlTest, serveRequests) {
+  namespace control = a2jmidi::control;
+  const std::string path = "/tmp/a2jmidi_control_test.sock";
+  control::open(path, [](const std::vector<std::string> &words) { return words[0] + "\n"; });
+  EXPECT_TRUE(control::isOpen());
+
+  int client = socket(AF_UNIX, SOCK_STREAM, 0);
+  ASSERT_GE(client, 0);
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  path.copy(address.sun_path, sizeof(address.sun_path) - 1);
+  ASSERT_EQ(connect(client, reinterpret_cast<const sockaddr *>(&address), sizeof(address)), 0);
+
+  const std::string request = "hello world\nquit\n";
+  ASSERT_EQ(write(client, request.data(), request.size()),
+            static_cast<ssize_t>(request.size()));
+  std::string response;
+  char buffer[64];
+  ssize_t n;
+  while ((n = read(client, buffer, sizeof buffer)) > 0) {
+    response.append(buffer, static_cast<size_t>(n));
+  }
+  ::close(client);
+  EXPECT_EQ(response, "hello\nOK\nOK\n");
+
+  control::close();
+  EXPECT_FALSE(control::isOpen());
+  EXPECT_NE(access(path.c_str(), F_OK), 0);
+}
+
+} // namespace unitTests
@@ -0,0 +1,74 @@
+/*
+ * File: a2jmidi_j2a_test.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "a2jmidi_j2a.h"
+
+#include "gtest/gtest.h"
+
+namespace unitTests {
+
+using namespace std::chrono_literals;
+
+/**
+ * Events keep their spacing: each one leaves one period after its frame time.
+ */
+TEST(A2jmidiJ2aTest, sendDelayKeepsSpacing) {
+  using a2jmidi::j2a::sendDelay;
+  constexpr int sampleRate = 48000;
+  constexpr a2jmidi::TimePoint period = 480; // 10 ms
+  constexpr a2jmidi::TimePoint now = 100000;
+  // the events of the period that starts now.
+  EXPECT_EQ(sendDelay(now, now, period, sampleRate), 10ms);
+  EXPECT_EQ(sendDelay(now + 48, now, period, sampleRate), 11ms);
+  EXPECT_EQ(sendDelay(now + period / 2, now, period, sampleRate), 15ms);
+}
+
+/**
+ * The events of the input port are stamped from the start of the period, not from the
+ * deadline; the sender thread then sends them one period after their position.
+ */
+TEST(A2jmidiJ2aTest, eventTimeThroughSendDelay) {
+  using a2jmidi::j2a::eventTime;
+  using a2jmidi::j2a::sendDelay;
+  constexpr int sampleRate = 48000;
+  constexpr a2jmidi::TimePoint period = 480; // 10 ms
+  constexpr a2jmidi::TimePoint jitterCompensation = 16;
+  constexpr a2jmidi::TimePoint periodStart = 100000;
+  constexpr a2jmidi::TimePoint deadline = periodStart - jitterCompensation;
+  EXPECT_EQ(eventTime(deadline, jitterCompensation, 0), periodStart);
+  EXPECT_EQ(eventTime(deadline, jitterCompensation, 240), periodStart + 240);
+  // the sender thread wakes up 1 ms after the start of the period.
+  constexpr a2jmidi::TimePoint now = periodStart + 48;
+  EXPECT_EQ(sendDelay(eventTime(deadline, jitterCompensation, 0), now, period, sampleRate), 9ms);
+  EXPECT_EQ(sendDelay(eventTime(deadline, jitterCompensation, 240), now, period, sampleRate),
+            14ms);
+  EXPECT_EQ(sendDelay(eventTime(deadline, jitterCompensation, 432), now, period, sampleRate),
+            18ms);
+}
+
+/**
+ * Events that are already late are sent at once.
+ */
+TEST(A2jmidiJ2aTest, sendDelayLateEvents) {
+  using a2jmidi::j2a::sendDelay;
+  EXPECT_EQ(sendDelay(1000, 5000, 480, 48000), 0ns);
+  EXPECT_EQ(sendDelay(5000, 5000, 480, 0), 0ns);
+}
+
+} // namespace unitTests
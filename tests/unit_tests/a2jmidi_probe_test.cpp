@@ -0,0 +1,79 @@
+/*
+ * File: a2jmidi_probe_test.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "a2jmidi_probe.h"
+
+#include "gtest/gtest.h"
+
+namespace unitTests {
+
+class A2jmidiProbeTest : public ::testing::Test {};
+
+/**
+ * Minimum, mean, percentile, maximum and jitter of a known series.
+ */
+TEST_F(A2jmidiProbeTest, computeStatistics) {
+  using namespace a2jmidi::probe;
+  std::vector<a2jmidi::TimePoint> latencies;
+  for (int i = 100; i >= 1; i--) {
+    latencies.push_back(i);
+  }
+  LatencyStatistics result = computeStatistics(latencies, 3);
+  EXPECT_EQ(result.count, 100);
+  EXPECT_EQ(result.lost, 3);
+  EXPECT_DOUBLE_EQ(result.min, 1);
+  EXPECT_DOUBLE_EQ(result.mean, 50.5);
+  EXPECT_DOUBLE_EQ(result.p99, 99);
+  EXPECT_DOUBLE_EQ(result.max, 100);
+  EXPECT_NEAR(result.jitter, 28.866, 0.001);
+
+  LatencyStatistics empty = computeStatistics({}, 5);
+  EXPECT_EQ(empty.count, 0);
+  EXPECT_EQ(empty.lost, 5);
+  EXPECT_DOUBLE_EQ(empty.max, 0);
+}
+
+/**
+ * Each received probe is compared with the time it was sent; late answers to
+ * earlier probes are ignored.
+ */
+TEST_F(A2jmidiProbeTest, recordProbes) {
+  using namespace a2jmidi::probe;
+  prepare(3);
+  unsigned char key0 = recordSent(0, 1000);
+  recordReceived(key0, 1100);
+  EXPECT_EQ(receivedCount(), 1);
+
+  unsigned char key1 = recordSent(1, 2000);
+  EXPECT_NE(key0, key1);
+  recordReceived(key0, 2050); // a duplicate of the first probe.
+  EXPECT_EQ(receivedCount(), 1);
+  recordReceived(key1, 2300);
+  recordReceived(key1, 2400); // already counted.
+  EXPECT_EQ(receivedCount(), 2);
+
+  recordSent(2, 3000); // never received.
+  LatencyStatistics result = statistics(3);
+  EXPECT_EQ(result.count, 2);
+  EXPECT_EQ(result.lost, 1);
+  EXPECT_DOUBLE_EQ(result.min, 100);
+  EXPECT_DOUBLE_EQ(result.max, 300);
+}
+
+} // namespace unitTests
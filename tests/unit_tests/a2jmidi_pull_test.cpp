@@ -0,0 +1,78 @@
+/*
+ * File: a2jmidi_pull_test.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "a2jmidi_pull.h"
+#include "alsa_helper.h"
+#include "gtest/gtest.h"
+#include <chrono>
+#include <thread>
+
+namespace unitTests {
+
+/**
+ * Events are positioned one period late; stale events are clamped or discarded.
+ */
+TEST(A2jmidiPullTest, positionInPeriod) {
+  using a2jmidi::pull::positionInPeriod;
+  EXPECT_EQ(positionInPeriod(1000, 900, 256), 156);
+  EXPECT_EQ(positionInPeriod(1000, 999, 256), 255);
+  EXPECT_EQ(positionInPeriod(1000, 1000, 256), 255); // received during this period, clamped.
+  EXPECT_EQ(positionInPeriod(1000, 744, 256), 0);
+  EXPECT_EQ(positionInPeriod(1000, 600, 256), 0);    // underrun, at the start of the buffer.
+  EXPECT_EQ(positionInPeriod(1000, 400, 256), -1);   // more than a period too old.
+}
+
+/**
+ * Events sent to the embedded receiver can be pulled, with offsets inside the buffer.
+ */
+TEST(A2jmidiPullTest, pullEvents) {
+  using namespace ::unitTestHelpers;
+  using namespace std::chrono;
+  AlsaHelper::openAlsaSequencer("sender");
+  auto emitterPort = AlsaHelper::createOutputPort("port");
+
+  // a frame counter that counts milliseconds.
+  auto start = steady_clock::now();
+  auto frameCounter = [start]() {
+    return static_cast<uint32_t>(duration_cast<milliseconds>(steady_clock::now() - start).count());
+  };
+  a2jmidi::pull::open("pullClient", {"sender:port"}, frameCounter);
+
+  constexpr int doubleNoteOns = 4;
+  AlsaHelper::sendEvents(emitterPort, doubleNoteOns, 10);
+  std::this_thread::sleep_for(20ms);
+
+  constexpr int nFrames = 10000;
+  int eventCount = 0;
+  int err = a2jmidi::pull::pull(frameCounter(), nFrames,
+                                [&](int offset, const alsaClient::PendingEvent &event) {
+                                  eventCount++;
+                                  EXPECT_EQ(event.size(), 3);
+                                  EXPECT_GE(offset, 0);
+                                  EXPECT_LT(offset, nFrames);
+                                  return 0;
+                                });
+  EXPECT_FALSE(err);
+  EXPECT_EQ(eventCount, 4 * doubleNoteOns);
+
+  a2jmidi::pull::close();
+  AlsaHelper::closeAlsaSequencer();
+}
+
+} // namespace unitTests
@@ -22,6 +22,7 @@
 #include "alsa_client.h"
 #include "alsa_helper.h"
 #include "spdlog/spdlog.h"
+#include <atomic>
 #include <thread>
 
 #include "gmock/gmock.h"
@@ -297,6 +298,42 @@ TEST_F(AlsaClientImplTest, matchCombinationExactPortName) {
                         requestedProfile);
   EXPECT_TRUE(result);
 }
+/**
+ * The automatic mode bridges the ports whose capabilities and client kind pass the filter,
+ * but never the system client, this client or ports that do not want to be exported.
+ */
+TEST_F(AlsaClientImplTest, autoMatchesFilter) {
+  using namespace ::alsaClient;
+  using namespace ::alsaClient::impl;
+  constexpr int ownClient{128};
+  constexpr unsigned int hardware{SND_SEQ_PORT_TYPE_MIDI_GENERIC | SND_SEQ_PORT_TYPE_HARDWARE};
+  constexpr unsigned int software{SND_SEQ_PORT_TYPE_MIDI_GENERIC | SND_SEQ_PORT_TYPE_SOFTWARE};
+  constexpr auto kernel{SND_SEQ_KERNEL_CLIENT};
+  constexpr auto user{SND_SEQ_USER_CLIENT};
+  AutoFilter filter; // hardware by default.
+  auto passes = [&filter](PortCaps caps, unsigned int type, snd_seq_client_type_t client,
+                          PortID port) {
+    return autoMatches(filter, caps, type, client, port, ownClient);
+  };
+
+  EXPECT_TRUE(passes(SENDER_PORT, hardware, kernel, {24, 0}));
+  // "Midi Through" is a kernel client, but not hardware.
+  EXPECT_FALSE(passes(SENDER_PORT, software, kernel, {14, 0}));
+  EXPECT_FALSE(passes(SENDER_PORT, software, user, {129, 0}));
+  EXPECT_FALSE(passes(RECEIVER_PORT, hardware, kernel, {24, 0}));
+  EXPECT_FALSE(passes(SENDER_PORT | SND_SEQ_PORT_CAP_NO_EXPORT, hardware, kernel, {24, 0}));
+
+  filter.clientKind = ClientKind::software;
+  EXPECT_TRUE(passes(SENDER_PORT, software, user, {129, 0}));
+  EXPECT_FALSE(passes(SENDER_PORT, hardware, kernel, {24, 0}));
+  EXPECT_FALSE(passes(SENDER_PORT, software, user, {ownClient, 0}));
+
+  filter.clientKind = ClientKind::all;
+  EXPECT_TRUE(passes(SENDER_PORT, software, kernel, {14, 0}));
+  EXPECT_FALSE(passes(SENDER_PORT, 0, kernel,
+                      {SND_SEQ_CLIENT_SYSTEM, SND_SEQ_PORT_SYSTEM_ANNOUNCE}));
+}
+
 /**
  * Lets use our find and match function together..
  */
@@ -353,6 +390,85 @@ TEST_F(AlsaClientImplTest, invokeMonitorConnections) {
   alsaClient::close();
 }
 
+/**
+ * The connections are checked once before `activate` returns.
+ */
+TEST_F(AlsaClientImplTest, monitorConnectionsOnActivate) {
+  using namespace ::alsaClient;
+  using namespace ::unitTestHelpers;
+
+  int invocationCount = 0;
+  alsaClient::onMonitorConnections(
+      [&invocationCount](const std::string &connectTo, const PortID &currentPort) -> PortID {
+        invocationCount++;
+        return NULL_PORT_ID;
+      });
+
+  alsaClient::open("monitorConnectionsOnActivate");
+  alsaClient::activate(AlsaHelper::clock());
+  EXPECT_EQ(invocationCount, 1);
+
+  alsaClient::stop();
+  alsaClient::close();
+  alsaClient::onMonitorConnections(nullptr);
+}
+
+/**
+ * Replacing the connect targets again and again does not accumulate the replaced lists.
+ */
+TEST_F(AlsaClientImplTest, reclaimReplacedSources) {
+  using namespace ::alsaClient;
+  using namespace ::unitTestHelpers;
+
+  alsaClient::open("reclaimReplacedSources");
+  alsaClient::newReceiverPort("in", std::vector<std::string>{"Midi Through Port-0"});
+  alsaClient::activate(AlsaHelper::clock());
+  for (int i = 0; i < 50; i++) {
+    alsaClient::setConnectTargets({"Midi Through Port-0", "source-" + std::to_string(i)});
+  }
+  // no real-time thread is reading, so the replaced lists are reclaimed at once.
+  EXPECT_EQ(sourceListCount(), 1u);
+  auto statistics = alsaClient::sourceStatistics();
+  ASSERT_EQ(statistics.size(), 2u);
+  EXPECT_EQ(statistics[0].designation, "Midi Through Port-0");
+  EXPECT_EQ(statistics[0].connectCount, 1);
+  EXPECT_EQ(statistics[1].designation, "source-49");
+
+  alsaClient::stop();
+  alsaClient::close();
+}
+
+/**
+ * Quick cycles of `activate` and `stop` leave no monitoring thread behind.
+ */
+TEST_F(AlsaClientImplTest, fastActivateStopCycles) {
+  using namespace ::alsaClient;
+  using namespace ::unitTestHelpers;
+
+  std::atomic<int> invocationCount{0};
+  alsaClient::onMonitorConnections(
+      [&invocationCount](const std::string &connectTo, const PortID &currentPort) -> PortID {
+        invocationCount++;
+        return NULL_PORT_ID;
+      });
+
+  alsaClient::open("fastActivateStopCycles");
+  for (int i = 0; i < 20; i++) {
+    alsaClient::activate(AlsaHelper::clock());
+    EXPECT_EQ(alsaClient::state(), State::running);
+    alsaClient::stop();
+    EXPECT_EQ(alsaClient::state(), State::idle);
+  }
+  // at least one check per activation, and none once stopped.
+  int countWhenStopped = invocationCount;
+  EXPECT_GE(countWhenStopped, 20);
+  std::this_thread::sleep_for(2 * MONITOR_INTERVAL);
+  EXPECT_EQ(invocationCount, countWhenStopped);
+
+  alsaClient::close();
+  alsaClient::onMonitorConnections(nullptr);
+}
+
 } // namespace unitTests
 
 #pragma clang diagnostic pop
\ No newline at end of file
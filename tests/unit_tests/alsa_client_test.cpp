@@ -20,6 +20,9 @@
 #include "alsa_client.h"
 #include "spdlog/spdlog.h"
 #include "gtest/gtest.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <thread>
 
 #include "alsa_helper.h"
@@ -116,6 +119,28 @@ TEST_F(AlsaClientTest, createPortEmptyNames) {
   alsaClient::close();
 }
 
+/**
+ * The size of the kernel input pool can be set while the client is idle.
+ */
+TEST_F(AlsaClientTest, setInputPool) {
+  alsaClient::InputPool inputPool;
+  EXPECT_THROW(alsaClient::setInputPool(inputPool), alsaClient::BadStateException);
+  EXPECT_EQ(alsaClient::inputPoolSize(), 0);
+
+  alsaClient::open("unitTestAlsaDevice");
+  inputPool.poolSize = 1000;
+  inputPool.bufferSize = 64 * 1024;
+  alsaClient::setInputPool(inputPool);
+  EXPECT_EQ(alsaClient::inputPoolSize(), 1000);
+
+  // the kernel does not accept pools beyond `MAX_INPUT_POOL`.
+  inputPool.poolSize = 10 * alsaClient::MAX_INPUT_POOL;
+  alsaClient::setInputPool(inputPool);
+  EXPECT_EQ(alsaClient::inputPoolSize(), alsaClient::MAX_INPUT_POOL);
+
+  alsaClient::close();
+}
+
 /**
  * The receiverQueue can be started and can be stopped.
  */
@@ -136,6 +161,38 @@ TEST_F(AlsaClientTest, startStop) {
   EXPECT_EQ(alsaClient::state(), alsaClient::State::closed);
 }
 
+/**
+ * `retrieve` does not wait while the client is being started or stopped
+ * (stopping the receiver queue alone takes more than 20 ms).
+ */
+TEST_F(AlsaClientTest, retrieveDuringStartStop) {
+  using namespace ::unitTestHelpers;
+  using namespace std::chrono_literals;
+  alsaClient::open("unitTestAlsaDevice");
+
+  std::atomic<bool> carryOn{true};
+  std::chrono::steady_clock::duration longestCall{0};
+  std::thread realTimeThread{[&]() {
+    auto ignore = [](const midi::Event &, a2jmidi::TimePoint) { return 0; };
+    while (carryOn) {
+      auto start = std::chrono::steady_clock::now();
+      alsaClient::retrieve(0, ignore);
+      longestCall = std::max(longestCall, std::chrono::steady_clock::now() - start);
+      std::this_thread::sleep_for(100us);
+    }
+  }};
+
+  for (int i = 0; i < 3; i++) {
+    alsaClient::activate(AlsaHelper::clock());
+    alsaClient::stop();
+  }
+  carryOn = false;
+  realTimeThread.join();
+  EXPECT_LT(longestCall, 10ms);
+
+  alsaClient::close();
+}
+
 /**
  * The receiverQueue can receive events.
  */
@@ -175,6 +232,193 @@ TEST_F(AlsaClientTest, processEvents) {
   alsaClient::close();
   unitTestHelpers::AlsaHelper::closeAlsaSequencer();
 }
+/**
+ * The receiver port can connect to several sender ports. Events are counted per source.
+ */
+TEST_F(AlsaClientTest, processEventsSeveralSources) {
+  using namespace ::unitTestHelpers;
+  using namespace std::chrono_literals;
+  AlsaHelper::openAlsaSequencer("sender");
+  auto emitterPort1 = AlsaHelper::createOutputPort("port1");
+  auto emitterPort2 = AlsaHelper::createOutputPort("port2");
+
+  alsaClient::open("testClient");
+  alsaClient::newReceiverPort("testPort", std::vector<std::string>{"sender:port1", "sender:port2"});
+  alsaClient::activate(AlsaHelper::clock());
+  std::this_thread::sleep_for(2 * alsaClient::MONITOR_INTERVAL);
+  EXPECT_EQ(alsaClient::receiverPortGetConnections().size(), 2);
+
+  constexpr int doubleNoteOns = 2;
+  AlsaHelper::sendEvents(emitterPort1, doubleNoteOns, 20);
+  AlsaHelper::sendEvents(emitterPort2, 2 * doubleNoteOns, 20);
+  auto stopTime = AlsaHelper::clock()->now() + 1000;
+
+  int noteCount = 0;
+  a2jmidi::TimePoint previous = 0;
+  auto processMidi = [&](const midi::Event &event, a2jmidi::TimePoint timeStamp) -> int {
+    noteCount++;
+    EXPECT_GE(timeStamp, previous); // events from all sources are in the order of arrival.
+    previous = timeStamp;
+    return 0;
+  };
+  EXPECT_FALSE(alsaClient::retrieve(stopTime, processMidi));
+  EXPECT_EQ(noteCount, 3 * doubleNoteOns * 4);
+
+  auto statistics = alsaClient::sourceStatistics();
+  ASSERT_EQ(statistics.size(), 2);
+  EXPECT_EQ(statistics[0].designation, "sender:port1");
+  EXPECT_EQ(statistics[0].eventCount, doubleNoteOns * 4);
+  EXPECT_EQ(statistics[0].connectCount, 1);
+  EXPECT_EQ(statistics[1].designation, "sender:port2");
+  EXPECT_EQ(statistics[1].eventCount, 2 * doubleNoteOns * 4);
+  EXPECT_LE(statistics[0].lastArrival, statistics[1].lastArrival);
+  EXPECT_EQ(alsaClient::otherSourcesEventCount(), 0);
+
+  alsaClient::close();
+  AlsaHelper::closeAlsaSequencer();
+}
+/**
+ * A latency offset holds the events of its source back; a retrieve up to the shifted time
+ * delivers them, with the shifted time stamps.
+ */
+TEST_F(AlsaClientTest, latencyOffsets) {
+  using namespace ::unitTestHelpers;
+  using namespace std::chrono_literals;
+  AlsaHelper::openAlsaSequencer("sender");
+  auto emitterPort1 = AlsaHelper::createOutputPort("port1");
+  auto emitterPort2 = AlsaHelper::createOutputPort("port2");
+
+  alsaClient::open("testClient");
+  alsaClient::newReceiverPort("testPort", std::vector<std::string>{"sender:port1", "sender:port2"});
+  constexpr a2jmidi::TimePoint offset{1000000};
+  alsaClient::setLatencyOffsets({{"sender:port1", offset}});
+  alsaClient::activate(AlsaHelper::clock());
+  EXPECT_THROW(alsaClient::setLatencyOffsets({}), alsaClient::BadStateException);
+  std::this_thread::sleep_for(2 * alsaClient::MONITOR_INTERVAL);
+
+  constexpr int doubleNoteOns = 2;
+  auto startTime = AlsaHelper::clock()->now();
+  AlsaHelper::sendEvents(emitterPort1, doubleNoteOns, 20);
+  AlsaHelper::sendEvents(emitterPort2, doubleNoteOns, 20);
+  auto stopTime = AlsaHelper::clock()->now() + 1000;
+
+  int noteCount = 0;
+  a2jmidi::TimePoint previous = 0;
+  auto processMidi = [&](const midi::Event &event, a2jmidi::TimePoint timeStamp) -> int {
+    noteCount++;
+    EXPECT_GE(timeStamp, previous);
+    previous = timeStamp;
+    return 0;
+  };
+  // only the events of port2 are due.
+  EXPECT_FALSE(alsaClient::retrieve(stopTime, processMidi));
+  EXPECT_EQ(noteCount, doubleNoteOns * 4);
+  EXPECT_LT(previous, startTime + offset);
+
+  EXPECT_FALSE(alsaClient::retrieve(stopTime + offset, processMidi));
+  EXPECT_EQ(noteCount, 2 * doubleNoteOns * 4);
+  EXPECT_GE(previous, startTime + offset);
+
+  alsaClient::close();
+  AlsaHelper::closeAlsaSequencer();
+}
+/**
+ * With `retrieveDirect`, the size and the status of each event are known before its bytes
+ * are written. SysEx messages are passed on completely, whatever their length.
+ */
+TEST_F(AlsaClientTest, retrieveDirect) {
+  using namespace ::unitTestHelpers;
+  AlsaHelper::openAlsaSequencer("sender");
+  auto emitterPort = AlsaHelper::createOutputPort("port");
+
+  alsaClient::open("testClient");
+  alsaClient::newReceiverPort("testPort", "sender:port");
+  alsaClient::activate(AlsaHelper::clock());
+
+  constexpr int doubleNoteOns = 2;
+  AlsaHelper::sendEvents(emitterPort, doubleNoteOns, 20);
+  std::vector<unsigned char> sysex(100, 0x55);
+  sysex.front() = 0xF0;
+  sysex.back() = 0xF7;
+  AlsaHelper::sendSysexEvent(emitterPort, sysex);
+  auto stopTime = AlsaHelper::clock()->now() + 1000;
+
+  int noteCount = 0;
+  int sysexCount = 0;
+  auto processMidi = [&](const alsaClient::PendingEvent &event,
+                         a2jmidi::TimePoint timeStamp) -> int {
+    std::vector<unsigned char> bytes(event.size());
+    event.writeTo(bytes.data());
+    EXPECT_EQ(bytes[0], event.status());
+    if (event.status() == 0xF0) {
+      sysexCount++;
+      EXPECT_EQ(bytes, sysex);
+    } else {
+      noteCount++;
+      EXPECT_EQ(event.size(), 3);
+    }
+    return 0;
+  };
+  EXPECT_FALSE(alsaClient::retrieveDirect(stopTime, processMidi));
+  EXPECT_EQ(noteCount, doubleNoteOns * 4);
+  EXPECT_EQ(sysexCount, 1);
+
+  alsaClient::close();
+  AlsaHelper::closeAlsaSequencer();
+}
+/**
+ * A rawmidi input delivers the messages of a hardware port, the running status of the
+ * byte stream is resolved. The test uses a virtual device provided by `snd-virmidi`
+ * (`sudo modprobe snd-virmidi`).
+ */
+TEST_F(AlsaClientTest, rawMidiInput) {
+  using namespace ::unitTestHelpers;
+  AlsaHelper::openAlsaSequencer("sender");
+  std::string device;
+  int virmidiClient;
+  int virmidiPort;
+  if (!AlsaHelper::findVirmidi(device, virmidiClient, virmidiPort)) {
+    AlsaHelper::closeAlsaSequencer();
+    GTEST_SKIP() << "snd-virmidi is not loaded.";
+  }
+  auto emitterPort = AlsaHelper::createOutputPort("port");
+  AlsaHelper::connectToExternalPort(emitterPort, virmidiClient, virmidiPort);
+
+  alsaClient::open("testClient");
+  alsaClient::newRawMidiInput(device);
+  EXPECT_THROW(alsaClient::newReceiverPort("testPort"), alsaClient::ServerException);
+  alsaClient::activate(AlsaHelper::clock());
+
+  constexpr int doubleNoteOns = 3;
+  AlsaHelper::sendEvents(emitterPort, doubleNoteOns, 20);
+  std::vector<unsigned char> sysex(100, 0x55);
+  sysex.front() = 0xF0;
+  sysex.back() = 0xF7;
+  AlsaHelper::sendSysexEvent(emitterPort, sysex);
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  auto stopTime = AlsaHelper::clock()->now();
+
+  int noteCount = 0;
+  int sysexCount = 0;
+  auto processMidi = [&](const midi::Event &event, a2jmidi::TimePoint timeStamp) -> int {
+    if (event[0] == 0xF0) {
+      sysexCount++;
+      EXPECT_EQ(event, sysex);
+    } else {
+      noteCount++;
+      EXPECT_EQ(event.size(), 3);
+      EXPECT_TRUE(midi::isChannelMessage(event[0]));
+    }
+    return 0;
+  };
+  EXPECT_FALSE(alsaClient::retrieve(stopTime, processMidi));
+  EXPECT_EQ(noteCount, doubleNoteOns * 4);
+  EXPECT_EQ(sysexCount, 1);
+
+  alsaClient::close();
+  AlsaHelper::closeAlsaSequencer();
+}
+
 /**
  * the receiver queue is not processed further
  * once an error has been flagged in the `forEachClosure`.
@@ -208,4 +452,45 @@ TEST_F(AlsaClientTest, processEventsError) {
   alsaClient::close();
   unitTestHelpers::AlsaHelper::closeAlsaSequencer();
 }
+
+/**
+ * In UMP mode, the kernel converts the events of a legacy sender into MIDI 2.0 packets;
+ * they are translated back into the original MIDI 1.0 bytes.
+ * Skipped where alsa-lib or the kernel have no UMP support.
+ */
+TEST_F(AlsaClientTest, umpLoopback) {
+  using namespace ::unitTestHelpers;
+
+  AlsaHelper::openAlsaSequencer("sender");
+  auto emitterPort = AlsaHelper::createOutputPort("port");
+
+  alsaClient::open("testClient");
+  try {
+    alsaClient::enableUmp();
+  } catch (const alsaClient::ServerException &error) {
+    alsaClient::close();
+    AlsaHelper::closeAlsaSequencer();
+    GTEST_SKIP() << error.what();
+  }
+  alsaClient::newReceiverPort("testPort", "sender:port");
+  alsaClient::activate(AlsaHelper::clock());
+
+  constexpr int doubleNoteOns = 4;
+  AlsaHelper::sendEvents(emitterPort, doubleNoteOns, 20);
+  auto stopTime = AlsaHelper::clock()->now() + 1000;
+
+  std::vector<midi::Event> received;
+  int err = alsaClient::retrieve(stopTime, [&](const midi::Event &event, a2jmidi::TimePoint) {
+    received.push_back(event);
+    return 0;
+  });
+
+  EXPECT_FALSE(err);
+  ASSERT_EQ(received.size(), 4 * doubleNoteOns);
+  EXPECT_EQ(received[0], (midi::Event{0x90, 60, 64}));
+  EXPECT_EQ(received[1], (midi::Event{0x90, 67, 64}));
+  EXPECT_EQ(received[2], (midi::Event{0x80, 67, 0}));
+  alsaClient::close();
+  AlsaHelper::closeAlsaSequencer();
+}
 } // namespace unitTests
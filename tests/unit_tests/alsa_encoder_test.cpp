@@ -0,0 +1,159 @@
+/*
+ * File: alsa_encoder_test.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "alsa_encoder.h"
+
+#include "gtest/gtest.h"
+#include <vector>
+
+namespace unitTests {
+/***
+ * Testing the module `alsaClient::encoder`. The reference is `snd_midi_event_decode()`
+ * configured the way the `alsaClient` uses it (no running status).
+ */
+class AlsaEncoderTest : public ::testing::Test {
+protected:
+  static constexpr int BUFFER_SIZE = 16;
+  snd_midi_event_t *m_decoder{nullptr};
+
+  void SetUp() override {
+    ASSERT_EQ(snd_midi_event_new(BUFFER_SIZE, &m_decoder), 0);
+    snd_midi_event_init(m_decoder);
+    snd_midi_event_no_status(m_decoder, 1);
+  }
+
+  void TearDown() override { snd_midi_event_free(m_decoder); }
+
+  /**
+   * The bytes produced by alsa-lib.
+   */
+  std::vector<unsigned char> decode(const snd_seq_event_t &event) {
+    unsigned char buffer[BUFFER_SIZE];
+    long length = snd_midi_event_decode(m_decoder, buffer, BUFFER_SIZE, &event);
+    if (length <= 0) {
+      return {};
+    }
+    return std::vector<unsigned char>(buffer, buffer + length);
+  }
+
+  /**
+   * The bytes produced by the fast path.
+   */
+  static std::vector<unsigned char> encode(const snd_seq_event_t &event) {
+    unsigned char buffer[alsaClient::encoder::MAX_FAST_EVENT_SIZE];
+    int length = alsaClient::encoder::encode(event, buffer);
+    return std::vector<unsigned char>(buffer, buffer + length);
+  }
+
+  /**
+   * Create an event of the given type with the given raw field values.
+   */
+  static snd_seq_event_t makeEvent(int type, unsigned char channel, unsigned char note,
+                                   unsigned char velocity) {
+    snd_seq_event_t event;
+    snd_seq_ev_clear(&event);
+    event.type = type;
+    event.data.note.channel = channel;
+    event.data.note.note = note;
+    event.data.note.velocity = velocity;
+    return event;
+  }
+  static snd_seq_event_t makeControlEvent(int type, unsigned char channel, unsigned int param,
+                                          int value) {
+    snd_seq_event_t event;
+    snd_seq_ev_clear(&event);
+    event.type = type;
+    event.data.control.channel = channel;
+    event.data.control.param = param;
+    event.data.control.value = value;
+    return event;
+  }
+};
+
+/**
+ * Note events: every channel, note and velocity (including out-of-range values that
+ * alsa-lib masks).
+ */
+TEST_F(AlsaEncoderTest, noteEvents) {
+  for (int type : {SND_SEQ_EVENT_NOTEOFF, SND_SEQ_EVENT_NOTEON, SND_SEQ_EVENT_KEYPRESS}) {
+    for (int channel = 0; channel < 256; channel += 5) {
+      for (int note = 0; note < 256; note++) {
+        for (int velocity = 0; velocity < 256; velocity += 3) {
+          auto event = makeEvent(type, channel, note, velocity);
+          ASSERT_EQ(encode(event), decode(event))
+              << "type " << type << ", channel " << channel << ", note " << note;
+        }
+      }
+    }
+  }
+}
+
+/**
+ * Controller, program change and channel pressure over a wide range of parameters and values.
+ */
+TEST_F(AlsaEncoderTest, controlEvents) {
+  for (int type : {SND_SEQ_EVENT_CONTROLLER, SND_SEQ_EVENT_PGMCHANGE, SND_SEQ_EVENT_CHANPRESS}) {
+    for (int channel = 0; channel < 256; channel += 7) {
+      for (unsigned int param = 0; param < 300; param++) {
+        for (int value = -300; value < 300; value += 11) {
+          auto event = makeControlEvent(type, channel, param, value);
+          ASSERT_EQ(encode(event), decode(event))
+              << "type " << type << ", param " << param << ", value " << value;
+        }
+      }
+    }
+  }
+}
+
+/**
+ * Pitch bend over its whole range and beyond.
+ */
+TEST_F(AlsaEncoderTest, pitchBendEvents) {
+  for (int channel = 0; channel < 16; channel++) {
+    for (int value = -20000; value < 20000; value++) {
+      auto event = makeControlEvent(SND_SEQ_EVENT_PITCHBEND, channel, 0, value);
+      ASSERT_EQ(encode(event), decode(event)) << "value " << value;
+    }
+  }
+}
+
+/**
+ * For every event type, the fast path either declines or agrees with alsa-lib.
+ */
+TEST_F(AlsaEncoderTest, allEventTypes) {
+  int fastTypes = 0;
+  for (int type = 0; type < alsaClient::encoder::EVENT_TYPE_COUNT; type++) {
+    auto event = makeControlEvent(type, 3, 64, 100);
+    unsigned char buffer[alsaClient::encoder::MAX_FAST_EVENT_SIZE];
+    if (alsaClient::encoder::encode(event, buffer) == 0) {
+      EXPECT_FALSE(alsaClient::encoder::hasFastPath(event));
+      continue;
+    }
+    fastTypes++;
+    EXPECT_TRUE(alsaClient::encoder::hasFastPath(event));
+    auto expected = decode(event);
+    EXPECT_EQ(encode(event), expected) << "type " << type;
+    // the size and the status byte are known before encoding.
+    EXPECT_EQ(alsaClient::encoder::sizeOf(event), expected.size());
+    EXPECT_EQ(alsaClient::encoder::statusOf(event), expected[0]);
+  }
+  EXPECT_EQ(fastTypes, 7);
+}
+
+} // namespace unitTests
@@ -19,6 +19,7 @@
 #include "alsa_helper.h"
 #include "spdlog/spdlog.h"
 #include <chrono>
+#include <regex>
 #include <stdexcept>
 #include <sys_clock.h>
 #include <thread>
@@ -171,6 +172,41 @@ void AlsaHelper::connectExternalPort(int externalClientId, int hExternalPort, in
   SPDLOG_TRACE("AlsaHelper::connectExternalPort - ExternalPort {}:{} connected to ReceiverPort {}.",
                externalClientId, hExternalPort, hReceiverPort);
 }
+void AlsaHelper::connectToExternalPort(int hEmitterPort, int externalClientId, int hExternalPort) {
+  auto err = snd_seq_connect_to(g_hSequencer, hEmitterPort, externalClientId, hExternalPort);
+  checkAlsa("connectToExternalPort", err);
+
+  SPDLOG_TRACE("AlsaHelper::connectToExternalPort - EmitterPort {} connected to {}:{}.",
+               hEmitterPort, externalClientId, hExternalPort);
+}
+
+bool AlsaHelper::findVirmidi(std::string &device, int &clientId, int &hPort) {
+  snd_seq_client_info_t *clientInfo;
+  snd_seq_port_info_t *portInfo;
+  snd_seq_client_info_alloca(&clientInfo);
+  snd_seq_port_info_alloca(&portInfo);
+  // the sequencer clients of snd-virmidi are named "Virtual Raw MIDI <card>-<device>".
+  std::regex virmidiName{"^Virtual Raw MIDI ([0-9]+)-([0-9]+)$"};
+
+  snd_seq_client_info_set_client(clientInfo, -1);
+  while (snd_seq_query_next_client(g_hSequencer, clientInfo) >= 0) {
+    std::string name{snd_seq_client_info_get_name(clientInfo)};
+    std::smatch match;
+    if (!std::regex_match(name, match, virmidiName)) {
+      continue;
+    }
+    snd_seq_port_info_set_client(portInfo, snd_seq_client_info_get_client(clientInfo));
+    snd_seq_port_info_set_port(portInfo, -1);
+    if (snd_seq_query_next_port(g_hSequencer, portInfo) >= 0) {
+      device = "hw:" + match[1].str() + "," + match[2].str();
+      clientId = snd_seq_port_info_get_client(portInfo);
+      hPort = snd_seq_port_info_get_port(portInfo);
+      return true;
+    }
+  }
+  return false;
+}
+
 /**
  * Sends Midi events through the given emitter port.
  *
@@ -236,6 +272,49 @@ void AlsaHelper::sendEvents(int hEmitterPort, int eventCount, long intervalMs) {
   }
 }
 
+/**
+ * Sends a burst of controller events (CC 1 on channel zero) through the given emitter port.
+ *
+ * The controller value is incremented with each event (modulo 128).
+ * @param hEmitterPort the port-number of the emitter port.
+ * @param eventCount the number of events to send.
+ */
+void AlsaHelper::sendControllerEvents(int hEmitterPort, int eventCount) {
+  SPDLOG_TRACE("AlsaHelper::sendControllerEvents");
+
+  snd_seq_event_t evController;
+  snd_seq_ev_clear(&evController);
+  snd_seq_ev_set_subs(&evController);
+  snd_seq_ev_set_direct(&evController);
+  snd_seq_ev_set_source(&evController, hEmitterPort);
+
+  for (int i = 0; i < eventCount; ++i) {
+    snd_seq_ev_set_controller(&evController, 0, 1, i % 128);
+    auto err = snd_seq_event_output(g_hSequencer, &evController);
+    checkAlsa("snd_seq_event_output", err);
+  }
+  auto err = snd_seq_drain_output(g_hSequencer);
+  checkAlsa("snd_seq_drain_output", err);
+  // give the receiver some time to pick up the events.
+  std::this_thread::sleep_for(std::chrono::milliseconds(SHUTDOWN_POLL_PERIOD_MS));
+}
+
+void AlsaHelper::sendSysexEvent(int hEmitterPort, const std::vector<unsigned char> &sysex) {
+  SPDLOG_TRACE("AlsaHelper::sendSysexEvent");
+
+  snd_seq_event_t evSysex;
+  snd_seq_ev_clear(&evSysex);
+  snd_seq_ev_set_subs(&evSysex);
+  snd_seq_ev_set_direct(&evSysex);
+  snd_seq_ev_set_source(&evSysex, hEmitterPort);
+  snd_seq_ev_set_sysex(&evSysex, sysex.size(), const_cast<unsigned char *>(sysex.data()));
+
+  auto err = snd_seq_event_output_direct(g_hSequencer, &evSysex);
+  checkAlsa("snd_seq_event_output_direct", err);
+  // give the receiver some time to pick up the event.
+  std::this_thread::sleep_for(std::chrono::milliseconds(SHUTDOWN_POLL_PERIOD_MS));
+}
+
 int AlsaHelper::retrieveEvents() {
   SPDLOG_TRACE("AlsaHelper::retrieveEvents");
   snd_seq_event_t *ev;
@@ -319,7 +398,7 @@ public:
    * The estimated current time in microseconds ticks.
    * @return the estimated current time in in nanosecond ticks.
    */
-  long now() override {
+  a2jmidi::TimePoint now() override {
     auto sysNow = sysClock::now().time_since_epoch();
     return std::chrono::duration_cast<std::chrono::microseconds>(sysNow).count();
   }
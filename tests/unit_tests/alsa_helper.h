@@ -22,6 +22,7 @@
 #include <a2jmidi_clock.h>
 #include <alsa/asoundlib.h>
 #include <future>
+#include <vector>
 
 namespace unitTestHelpers {
 
@@ -113,6 +114,23 @@ public:
    * @param hReceiverPort the port-number of the internal input-port.
    */
   static void connectExternalPort(int externalClientId, int hExternalPort, int hReceiverPort);
+  /**
+   * Connect an internal output-port to an external port.
+   * @param hEmitterPort the port-number of the internal output-port.
+   * @param externalClientId the client id of the external device.
+   * @param hExternalPort the port-number of the external port.
+   */
+  static void connectToExternalPort(int hEmitterPort, int externalClientId, int hExternalPort);
+  /**
+   * Search for a virtual rawmidi device (as provided by the `snd-virmidi` kernel module).
+   *
+   * Events written to the sequencer port of such a device can be read from its rawmidi input.
+   * @param device - receives the rawmidi name of the device (for example "hw:2,0").
+   * @param clientId - receives the client id of the sequencer port of the device.
+   * @param hPort - receives the port-number of the sequencer port of the device.
+   * @return true if a device was found, false if `snd-virmidi` is not loaded.
+   */
+  static bool findVirmidi(std::string &device, int &clientId, int &hPort);
   /**
    * Sends Midi events through the given emitter port.
    * This call is blocking, control will be given back
@@ -122,6 +140,19 @@ public:
    * @param interval the time (in milliseconds) to wait between the sending of two events.
    */
   static void sendEvents(int hEmitterPort, int eventCount, long intervalMs);
+  /**
+   * Sends a burst of controller events (CC 1 on channel zero) through the given emitter port.
+   * All events are sent at once, without pausing in between.
+   * @param hEmitterPort the port-number of the emitter port.
+   * @param eventCount the number of events to be send.
+   */
+  static void sendControllerEvents(int hEmitterPort, int eventCount);
+  /**
+   * Sends a System Exclusive message through the given emitter port.
+   * @param hEmitterPort the port-number of the emitter port.
+   * @param sysex the complete message (including the leading 0xF0 and the trailing 0xF7).
+   */
+  static void sendSysexEvent(int hEmitterPort, const std::vector<unsigned char> &sysex);
   /**
    * Create a new Clock that works independently from the JACK server.
    * @return a smart pointer holding the clock.
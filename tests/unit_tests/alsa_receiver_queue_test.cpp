@@ -18,12 +18,18 @@
  */
 
 #include "alsa_receiver_queue.h"
+#include "frame_timeline.h"
 #include "sys_clock.h"
 
 #include "alsa_helper.h"
 #include "spdlog/spdlog.h"
 #include "gtest/gtest.h"
+#include <atomic>
+#include <cerrno>
+#include <limits>
+#include <memory>
 #include <thread>
+#include <vector>
 
 namespace unitTests {
 using namespace unitTestHelpers;
@@ -46,6 +52,8 @@ protected:
    */
   void SetUp() override {
     EXPECT_EQ(receiverQueue::getState(), receiverQueue::State::stopped);
+    // the watermarks of the previous tests shall not count.
+    receiverQueue::resetStatistics();
     AlsaHelper::openAlsaSequencer();
   }
 
@@ -53,6 +61,8 @@ protected:
    * Will be called immediately after each test.
    */
   void TearDown() override {
+    receiverQueue::setLimits(receiverQueue::Limits{});
+    receiverQueue::setIngestionMode(receiverQueue::IngestionMode::library);
     AlsaHelper::closeAlsaSequencer();
     EXPECT_EQ(receiverQueue::getState(), receiverQueue::State::stopped);
     // make sure we don't leak memory.
@@ -281,4 +291,362 @@ TEST_F(AlsaReceiverQueueTest, processStoppedQueue) {
   EXPECT_EQ(callbackCount, 0);
 }
 
+/**
+ * With the `dropNewest` policy, the queue does not grow beyond its ceiling and
+ * the events received first are kept.
+ */
+TEST_F(AlsaReceiverQueueTest, limitsDropNewest) {
+  namespace queue = receiverQueue; // a shorthand.
+  constexpr int maxEvents = 4;
+  queue::setLimits({maxEvents, queue::DEFAULT_MAX_BYTES, queue::OverflowPolicy::dropNewest});
+  auto droppedBefore = queue::getStatistics().droppedEventCount;
+
+  queue::start(AlsaHelper::getSequencerHandle(), AlsaHelper::clock());
+  auto emitterPort = AlsaHelper::createOutputPort("out");
+  auto receiverPort = AlsaHelper::createInputPort("in");
+  AlsaHelper::connectPorts(emitterPort, receiverPort);
+
+  constexpr int doubleNoteOns = 4; // results in 16 events
+  AlsaHelper::sendEvents(emitterPort, doubleNoteOns, 10);
+  auto statistics = queue::getStatistics();
+  EXPECT_LE(statistics.eventCount, maxEvents);
+  EXPECT_LE(statistics.highWatermarkEvents, maxEvents);
+  EXPECT_EQ(statistics.eventCount + statistics.droppedEventCount - droppedBefore,
+            doubleNoteOns * 4);
+
+  int noteOnCount = 0;
+  queue::process(AlsaHelper::clock()->now() + 100,
+                 ([&](const snd_seq_event_t &event, a2jmidi::TimePoint timeStamp) {
+                   if (event.type == SND_SEQ_EVENT_NOTEON) {
+                     noteOnCount++;
+                   }
+                 }));
+  // the two note-ons and the two note-offs of the first tranche are kept.
+  EXPECT_EQ(noteOnCount, 2);
+  EXPECT_EQ(queue::getStatistics().eventCount, 0);
+  queue::stop();
+}
+
+/**
+ * With the `dropOldest` policy, the queue does not grow beyond its ceiling and
+ * the events received last are kept.
+ */
+TEST_F(AlsaReceiverQueueTest, limitsDropOldest) {
+  namespace queue = receiverQueue; // a shorthand.
+  constexpr int maxEvents = 4;
+  queue::setLimits({maxEvents, queue::DEFAULT_MAX_BYTES, queue::OverflowPolicy::dropOldest});
+  auto droppedBefore = queue::getStatistics().droppedEventCount;
+
+  queue::start(AlsaHelper::getSequencerHandle(), AlsaHelper::clock());
+  auto emitterPort = AlsaHelper::createOutputPort("out");
+  auto receiverPort = AlsaHelper::createInputPort("in");
+  AlsaHelper::connectPorts(emitterPort, receiverPort);
+
+  constexpr int doubleNoteOns = 4; // results in 16 events
+  AlsaHelper::sendEvents(emitterPort, doubleNoteOns, 10);
+  auto statistics = queue::getStatistics();
+  EXPECT_LE(statistics.eventCount, maxEvents);
+  EXPECT_GT(statistics.droppedEventCount, droppedBefore);
+
+  snd_seq_event_type_t lastType = SND_SEQ_EVENT_NONE;
+  queue::process(AlsaHelper::clock()->now() + 100,
+                 ([&](const snd_seq_event_t &event, a2jmidi::TimePoint timeStamp) {
+                   lastType = event.type;
+                 }));
+  // the most recent event was a note-off.
+  EXPECT_EQ(lastType, SND_SEQ_EVENT_NOTEOFF);
+  queue::stop();
+}
+
+/**
+ * With the `coalesceControllers` policy, a burst of controller values is reduced and
+ * the queue does not grow beyond its ceiling.
+ */
+TEST_F(AlsaReceiverQueueTest, limitsCoalesceControllers) {
+  namespace queue = receiverQueue; // a shorthand.
+  constexpr int maxEvents = 4;
+  queue::setLimits(
+      {maxEvents, queue::DEFAULT_MAX_BYTES, queue::OverflowPolicy::coalesceControllers});
+
+  queue::start(AlsaHelper::getSequencerHandle(), AlsaHelper::clock());
+  auto emitterPort = AlsaHelper::createOutputPort("out");
+  auto receiverPort = AlsaHelper::createInputPort("in");
+  AlsaHelper::connectPorts(emitterPort, receiverPort);
+
+  constexpr int controllerCount = 100;
+  AlsaHelper::sendControllerEvents(emitterPort, controllerCount);
+  auto statistics = queue::getStatistics();
+  EXPECT_LE(statistics.eventCount, maxEvents);
+  EXPECT_EQ(statistics.eventCount + statistics.droppedEventCount +
+                statistics.coalescedEventCount,
+            controllerCount);
+  queue::stop();
+}
+
+/**
+ * Coalesced controller values are not counted as dropped: the latest value of the
+ * controller is still in the queue.
+ */
+TEST_F(AlsaReceiverQueueTest, coalescedAreNotDropped) {
+  namespace queue = receiverQueue; // a shorthand.
+  constexpr int maxEvents = 4;
+  queue::setLimits(
+      {maxEvents, queue::DEFAULT_MAX_BYTES, queue::OverflowPolicy::coalesceControllers});
+
+  queue::start(AlsaHelper::getSequencerHandle(), AlsaHelper::clock());
+  auto emitterPort = AlsaHelper::createOutputPort("out");
+  auto receiverPort = AlsaHelper::createInputPort("in");
+  AlsaHelper::connectPorts(emitterPort, receiverPort);
+
+  // all values go to the same controller, each batch shrinks to a single event.
+  constexpr int controllerCount = 100;
+  AlsaHelper::sendControllerEvents(emitterPort, controllerCount);
+  auto statistics = queue::getStatistics();
+  EXPECT_EQ(statistics.droppedEventCount, 0);
+  EXPECT_GT(statistics.coalescedEventCount, 0);
+  EXPECT_EQ(statistics.eventCount + statistics.coalescedEventCount, controllerCount);
+  queue::stop();
+}
+
+/**
+ * The byte ceiling is respected as well.
+ */
+TEST_F(AlsaReceiverQueueTest, limitsBytes) {
+  namespace queue = receiverQueue; // a shorthand.
+  constexpr long maxBytes = 1024;
+  queue::setLimits({queue::DEFAULT_MAX_EVENTS, maxBytes, queue::OverflowPolicy::dropNewest});
+
+  queue::start(AlsaHelper::getSequencerHandle(), AlsaHelper::clock());
+  auto emitterPort = AlsaHelper::createOutputPort("out");
+  auto receiverPort = AlsaHelper::createInputPort("in");
+  AlsaHelper::connectPorts(emitterPort, receiverPort);
+
+  AlsaHelper::sendControllerEvents(emitterPort, 200);
+  EXPECT_LE(queue::getStatistics().byteCount, maxBytes);
+  queue::stop();
+}
+
+/**
+ * The data of SysEx messages counts towards the byte ceiling, so a SysEx dump cannot
+ * bypass it.
+ */
+TEST_F(AlsaReceiverQueueTest, limitsBytesSysex) {
+  namespace queue = receiverQueue; // a shorthand.
+  constexpr long maxBytes = 4096;
+  queue::setLimits({queue::DEFAULT_MAX_EVENTS, maxBytes, queue::OverflowPolicy::dropNewest});
+  auto droppedBefore = queue::getStatistics().droppedEventCount;
+
+  queue::start(AlsaHelper::getSequencerHandle(), AlsaHelper::clock());
+  auto emitterPort = AlsaHelper::createOutputPort("out");
+  auto receiverPort = AlsaHelper::createInputPort("in");
+  AlsaHelper::connectPorts(emitterPort, receiverPort);
+
+  // ten messages of 1000 bytes each, more than twice the ceiling.
+  std::vector<unsigned char> sysex(1000, 0x55);
+  sysex.front() = 0xF0;
+  sysex.back() = 0xF7;
+  constexpr int sysexCount = 10;
+  for (int i = 0; i < sysexCount; i++) {
+    AlsaHelper::sendSysexEvent(emitterPort, sysex);
+  }
+  auto statistics = queue::getStatistics();
+  EXPECT_LE(statistics.byteCount, maxBytes);
+  EXPECT_LE(statistics.highWatermarkBytes, maxBytes);
+  EXPECT_GT(statistics.droppedEventCount, droppedBefore);
+  EXPECT_LT(statistics.eventCount, sysexCount);
+  queue::stop();
+}
+
+/**
+ * The events keep flowing while the 32-bit JACK frame counter wraps. Events time-stamped
+ * (by the `FrameTimelineClock`, as in the bridge) just before the wrap are neither
+ * discarded as stale nor held back in the first period after the wrap.
+ */
+TEST_F(AlsaReceiverQueueTest, frameCounterWrap) {
+  namespace queue = receiverQueue; // a shorthand.
+  constexpr uint32_t nearWrap{std::numeric_limits<uint32_t>::max() - 1000};
+  constexpr uint32_t nFrames{2048}; // one period, the counter wraps within it.
+  constexpr a2jmidi::TimePoint maxEventAge{2400}; // 50 ms at 48 kHz, as on a resync.
+
+  std::atomic<uint32_t> counter{nearWrap};
+  jackClient::FrameTimeline timeline{nearWrap};
+  queue::start(AlsaHelper::getSequencerHandle(),
+               std::make_unique<jackClient::FrameTimelineClock>(
+                   timeline, [&counter]() { return counter.load(); }));
+  auto emitterPort = AlsaHelper::createOutputPort("out");
+  auto receiverPort = AlsaHelper::createInputPort("in");
+  AlsaHelper::connectPorts(emitterPort, receiverPort);
+
+  constexpr int doubleNoteOns = 4; // results in 16 events
+  AlsaHelper::sendEvents(emitterPort, doubleNoteOns, 1);
+
+  // the next period ends after the wrap.
+  counter += nFrames;
+  EXPECT_LT(counter.load(), nearWrap);
+  a2jmidi::TimePoint deadline = timeline.extend(counter);
+
+  EXPECT_EQ(queue::skip(deadline - maxEventAge), 0);
+  int eventCount = 0;
+  queue::process(deadline,
+                 ([&](const snd_seq_event_t &event, a2jmidi::TimePoint timeStamp) {
+                   eventCount++;
+                   // the position in the period, computed as in the process callback.
+                   a2jmidi::TimePoint position = nFrames - (deadline - timeStamp);
+                   EXPECT_GE(position, 0);
+                   EXPECT_LT(position, nFrames);
+                 }));
+  EXPECT_EQ(eventCount, doubleNoteOns * 4);
+  queue::stop();
+}
+
+/**
+ * Stale events can be skipped in one go; more recent events remain in the queue.
+ */
+TEST_F(AlsaReceiverQueueTest, skipStaleEvents) {
+  namespace queue = receiverQueue; // a shorthand.
+
+  queue::start(AlsaHelper::getSequencerHandle(), AlsaHelper::clock());
+  auto emitterPort = AlsaHelper::createOutputPort("out");
+  auto receiverPort = AlsaHelper::createInputPort("in");
+  AlsaHelper::connectPorts(emitterPort, receiverPort);
+
+  // a first tranche of stale events, followed by a second tranche of recent events.
+  constexpr int doubleNoteOns = 4;
+  AlsaHelper::sendEvents(emitterPort, doubleNoteOns, 20);
+  auto limit = AlsaHelper::clock()->now();
+  AlsaHelper::sendEvents(emitterPort, doubleNoteOns, 20);
+  auto lastStop = AlsaHelper::clock()->now();
+
+  int skipped = queue::skip(limit);
+  EXPECT_EQ(skipped, doubleNoteOns * 4);
+
+  int eventCount = 0;
+  queue::process(lastStop, //
+                 ([&](const snd_seq_event_t &event, a2jmidi::TimePoint timeStamp) {
+                   eventCount++;
+                   EXPECT_GE(timeStamp, limit);
+                 }));
+  EXPECT_EQ(eventCount, doubleNoteOns * 4);
+  queue::stop();
+}
+
+/**
+ * The data of a SysEx message remains valid until the event is processed.
+ */
+TEST_F(AlsaReceiverQueueTest, keepSysexData) {
+  namespace queue = receiverQueue; // a shorthand.
+
+  queue::start(AlsaHelper::getSequencerHandle(), AlsaHelper::clock());
+  auto emitterPort = AlsaHelper::createOutputPort("out");
+  auto receiverPort = AlsaHelper::createInputPort("in");
+  AlsaHelper::connectPorts(emitterPort, receiverPort);
+
+  const std::vector<unsigned char> sysex{0xF0, 0x7E, 0x7F, 0x06, 0x01, 0xF7};
+  AlsaHelper::sendSysexEvent(emitterPort, sysex);
+  // more events, these could overwrite the buffers that alsa-lib used for the SysEx.
+  AlsaHelper::sendControllerEvents(emitterPort, 100);
+
+  int sysexCount = 0;
+  queue::process(AlsaHelper::clock()->now(), //
+                 ([&](const snd_seq_event_t &event, a2jmidi::TimePoint timeStamp) {
+                   if (event.type == SND_SEQ_EVENT_SYSEX) {
+                     sysexCount++;
+                     auto *data = static_cast<const unsigned char *>(event.data.ext.ptr);
+                     EXPECT_EQ(std::vector<unsigned char>(data, data + event.data.ext.len), sysex);
+                   }
+                 }));
+  EXPECT_EQ(sysexCount, 1);
+  queue::stop();
+}
+
+/**
+ * In `rawRead` mode, the receiverQueue receives the same events as in `library` mode,
+ * including variable-length events.
+ */
+TEST_F(AlsaReceiverQueueTest, rawReadEvents) {
+  namespace queue = receiverQueue; // a shorthand.
+  queue::setIngestionMode(queue::IngestionMode::rawRead);
+
+  queue::start(AlsaHelper::getSequencerHandle(), AlsaHelper::clock());
+  auto emitterPort = AlsaHelper::createOutputPort("out");
+  auto receiverPort = AlsaHelper::createInputPort("in");
+  AlsaHelper::connectPorts(emitterPort, receiverPort);
+
+  constexpr int doubleNoteOns = 4;
+  AlsaHelper::sendEvents(emitterPort, doubleNoteOns, 20);
+  const std::vector<unsigned char> sysex{0xF0, 0x43, 0x10, 0x4C, 0x00, 0x00, 0x7E, 0x00, 0xF7};
+  AlsaHelper::sendSysexEvent(emitterPort, sysex);
+  AlsaHelper::sendControllerEvents(emitterPort, 100);
+
+  int noteOnCount = 0;
+  int sysexCount = 0;
+  int controllerCount = 0;
+  queue::process(AlsaHelper::clock()->now(), //
+                 ([&](const snd_seq_event_t &event, a2jmidi::TimePoint timeStamp) {
+                   switch (event.type) {
+                   case SND_SEQ_EVENT_NOTEON:
+                     noteOnCount++;
+                     break;
+                   case SND_SEQ_EVENT_CONTROLLER:
+                     EXPECT_EQ(event.data.control.value, controllerCount % 128);
+                     controllerCount++;
+                     break;
+                   case SND_SEQ_EVENT_SYSEX: {
+                     sysexCount++;
+                     auto *data = static_cast<const unsigned char *>(event.data.ext.ptr);
+                     EXPECT_EQ(std::vector<unsigned char>(data, data + event.data.ext.len), sysex);
+                     break;
+                   }
+                   default:
+                     break;
+                   }
+                 }));
+  EXPECT_EQ(noteOnCount, doubleNoteOns * 2);
+  EXPECT_EQ(sysexCount, 1);
+  EXPECT_EQ(controllerCount, 100);
+  queue::stop();
+}
+
+/**
+ *  when calling "skip" on a stopped queue, nothing (bad) happens.
+ */
+TEST_F(AlsaReceiverQueueTest, skipStoppedQueue) {
+  EXPECT_EQ(receiverQueue::skip(AlsaHelper::clock()->now()), 0);
+}
+
+/**
+ * Errors that go away by themselves are told apart from broken inputs.
+ */
+TEST_F(AlsaReceiverQueueTest, transientErrors) {
+  EXPECT_TRUE(receiverQueue::isTransientError(-EAGAIN));
+  EXPECT_TRUE(receiverQueue::isTransientError(-ENOMEM));
+  EXPECT_FALSE(receiverQueue::isTransientError(-ENODEV));
+  EXPECT_FALSE(receiverQueue::isTransientError(-EBADFD));
+}
+
+/**
+ * After a restart, the queue carries on receiving events with the same clock.
+ */
+TEST_F(AlsaReceiverQueueTest, restart) {
+  namespace queue = receiverQueue; // a shorthand.
+
+  queue::start(AlsaHelper::getSequencerHandle(), AlsaHelper::clock());
+  auto emitterPort = AlsaHelper::createOutputPort("out");
+  auto receiverPort = AlsaHelper::createInputPort("in");
+  AlsaHelper::connectPorts(emitterPort, receiverPort);
+
+  queue::restart(AlsaHelper::getSequencerHandle());
+  EXPECT_EQ(queue::getState(), queue::State::running);
+  EXPECT_FALSE(queue::hasFailed());
+
+  constexpr int controllerEvents = 10;
+  AlsaHelper::sendControllerEvents(emitterPort, controllerEvents);
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+  int received = 0;
+  queue::process(AlsaHelper::clock()->now(),
+                 [&received](const snd_seq_event_t &, a2jmidi::TimePoint) { received++; });
+  EXPECT_EQ(received, controllerEvents);
+  queue::stop();
+}
 } // namespace unitTests
@@ -0,0 +1,120 @@
+/*
+ * File: delay_line_test.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "delay_line.h"
+
+#include "gtest/gtest.h"
+#include <utility>
+#include <vector>
+
+namespace unitTests {
+
+class DelayLineTest : public ::testing::Test {
+protected:
+  using Line = a2jmidi::DelayLine<int, 4, 3>;
+  Line line;
+  std::vector<std::pair<a2jmidi::TimePoint, int>> released;
+
+  bool hold(a2jmidi::TimePoint due, int tag, unsigned char key = 60) {
+    return line.hold(due, tag, 3, [key](unsigned char *buffer) {
+      buffer[0] = 0x90;
+      buffer[1] = key;
+      buffer[2] = 100;
+    });
+  }
+
+  void release(a2jmidi::TimePoint deadline) {
+    line.release(deadline, [this](const Line::Entry &entry) {
+      released.emplace_back(entry.due, entry.tag);
+    });
+  }
+};
+
+/**
+ * Messages are handed out in the order of their due time, only when they are due.
+ */
+TEST_F(DelayLineTest, releaseInOrder) {
+  EXPECT_TRUE(hold(300, 1));
+  EXPECT_TRUE(hold(100, 2));
+  EXPECT_TRUE(hold(200, 3));
+  release(250);
+  std::vector<std::pair<a2jmidi::TimePoint, int>> expected{{100, 2}, {200, 3}};
+  EXPECT_EQ(released, expected);
+  EXPECT_EQ(line.size(), 1);
+  release(300);
+  EXPECT_EQ(released.back(), std::make_pair(a2jmidi::TimePoint{300}, 1));
+  EXPECT_EQ(line.size(), 0);
+}
+
+/**
+ * Messages that are due at the same time keep their order.
+ */
+TEST_F(DelayLineTest, stableForEqualDueTimes) {
+  hold(100, 1);
+  hold(100, 2);
+  hold(50, 3);
+  hold(100, 4);
+  release(100);
+  std::vector<std::pair<a2jmidi::TimePoint, int>> expected{{50, 3}, {100, 1}, {100, 2}, {100, 4}};
+  EXPECT_EQ(released, expected);
+}
+
+/**
+ * The bytes written by `hold` are handed out unchanged.
+ */
+TEST_F(DelayLineTest, keepsBytes) {
+  hold(20, 1, 64);
+  hold(10, 2, 62);
+  std::vector<unsigned char> keys;
+  line.release(20, [&keys](const Line::Entry &entry) {
+    EXPECT_EQ(entry.size, 3);
+    keys.push_back(entry.bytes[1]);
+  });
+  EXPECT_EQ(keys, (std::vector<unsigned char>{62, 64}));
+}
+
+/**
+ * Messages that are too large, or do not fit anymore, are refused.
+ */
+TEST_F(DelayLineTest, refusesWhenFull) {
+  EXPECT_FALSE(line.hold(10, 0, 4, [](unsigned char *) { FAIL(); }));
+  for (int i = 0; i < 4; i++) {
+    EXPECT_TRUE(hold(i, i));
+  }
+  EXPECT_FALSE(hold(10, 5));
+  EXPECT_EQ(line.size(), 4);
+}
+
+/**
+ * Stale messages can be dropped without handing them out.
+ */
+TEST_F(DelayLineTest, dropBefore) {
+  hold(10, 1);
+  hold(20, 2);
+  hold(30, 3);
+  EXPECT_EQ(line.dropBefore(30), 2);
+  release(30);
+  std::vector<std::pair<a2jmidi::TimePoint, int>> expected{{30, 3}};
+  EXPECT_EQ(released, expected);
+  hold(40, 4);
+  line.clear();
+  EXPECT_EQ(line.size(), 0);
+}
+
+} // namespace unitTests
@@ -0,0 +1,129 @@
+/*
+ * File: frame_timeline_test.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "frame_timeline.h"
+
+#include "gtest/gtest.h"
+#include <atomic>
+#include <limits>
+#include <thread>
+
+namespace unitTests {
+
+/**
+ * A 32-bit counter value a little before the wrap point.
+ */
+constexpr uint32_t NEAR_WRAP{std::numeric_limits<uint32_t>::max() - 1000};
+/**
+ * The number of distinct values of a 32-bit counter.
+ */
+constexpr a2jmidi::TimePoint WRAP_PERIOD{a2jmidi::TimePoint{1} << 32};
+
+class FrameTimelineTest : public ::testing::Test {};
+
+/**
+ * Values of a counter that has not yet wrapped are taken over unchanged.
+ */
+TEST_F(FrameTimelineTest, noWrap) {
+  jackClient::FrameTimeline timeline{100};
+  EXPECT_EQ(timeline.extend(100), 100);
+  EXPECT_EQ(timeline.extend(5000), 5000);
+  // values slightly in the past are allowed.
+  EXPECT_EQ(timeline.extend(4000), 4000);
+}
+
+/**
+ * After the 32-bit counter wraps, the timeline continues beyond 2^32.
+ */
+TEST_F(FrameTimelineTest, crossWrap) {
+  jackClient::FrameTimeline timeline{NEAR_WRAP};
+  EXPECT_EQ(timeline.extend(NEAR_WRAP), NEAR_WRAP);
+
+  uint32_t afterWrap = NEAR_WRAP + 2000; // the 32-bit counter wraps here
+  EXPECT_LT(afterWrap, NEAR_WRAP);
+  EXPECT_EQ(timeline.extend(afterWrap), WRAP_PERIOD + afterWrap);
+
+  // a value from just before the wrap is still placed before the wrap.
+  EXPECT_EQ(timeline.extend(NEAR_WRAP + 500), NEAR_WRAP + 500);
+}
+
+/**
+ * The timeline stays monotonic while a counter, that advances in
+ * typical period sizes, wraps several times.
+ */
+TEST_F(FrameTimelineTest, monotonicOverSeveralWraps) {
+  constexpr uint32_t step{1u << 28};
+  uint32_t counter{NEAR_WRAP};
+  jackClient::FrameTimeline timeline{counter};
+  a2jmidi::TimePoint previous = timeline.extend(counter);
+  for (int i = 0; i < 64; i++) { // four wraps
+    counter += step;
+    a2jmidi::TimePoint current = timeline.extend(counter);
+    EXPECT_EQ(current - previous, step);
+    previous = current;
+  }
+  EXPECT_GT(previous, 4 * WRAP_PERIOD);
+}
+
+/**
+ * The FrameTimelineClock reads its counter and extends the value.
+ */
+TEST_F(FrameTimelineTest, clock) {
+  uint32_t counter{NEAR_WRAP};
+  jackClient::FrameTimeline timeline{counter};
+  a2jmidi::ClockPtr clock =
+      std::make_unique<jackClient::FrameTimelineClock>(timeline, [&counter]() { return counter; });
+
+  a2jmidi::TimePoint before = clock->now();
+  counter += 4000;
+  a2jmidi::TimePoint after = clock->now();
+  EXPECT_EQ(after - before, 4000);
+  EXPECT_EQ(after, WRAP_PERIOD + counter);
+}
+
+/**
+ * Simulates a listener thread that time-stamps events and a real-time thread that computes
+ * deadlines, both reading the same timeline while the counter wraps.
+ * A time stamp taken before a deadline must never be later than the deadline.
+ */
+TEST_F(FrameTimelineTest, wrapUnderLoad) {
+  std::atomic<uint32_t> counter{NEAR_WRAP};
+  jackClient::FrameTimeline timeline{counter};
+  std::atomic<a2jmidi::TimePoint> lastTimeStamp{0};
+  std::atomic<bool> carryOn{true};
+
+  std::thread listener{[&]() {
+    while (carryOn) {
+      lastTimeStamp = timeline.extend(counter);
+    }
+  }};
+
+  for (int cycle = 0; cycle < 20000; cycle++) {
+    counter += 128; // one period
+    a2jmidi::TimePoint timeStamp = lastTimeStamp;
+    a2jmidi::TimePoint deadline = timeline.extend(counter);
+    EXPECT_LE(timeStamp, deadline);
+  }
+  carryOn = false;
+  listener.join();
+
+  EXPECT_EQ(timeline.extend(counter), WRAP_PERIOD + counter);
+}
+
+} // namespace unitTests
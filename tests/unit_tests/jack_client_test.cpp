@@ -114,6 +114,80 @@ TEST_F(JackClientTest, callback) {
   EXPECT_EQ(jackClient::state(), jackClient::State::idle);
 }
 
+/**
+ * The resync callback can only be registered in `idle` state.
+ */
+TEST_F(JackClientTest, resyncCallbackWrongState) {
+  jackClient::registerResyncCallback([](a2jmidi::TimePoint deadLine) {});
+
+  jackClient::activate();
+  EXPECT_THROW(jackClient::registerResyncCallback([](a2jmidi::TimePoint deadLine) {}),
+               jackClient::BadStateException);
+  jackClient::stop();
+}
+
+
+/**
+ * The sender ports publish a capture latency of one period plus the jitter compensation,
+ * widened by the declared time stamp error.
+ */
+TEST_F(JackClientTest, captureLatency) {
+  using namespace std::chrono_literals;
+  auto *port = jackClient::newSenderPort("port");
+  jackClient::activate();
+  std::this_thread::sleep_for(100ms);
+
+  jack_latency_range_t range;
+  jack_port_get_latency_range(port, JackCaptureLatency, &range);
+  auto parameters = jackClient::impl::periodParameters();
+  EXPECT_EQ(range.min, parameters.bufferSize + parameters.jitterCompensation);
+  EXPECT_EQ(range.max, range.min);
+
+  jackClient::setTimestampError(100);
+  std::this_thread::sleep_for(100ms);
+  jack_port_get_latency_range(port, JackCaptureLatency, &range);
+  EXPECT_EQ(range.max, range.min + 100);
+
+  jackClient::setTimestampError(0);
+  jackClient::stop();
+}
+
+/**
+ * Implementation specific.
+ * The capture latency range follows from the buffer size and the time stamp error.
+ */
+TEST_F(JackClientTest, implCaptureLatencyRange) {
+  using namespace jackClient::impl;
+  jack_latency_range_t range = captureLatencyRange(computePeriodParameters(256, 48000), 0);
+  EXPECT_EQ(range.min, 256 + 16);
+  EXPECT_EQ(range.max, 256 + 16);
+
+  range = captureLatencyRange(computePeriodParameters(1024, 96000), 48);
+  EXPECT_EQ(range.min, 1024 + 32);
+  EXPECT_EQ(range.max, 1024 + 32 + 48);
+}
+
+/**
+ * Implementation specific.
+ * The per-period parameters scale with the buffer size and the sample rate.
+ */
+TEST_F(JackClientTest, implPeriodParameters) {
+  using namespace jackClient::impl;
+  PeriodParameters small = computePeriodParameters(64, 44100);
+  EXPECT_EQ(small.bufferSize, 64);
+  EXPECT_EQ(small.sampleRate, 44100);
+  EXPECT_EQ(small.jitterCompensation, 15);
+  EXPECT_EQ(small.discontinuityLimit, DISCONTINUITY_PERIODS * 64);
+
+  PeriodParameters large = computePeriodParameters(2048, 192000);
+  EXPECT_EQ(large.jitterCompensation, 64);
+  EXPECT_EQ(large.discontinuityLimit, DISCONTINUITY_PERIODS * 2048);
+
+  // the parameters published on `open` match the server configuration.
+  PeriodParameters current = periodParameters();
+  EXPECT_EQ(current.bufferSize, jack_get_buffer_size(g_jackClientHandle));
+  EXPECT_EQ(current.sampleRate, jack_get_sample_rate(g_jackClientHandle));
+}
 
 /**
  * Implementation specific.
@@ -0,0 +1,130 @@
+/*
+ * File: message_ring_test.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "message_ring.h"
+
+#include "gtest/gtest.h"
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace unitTests {
+
+using Message = std::vector<unsigned char>;
+using Received = std::vector<std::pair<a2jmidi::TimePoint, Message>>;
+
+class MessageRingTest : public ::testing::Test {
+protected:
+  static bool write(a2jmidi::MessageRing &ring, a2jmidi::TimePoint time, const Message &message) {
+    return ring.write(time, message.data(), message.size());
+  }
+  static int read(a2jmidi::MessageRing &ring, Received &received) {
+    return ring.read([&received](a2jmidi::TimePoint time, const unsigned char *bytes, size_t size) {
+      received.emplace_back(time, Message{bytes, bytes + size});
+    });
+  }
+};
+
+/**
+ * Messages are read in the order in which they were written, with their time stamps.
+ */
+TEST_F(MessageRingTest, readInOrder) {
+  a2jmidi::MessageRing ring{256};
+  EXPECT_TRUE(ring.empty());
+  EXPECT_TRUE(write(ring, 10, {0x90, 60, 100}));
+  EXPECT_TRUE(write(ring, 12, {0xC0, 5}));
+  EXPECT_FALSE(ring.empty());
+  Received received;
+  EXPECT_EQ(read(ring, received), 2);
+  Received expected{{10, {0x90, 60, 100}}, {12, {0xC0, 5}}};
+  EXPECT_EQ(received, expected);
+  EXPECT_TRUE(ring.empty());
+  EXPECT_EQ(read(ring, received), 0);
+}
+
+/**
+ * A message that does not fit before the end of the buffer starts over at its beginning.
+ */
+TEST_F(MessageRingTest, wrapAround) {
+  a2jmidi::MessageRing ring{128};
+  Message sysex(40, 0x55);
+  sysex.front() = 0xF0;
+  sysex.back() = 0xF7;
+  Received received;
+  for (int i = 0; i < 20; i++) {
+    ASSERT_TRUE(write(ring, i, sysex));
+    ASSERT_TRUE(write(ring, i, {0xF8}));
+    ASSERT_EQ(read(ring, received), 2);
+  }
+  ASSERT_EQ(received.size(), 40U);
+  for (int i = 0; i < 20; i++) {
+    EXPECT_EQ(received[2 * i].second, sysex);
+    EXPECT_EQ(received[2 * i + 1].first, i);
+  }
+}
+
+/**
+ * When the ring is full, messages are refused; reading makes room again.
+ */
+TEST_F(MessageRingTest, refusesWhenFull) {
+  a2jmidi::MessageRing ring{128}; // four records of 32 bytes.
+  EXPECT_TRUE(write(ring, 1, {0x90, 60, 100}));
+  EXPECT_TRUE(write(ring, 2, {0x90, 61, 100}));
+  EXPECT_TRUE(write(ring, 3, {0x90, 62, 100}));
+  EXPECT_TRUE(write(ring, 4, {0x90, 63, 100}));
+  EXPECT_FALSE(write(ring, 5, {0x90, 64, 100}));
+  EXPECT_FALSE(write(ring, 5, Message(100, 0)));
+  Received received;
+  EXPECT_EQ(read(ring, received), 4);
+  EXPECT_TRUE(write(ring, 5, {0x90, 64, 100}));
+}
+
+/**
+ * One producer and one consumer can use the ring at the same time.
+ */
+TEST_F(MessageRingTest, concurrentUse) {
+  a2jmidi::MessageRing ring{1024};
+  constexpr int count = 20000;
+  std::thread producer{[&ring]() {
+    for (int i = 0; i < count;) {
+      unsigned char bytes[3]{0x90, static_cast<unsigned char>(i % 128), 1};
+      if (ring.write(i, bytes, 1 + i % 3)) {
+        i++;
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  }};
+  int expected = 0;
+  bool inOrder = true;
+  while (expected < count) {
+    int taken = ring.read([&](a2jmidi::TimePoint time, const unsigned char *bytes, size_t size) {
+      inOrder = inOrder && time == expected && size == 1U + expected % 3 && bytes[0] == 0x90;
+      expected++;
+    });
+    if (taken == 0) {
+      std::this_thread::yield();
+    }
+  }
+  producer.join();
+  EXPECT_TRUE(inOrder);
+  EXPECT_TRUE(ring.empty());
+}
+
+} // namespace unitTests
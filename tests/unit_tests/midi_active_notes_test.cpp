@@ -0,0 +1,93 @@
+/*
+ * File: midi_active_notes_test.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "midi_active_notes.h"
+
+#include "gtest/gtest.h"
+#include <vector>
+
+namespace unitTests {
+
+using Message = std::vector<unsigned char>;
+using Messages = std::vector<Message>;
+
+class MidiActiveNotesTest : public ::testing::Test {
+protected:
+  midi::ActiveNotes activeNotes;
+
+  void send(const Message &message) { activeNotes.update(message.data(), message.size()); }
+
+  Messages release() {
+    Messages result;
+    activeNotes.releaseAll([&result](const unsigned char *data, size_t size) {
+      result.emplace_back(data, data + size);
+    });
+    return result;
+  }
+};
+
+/**
+ * A note-on makes the note active, a note-off (or a note-on with velocity zero) ends it.
+ */
+TEST_F(MidiActiveNotesTest, noteOnNoteOff) {
+  send({0x90, 60, 100});
+  send({0x93, 127, 1});
+  EXPECT_TRUE(activeNotes.isActive(0, 60));
+  EXPECT_TRUE(activeNotes.isActive(3, 127));
+  EXPECT_FALSE(activeNotes.isActive(1, 60));
+
+  send({0x80, 60, 64});
+  send({0x93, 127, 0});
+  EXPECT_FALSE(activeNotes.isActive(0, 60));
+  EXPECT_FALSE(activeNotes.isActive(3, 127));
+  EXPECT_FALSE(activeNotes.any());
+}
+
+/**
+ * Messages other than notes leave the active notes untouched.
+ */
+TEST_F(MidiActiveNotesTest, otherMessagesIgnored) {
+  send({0x90, 10, 100});
+  send({0xB0, 10, 0});
+  send({0xA0, 10, 0});
+  send({0xE0, 10, 0});
+  send({0xC0, 10});
+  send({0xF8});
+  EXPECT_TRUE(activeNotes.isActive(0, 10));
+  send({0xB0, 64, 127});
+  EXPECT_FALSE(activeNotes.isActive(0, 64));
+}
+
+/**
+ * Releasing produces one note-off per sounding note, ordered by channel and key.
+ */
+TEST_F(MidiActiveNotesTest, releaseAll) {
+  send({0x9F, 100, 1});
+  send({0x90, 70, 1});
+  send({0x90, 3, 1});
+  send({0x90, 5, 1});
+  send({0x80, 5, 0});
+
+  Messages expected{{0x80, 3, 0}, {0x80, 70, 0}, {0x8F, 100, 0}};
+  EXPECT_EQ(release(), expected);
+  EXPECT_FALSE(activeNotes.any());
+  EXPECT_TRUE(release().empty());
+}
+
+} // namespace unitTests
@@ -0,0 +1,118 @@
+/*
+ * File: midi_clock_pll_test.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "midi_clock_pll.h"
+
+#include "gtest/gtest.h"
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace unitTests {
+
+constexpr int SAMPLE_RATE{48000};
+constexpr a2jmidi::TimePoint MAX_CORRECTION{240}; // 5 ms
+constexpr double PERIOD{1000};                     // 120 BPM at 48 kHz.
+
+/**
+ * The arrival time of an ideal tick, delayed to the next USB frame (1 ms)
+ * and by a random wake-up latency of the listener.
+ */
+a2jmidi::TimePoint arrival(double ideal, std::minstd_rand &random) {
+  std::uniform_int_distribution<int> wakeUp{0, 96};
+  auto usbFrame = static_cast<a2jmidi::TimePoint>(std::ceil(ideal / 48) * 48);
+  return usbFrame + wakeUp(random);
+}
+
+/**
+ * The standard deviation of the given values.
+ */
+double deviation(const std::vector<double> &values) {
+  double mean = 0;
+  for (auto value : values) {
+    mean += value / values.size();
+  }
+  double squares = 0;
+  for (auto value : values) {
+    squares += (value - mean) * (value - mean) / values.size();
+  }
+  return std::sqrt(squares);
+}
+
+/**
+ * After locking, the smoothed ticks jitter much less than the arrivals, and no tick is
+ * moved by more than the maximum correction.
+ */
+TEST(MidiClockPllTest, removesJitter) {
+  midi::ClockPll pll{MAX_CORRECTION};
+  std::minstd_rand random{};
+  std::vector<double> rawErrors;
+  std::vector<double> smoothErrors;
+  for (int i = 0; i < 2000; i++) {
+    double ideal = 100000 + i * PERIOD;
+    auto arrived = arrival(ideal, random);
+    auto placed = pll.placeTick(arrived);
+    EXPECT_LE(std::abs(placed - arrived), MAX_CORRECTION);
+    if (i >= 200) {
+      rawErrors.push_back(arrived - ideal);
+      smoothErrors.push_back(placed - ideal);
+    }
+  }
+  ASSERT_TRUE(pll.isLocked());
+  EXPECT_LT(deviation(smoothErrors), deviation(rawErrors) / 3);
+  double bpm = 60.0 * SAMPLE_RATE / (midi::TICKS_PER_QUARTER * pll.period());
+  EXPECT_NEAR(bpm, 120, 0.5);
+  EXPECT_GT(pll.jitter(), 10);
+}
+
+/**
+ * A tempo jump lets the loop lock again on the new tempo.
+ */
+TEST(MidiClockPllTest, tempoJump) {
+  midi::ClockPll pll{MAX_CORRECTION};
+  a2jmidi::TimePoint time = 0;
+  for (int i = 0; i < 100; i++) {
+    time += 1000;
+    pll.placeTick(time);
+  }
+  EXPECT_NEAR(pll.period(), 1000, 1);
+  for (int i = 0; i < 100; i++) {
+    time += 500; // twice as fast.
+    pll.placeTick(time);
+  }
+  EXPECT_TRUE(pll.isLocked());
+  EXPECT_NEAR(pll.period(), 500, 1);
+}
+
+/**
+ * Start is aligned to the tick that is expected next; without a clock it stays in place.
+ */
+TEST(MidiClockPllTest, transport) {
+  midi::ClockPll pll{MAX_CORRECTION};
+  EXPECT_EQ(pll.placeTransport(1234), 1234);
+  a2jmidi::TimePoint time = 0;
+  for (int i = 0; i < 100; i++) {
+    time += 1000;
+    pll.placeTick(time);
+  }
+  EXPECT_EQ(pll.placeTransport(time + 950), time + 1000);
+  EXPECT_EQ(pll.placeTransport(time + 500), time + 500); // too far away from a tick.
+}
+
+} // namespace unitTests
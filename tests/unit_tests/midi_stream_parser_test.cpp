@@ -0,0 +1,122 @@
+/*
+ * File: midi_stream_parser_test.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "midi_stream_parser.h"
+
+#include "gtest/gtest.h"
+#include <vector>
+
+namespace unitTests {
+
+using Message = std::vector<unsigned char>;
+using Messages = std::vector<Message>;
+
+class MidiStreamParserTest : public ::testing::Test {
+protected:
+  midi::StreamParser parser;
+  Messages received;
+
+  void feed(const Message &bytes) {
+    parser.parse(bytes.data(), bytes.size(), [this](const unsigned char *data, size_t size) {
+      received.emplace_back(data, data + size);
+    });
+  }
+};
+
+/**
+ * Messages that come with their status byte are passed on unchanged.
+ */
+TEST_F(MidiStreamParserTest, completeMessages) {
+  feed({0x90, 60, 100, 0xC3, 5, 0xE0, 0x00, 0x40});
+  Messages expected{{0x90, 60, 100}, {0xC3, 5}, {0xE0, 0x00, 0x40}};
+  EXPECT_EQ(received, expected);
+}
+
+/**
+ * Messages sent with running status receive their status byte.
+ */
+TEST_F(MidiStreamParserTest, runningStatus) {
+  feed({0x90, 60, 100, 64, 100, 67, 0, 0xD1, 10, 20});
+  Messages expected{{0x90, 60, 100}, {0x90, 64, 100}, {0x90, 67, 0}, {0xD1, 10}, {0xD1, 20}};
+  EXPECT_EQ(received, expected);
+}
+
+/**
+ * A message that is cut between two chunks is completed by the second chunk.
+ */
+TEST_F(MidiStreamParserTest, splitAcrossChunks) {
+  feed({0xB0, 7});
+  EXPECT_TRUE(received.empty());
+  feed({127, 10});
+  feed({64});
+  Messages expected{{0xB0, 7, 127}, {0xB0, 10, 64}};
+  EXPECT_EQ(received, expected);
+}
+
+/**
+ * Real-time messages are delivered at once, even in the middle of another message,
+ * and do not disturb running status.
+ */
+TEST_F(MidiStreamParserTest, realTimeInterleaved) {
+  feed({0x90, 60, 0xF8, 100, 62, 0xFA, 90});
+  Messages expected{{0xF8}, {0x90, 60, 100}, {0xFA}, {0x90, 62, 90}};
+  EXPECT_EQ(received, expected);
+}
+
+/**
+ * System common messages cancel running status, data bytes without status are ignored.
+ */
+TEST_F(MidiStreamParserTest, systemCommonCancelsRunningStatus) {
+  feed({0x80, 60, 0, 0xF2, 0x10, 0x20, 61, 0, 0xF6, 0xF3, 3});
+  Messages expected{{0x80, 60, 0}, {0xF2, 0x10, 0x20}, {0xF6}, {0xF3, 3}};
+  EXPECT_EQ(received, expected);
+}
+
+/**
+ * SysEx messages are collected completely, even across chunks and with interleaved
+ * real-time messages.
+ */
+TEST_F(MidiStreamParserTest, sysex) {
+  feed({0xF0, 0x7E, 0x7F});
+  feed({0x06, 0xF8, 0x01, 0xF7, 0x90, 60, 1});
+  Messages expected{{0xF8}, {0xF0, 0x7E, 0x7F, 0x06, 0x01, 0xF7}, {0x90, 60, 1}};
+  EXPECT_EQ(received, expected);
+}
+
+/**
+ * A SysEx message that is interrupted by another status byte is closed.
+ */
+TEST_F(MidiStreamParserTest, sysexInterrupted) {
+  feed({0xF0, 0x01, 0x02, 0x90, 60, 1});
+  Messages expected{{0xF0, 0x01, 0x02, 0xF7}, {0x90, 60, 1}};
+  EXPECT_EQ(received, expected);
+}
+
+/**
+ * After a reset, partial messages and the running status are forgotten.
+ */
+TEST_F(MidiStreamParserTest, reset) {
+  feed({0x90, 60, 100, 62});
+  parser.reset();
+  feed({90, 64, 100});
+  Messages expected{{0x90, 60, 100}};
+  EXPECT_EQ(received, expected);
+}
+
+} // namespace unitTests
@@ -0,0 +1,69 @@
+/*
+ * File: midi_test.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "midi.h"
+
+#include "gtest/gtest.h"
+
+namespace unitTests {
+class MidiTest : public ::testing::Test {};
+
+/**
+ * Notes, controllers, program changes, pressure and pitch bend are channel messages.
+ */
+TEST_F(MidiTest, channelMessages) {
+  EXPECT_TRUE(midi::isChannelMessage(0x80));  // note off, channel 1
+  EXPECT_TRUE(midi::isChannelMessage(0x9F));  // note on, channel 16
+  EXPECT_TRUE(midi::isChannelMessage(0xB3));  // controller, channel 4
+  EXPECT_TRUE(midi::isChannelMessage(0xEF));  // pitch bend, channel 16
+  EXPECT_FALSE(midi::isChannelMessage(0xF0)); // SysEx
+  EXPECT_FALSE(midi::isChannelMessage(0xF8)); // timing clock
+  EXPECT_FALSE(midi::isChannelMessage(0x40)); // a data byte
+}
+
+/**
+ * The channel is encoded in the lower nibble of the status byte.
+ */
+TEST_F(MidiTest, channelOf) {
+  EXPECT_EQ(midi::channelOf(0x90), 0);
+  EXPECT_EQ(midi::channelOf(0xB9), 9);
+  EXPECT_EQ(midi::channelOf(0xEF), midi::CHANNEL_COUNT - 1);
+}
+
+/**
+ * Each status byte belongs to exactly one message class.
+ */
+TEST_F(MidiTest, classOf) {
+  using namespace midi::messageClass;
+  EXPECT_EQ(midi::classOf(0x80), NOTE);
+  EXPECT_EQ(midi::classOf(0x9F), NOTE);
+  EXPECT_EQ(midi::classOf(0xA0), PRESSURE);
+  EXPECT_EQ(midi::classOf(0xD5), PRESSURE);
+  EXPECT_EQ(midi::classOf(0xB3), CONTROL);
+  EXPECT_EQ(midi::classOf(0xC0), PROGRAM);
+  EXPECT_EQ(midi::classOf(0xEF), PITCH_BEND);
+  EXPECT_EQ(midi::classOf(0xF0), SYSEX);
+  EXPECT_EQ(midi::classOf(0xF8), CLOCK);
+  EXPECT_EQ(midi::classOf(0xFC), CLOCK);
+  EXPECT_EQ(midi::classOf(0xFE), ACTIVE_SENSING);
+  EXPECT_EQ(midi::classOf(0xF2), SYSTEM);
+  EXPECT_EQ(midi::classOf(0xFF), SYSTEM);
+}
+
+} // namespace unitTests
@@ -0,0 +1,104 @@
+/*
+ * File: midi_ump_test.cpp
+ *
+ *
+ * Copyright 2020 Harald Postner <Harald at free_creations.de>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "midi_ump.h"
+
+#include "gtest/gtest.h"
+#include <vector>
+
+namespace unitTests {
+
+using Message = std::vector<unsigned char>;
+
+/**
+ * Translate a packet and return the MIDI 1.0 bytes.
+ */
+Message translate(std::vector<uint32_t> words) {
+  unsigned char buffer[midi::ump::MAX_MIDI1_SIZE];
+  size_t size = midi::ump::toMidi1(words.data(), buffer);
+  return Message(buffer, buffer + size);
+}
+
+/**
+ * The size of a packet follows from its message type.
+ */
+TEST(MidiUmpTest, wordCount) {
+  EXPECT_EQ(midi::ump::wordCount(0x20903C64), 1);
+  EXPECT_EQ(midi::ump::wordCount(0x40903C00), 2);
+  EXPECT_EQ(midi::ump::wordCount(0x30160102), 2);
+  EXPECT_EQ(midi::ump::wordCount(0x50000000), 4);
+  EXPECT_EQ(midi::ump::wordCount(0xF0000000), 4);
+}
+
+/**
+ * MIDI 1.0 channel voice and system packets carry the MIDI bytes as they are.
+ */
+TEST(MidiUmpTest, midi1Packets) {
+  EXPECT_EQ(translate({0x20903C64}), (Message{0x90, 60, 100}));
+  EXPECT_EQ(translate({0x20C50700}), (Message{0xC5, 7}));
+  EXPECT_EQ(translate({0x10F80000}), (Message{0xF8}));
+  EXPECT_EQ(translate({0x10F21020}), (Message{0xF2, 0x10, 0x20}));
+  EXPECT_TRUE(translate({0x10F40000}).empty()); // undefined system message.
+}
+
+/**
+ * MIDI 2.0 channel voice packets are scaled down to 7 (or 14) bits.
+ */
+TEST(MidiUmpTest, midi2Packets) {
+  // note on, velocity 0xFFFF.
+  EXPECT_EQ(translate({0x40913C00, 0xFFFF0000}), (Message{0x91, 60, 127}));
+  // note on with a velocity that scales down to zero must stay a note on.
+  EXPECT_EQ(translate({0x40903C00, 0x01000000}), (Message{0x90, 60, 1}));
+  // note off.
+  EXPECT_EQ(translate({0x40803C00, 0x80000000}), (Message{0x80, 60, 64}));
+  // controller 7, half way.
+  EXPECT_EQ(translate({0x40B20700, 0x80000000}), (Message{0xB2, 7, 64}));
+  // program change 5 (the bank is not translated).
+  EXPECT_EQ(translate({0x40C00001, 0x05000102}), (Message{0xC0, 5}));
+  // channel pressure.
+  EXPECT_EQ(translate({0x40D00000, 0xFFFFFFFF}), (Message{0xD0, 127}));
+  // pitch bend centre.
+  EXPECT_EQ(translate({0x40E00000, 0x80000000}), (Message{0xE0, 0x00, 0x40}));
+  // per-note pitch bend has no MIDI 1.0 equivalent.
+  EXPECT_TRUE(translate({0x40603C00, 0x80000000}).empty());
+}
+
+/**
+ * 7-bit SysEx packets are collected into one SysEx message.
+ */
+TEST(MidiUmpTest, sysex7) {
+  midi::ump::Sysex7Assembler assembler;
+  std::vector<Message> received;
+  auto onMessage = [&](const unsigned char *bytes, size_t size) {
+    received.emplace_back(bytes, bytes + size);
+  };
+  uint32_t complete[2]{0x30037E7F, 0x06000000};
+  assembler.add(complete, onMessage);
+  uint32_t start[2]{0x30160102, 0x03040506};
+  uint32_t end[2]{0x30320708, 0x00000000};
+  uint32_t stray[2]{0x30220909, 0x00000000};
+  assembler.add(start, onMessage);
+  assembler.add(end, onMessage);
+  assembler.add(stray, onMessage); // a continuation without a start is ignored.
+  std::vector<Message> expected{{0xF0, 0x7E, 0x7F, 0x06, 0xF7},
+                                {0xF0, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0xF7}};
+  EXPECT_EQ(received, expected);
+}
+
+} // namespace unitTests